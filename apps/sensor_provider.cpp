@@ -7,6 +7,7 @@
 
 #include "log.hpp"
 #include "sinks_console.hpp"
+#include "sinks_flight_recorder.hpp"
 
 #include "ara/com/core.hpp"
 #include "ara/com/someip_adapter.hpp"
@@ -29,6 +30,7 @@ int main() {
   LM.SetGlobalIds("ECU1","sensor_provider");
   LM.SetDefaultLevel(ara::log::LogLevel::kInfo);
   LM.AddSink(std::make_shared<ara::log::ConsoleSink>());
+  if (auto fr = ara::log::FlightRecorderSink::FromEnvironment()) LM.AddSink(fr); // set by EM
   auto lg = ara::log::Logger::CreateLogger("SNS");
 
   // PHM
@@ -51,9 +53,9 @@ int main() {
     // Publish event (transport-agnostic). Codec<float> handles serialization.
     auto ec = skel.Notify<SpeedDesc::SpeedEvent>(speed);
     if (ec != ara::com::Errc::kOk) {
-      ARA_LOGWARN(lg, "Notify failed with Errc={}", static_cast<int>(ec));
+      ARA_LOGWARN_RL(lg, "Notify failed with Errc={}", static_cast<int>(ec));
     } else {
-      ARA_LOGDEBUG(lg, "Speed publish {}", speed);
+      ARA_LOGDEBUG_KV(lg, "speed publish", "v", speed);
     }
 
     std::this_thread::sleep_for(100ms);
@@ -2,17 +2,20 @@
 #include <chrono>
 #include <cmath>
 #include <csignal>
+#include <future>
 #include <thread>
 #include <string>
 
 #include "log.hpp"
 #include "sinks_console.hpp"
+#include "sinks_flight_recorder.hpp"
 
 #include "ara/com/core.hpp"
 #include "ara/com/someip_adapter.hpp"
 #include "services_description.hpp"          
 #include <ara/phm/supervision_client.hpp>
 #include "persistency/key_value_storage_backend.hpp" 
+#include "persistency/storage_registry.hpp"
 #include "ara/per/key_value_storage.hpp"
 
 
@@ -30,14 +33,24 @@ int main() {
   LM.SetGlobalIds("ECU1","speed_client");
   LM.SetDefaultLevel(ara::log::LogLevel::kInfo);
   LM.AddSink(std::make_shared<ara::log::ConsoleSink>());
+  if (auto fr = ara::log::FlightRecorderSink::FromEnvironment()) LM.AddSink(fr); // set by EM
   auto lg = ara::log::Logger::CreateLogger("SPD");
 
-  // persistency
-  auto backend = std::make_shared<::persistency::KeyValueStorageBackend>("/var/adaptive/per/demo");
-  ara::per::KeyValueStorage kv(backend);
+  // persistency: manifest picks the engine ("log" for ExampleApp/KV/Main);
+  // fall back to a plain file store if the manifest isn't reachable
+  std::shared_ptr<ara::per::KeyValueStorage> kvh;
+  if (::persistency::StorageRegistry::Instance().InitFromFile("../manifests/persistency.json").HasValue()) {
+    if (auto h = ara::per::OpenKeyValueStorage(ara::core::InstanceSpecifier{"ExampleApp/KV/Main"}); h.HasValue())
+      kvh = h.Value();
+  }
+  if (!kvh) {
+    kvh = std::make_shared<ara::per::KeyValueStorage>(
+        std::make_shared<::persistency::KeyValueStorageBackend>("/var/adaptive/per/demo"));
+  }
+  ara::per::KeyValueStorage& kv = *kvh;
   float max_speed = 90.0f;
   if (auto r = kv.GetValue<float>("max_allowed_speed"); r.HasValue()) max_speed = r.Value();
-  else kv.SetValue("max_allowed_speed", std::to_string(max_speed));
+  else kv.SetValue("max_allowed_speed", max_speed);
 
   // PHM
   ara::phm::SupervisionClient phm("speed_client");
@@ -50,15 +63,18 @@ int main() {
   }
 
   std::atomic<int> missed_ticks{0};
+  int sync_ticks = 0;
+  std::future<ara::core::Result<void>> pending_sync;
 
   // Subscribe to the speed event (transport-agnostic)
   auto sub = proxy.Subscribe<SpeedDesc::SpeedEvent>(
     [&](float speed){
-      kv.SetValue("last_speed", std::to_string(speed));
+      kv.SetValue("last_speed", speed);
+      // Event arrives every 100 ms; rate-limit so a storm can't flood the sinks
       if (speed > max_speed)
-        ARA_LOGWARN(lg, "Speed {} exceeds threshold {}!", speed, max_speed);
+        ARA_LOGWARN_RL(lg, "Speed {} exceeds threshold {}!", speed, max_speed);
       else
-        ARA_LOGINFO(lg, "Speed={} (max={})", speed, max_speed);
+        ARA_LOGINFO_RL(lg, "Speed={} (max={})", speed, max_speed);
       missed_ticks.store(0, std::memory_order_relaxed);
     }
   );
@@ -71,8 +87,19 @@ int main() {
       phm.ReportCheckpoint(0x1001);
       missed_ticks.store(0, std::memory_order_relaxed);
     }
+    // last_speed is staged in write-back mode; persist it once a second,
+    // off this thread so a slow fsync can't delay ReportAlive()
+    if (pending_sync.valid() && pending_sync.wait_for(0ms) == std::future_status::ready) {
+      if (!pending_sync.get().HasValue()) ARA_LOGWARN_RL(lg, "Persisting speed values failed");
+    }
+    if (++sync_ticks >= 10 && !pending_sync.valid()) {
+      sync_ticks = 0;
+      pending_sync = kv.SyncToStorageAsync();
+    }
     std::this_thread::sleep_for(100ms);
   }
+  if (pending_sync.valid()) pending_sync.wait();
+  kv.SyncToStorage();
 
   // Clean up (optional but nice if your adapter/binding supports it)
   rt.adapter().unsubscribe_event(sub);
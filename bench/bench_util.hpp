@@ -0,0 +1,100 @@
+// bench/bench_util.hpp
+// Shared helpers for the *_bench executables: allocation counting, latency
+// percentiles and a tiny JSON row writer.
+// Include from exactly one translation unit per executable (it replaces the
+// global operator new/delete to count allocations).
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+inline std::atomic<uint64_t> g_allocs{0};
+
+inline uint64_t NowNs() {
+  using namespace std::chrono;
+  return static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+// p in [0,1]; sorts v in place
+inline uint64_t Percentile(std::vector<uint64_t>& v, double p) {
+  if (v.empty()) return 0;
+  const size_t k = std::min(v.size() - 1, static_cast<size_t>(p * static_cast<double>(v.size() - 1) + 0.5));
+  std::nth_element(v.begin(), v.begin() + static_cast<std::ptrdiff_t>(k), v.end());
+  return v[k];
+}
+
+// Spin barrier so producer threads start hammering at the same time
+class StartGate {
+public:
+  explicit StartGate(int n) : waiting_(n) {}
+  void ArriveAndWait() {
+    waiting_.fetch_sub(1, std::memory_order_acq_rel);
+    while (waiting_.load(std::memory_order_acquire) > 0) std::this_thread::yield();
+  }
+private:
+  std::atomic<int> waiting_;
+};
+
+// One JSON object per result row, printed as an array on stdout.
+class JsonRows {
+public:
+  class Row {
+  public:
+    Row& Str(std::string_view k, std::string_view v) { Key(k); oss_ << '"' << v << '"'; return *this; }
+    Row& Num(std::string_view k, double v)   { Key(k); oss_ << std::fixed << std::setprecision(2) << v; return *this; }
+    Row& Int(std::string_view k, uint64_t v) { Key(k); oss_ << v; return *this; }
+    std::string Done() const { return "{" + oss_.str() + "}"; }
+  private:
+    void Key(std::string_view k) { if (!first_) oss_ << ", "; first_ = false; oss_ << '"' << k << "\": "; }
+    std::ostringstream oss_;
+    bool first_{true};
+  };
+
+  void Add(const Row& r) { rows_.push_back(r.Done()); }
+
+  void Print(std::ostream& os, std::string_view bench_name) const {
+    os << "{\n  \"benchmark\": \"" << bench_name << "\",\n  \"results\": [\n";
+    for (size_t i = 0; i < rows_.size(); ++i)
+      os << "    " << rows_[i] << (i + 1 < rows_.size() ? ",\n" : "\n");
+    os << "  ]\n}\n";
+  }
+
+private:
+  std::vector<std::string> rows_;
+};
+
+// Minimal "--name value" parsing for the bench CLIs
+inline long ArgOr(int argc, char** argv, std::string_view name, long def) {
+  for (int i = 1; i + 1 < argc; ++i)
+    if (name == argv[i]) return std::strtol(argv[i + 1], nullptr, 10);
+  return def;
+}
+
+} // namespace bench
+
+// ---- allocation counting (replaces the global allocator hooks) ----
+// noinline keeps GCC from pairing the inlined malloc/free and warning about a
+// new/free mismatch that isn't there.
+#define BENCH_NOINLINE __attribute__((noinline))
+BENCH_NOINLINE void* operator new(std::size_t n) {
+  bench::g_allocs.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+BENCH_NOINLINE void* operator new[](std::size_t n) { return operator new(n); }
+BENCH_NOINLINE void operator delete(void* p) noexcept { std::free(p); }
+BENCH_NOINLINE void operator delete[](void* p) noexcept { std::free(p); }
+BENCH_NOINLINE void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+BENCH_NOINLINE void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
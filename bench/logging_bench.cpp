@@ -0,0 +1,214 @@
+// logging_bench: cost of the logging front end (log.hpp) and of each sink.
+//
+//   ./logging_bench [--iters N] [--lat-iters N] [--threads MAX] [--file PATH]
+//
+// For every case and for 1..MAX producer threads it reports ns per call
+// (throughput pass), p50/p99 call latency (separately timed pass) and heap
+// allocations per call, as JSON on stdout.
+#include "bench_util.hpp"
+
+#include "log.hpp"
+#include "sinks_console.hpp"
+#include "sinks_dlt.hpp"
+#include "sinks_flight_recorder.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+using namespace ara::log;
+
+namespace {
+
+// ---- sinks ------------------------------------------------------------------
+
+// Keeps the last record (what the unit tests' CaptureSink does, minus growth)
+struct CaptureSink : ISink {
+  std::mutex mu;
+  LogRecord last;
+  void write(const LogRecord& r) noexcept override { std::scoped_lock lk(mu); last = r; }
+};
+
+struct FileSink : ISink {
+  explicit FileSink(const std::string& path) : out(path, std::ios::trunc) {}
+  std::mutex mu;
+  std::ofstream out;
+  void write(const LogRecord& r) noexcept override {
+    std::scoped_lock lk(mu);
+    out << r.ts_ns << " [" << ToString(r.level) << "] " << r.ctx_id << ": " << r.message << '\n';
+  }
+};
+
+#ifndef HAVE_DLT
+// Stand-in with DltSink's shape when libdlt is absent: bound handle, and
+// binary args in non-verbose mode; nothing leaves the process.
+struct DltStubSink : ISink {
+  explicit DltStubSink(bool non_verbose) : nv(non_verbose) {}
+  bool nv;
+  std::atomic<uint64_t> bytes{0};
+  void* BindContext(const std::string&, const std::string&, const std::string&) override { return this; }
+  bool WantsBinaryArgs() const noexcept override { return nv; }
+  bool WantsText() const noexcept override { return !nv; }
+  void write(const LogRecord& r) noexcept override {
+    bytes.fetch_add(nv ? 4 + r.args.size() : r.message.size(), std::memory_order_relaxed);
+  }
+};
+#endif
+
+SinkPtr MakeDltSink(bool non_verbose) {
+#ifdef HAVE_DLT
+  return std::make_shared<DltSink>("logging_bench", non_verbose ? DltSink::Mode::kNonVerbose
+                                                                : DltSink::Mode::kVerbose);
+#else
+  return std::make_shared<DltStubSink>(non_verbose);
+#endif
+}
+
+// ---- call shapes ------------------------------------------------------------
+
+using LogFn = void (*)(Logger&, int);
+
+void Args0(Logger& lg, int)   { ARA_LOGINFO(lg, "bench"); }
+void Args1(Logger& lg, int i) { ARA_LOGINFO(lg, "bench {}", i); }
+void Args2(Logger& lg, int i) { ARA_LOGINFO(lg, "bench {} {}", i, 1.5f); }
+void Args3(Logger& lg, int i) { ARA_LOGINFO(lg, "bench {} {} {}", i, 1.5f, "str"); }
+void Args4(Logger& lg, int i) { ARA_LOGINFO(lg, "bench {} {} {} {}", i, 1.5f, "str", 42u); }
+void Args5(Logger& lg, int i) { ARA_LOGINFO(lg, "bench {} {} {} {} {}", i, 1.5f, "str", 42u, true); }
+void Args6(Logger& lg, int i) { ARA_LOGINFO(lg, "bench {} {} {} {} {} {}", i, 1.5f, "str", 42u, true, -7); }
+void Disabled(Logger& lg, int i) { ARA_LOGDEBUG(lg, "bench {} {}", i, 1.5f); }
+void Fields2(Logger& lg, int i)  { ARA_LOGINFO_KV(lg, "bench", "i", i, "v", 1.5f); }
+void Limited(Logger& lg, int i)  { ARA_LOG_RL(lg, LogLevel::kInfo, 1, 1, "bench {}", i); }
+
+const LogFn kArgFns[] = {Args0, Args1, Args2, Args3, Args4, Args5, Args6};
+
+struct Case {
+  std::string name;
+  std::string sink_name;
+  SinkPtr     sink;
+  LogFn       fn;
+};
+
+// ---- runner -----------------------------------------------------------------
+
+struct Measured {
+  double   ns_per_call;
+  uint64_t p50, p99;
+  double   allocs_per_call;
+};
+
+Measured Run(const Case& c, int threads, long iters, long lat_iters) {
+  auto& LM = LogManager::Instance();
+  LM.ClearSinks();
+  LM.AddSink(c.sink);
+  Logger base = Logger::CreateLogger("BNCH", "logging_bench");
+
+  Measured m{};
+
+  // Throughput pass: no per-call timing
+  std::vector<uint64_t> elapsed(static_cast<size_t>(threads));
+  bench::StartGate gate(threads);
+  std::vector<std::thread> ts;
+  const uint64_t allocs0 = bench::g_allocs.load();
+  for (int t = 0; t < threads; ++t) {
+    ts.emplace_back([&, t] {
+      Logger lg = base;
+      gate.ArriveAndWait();
+      const uint64_t t0 = bench::NowNs();
+      for (long i = 0; i < iters; ++i) c.fn(lg, static_cast<int>(i));
+      elapsed[static_cast<size_t>(t)] = bench::NowNs() - t0;
+    });
+  }
+  for (auto& th : ts) th.join();
+  // thread start/join allocations are noise at these iteration counts
+  const uint64_t allocs = bench::g_allocs.load() - allocs0;
+  uint64_t sum = 0;
+  for (auto e : elapsed) sum += e;
+  const double calls = static_cast<double>(iters) * threads;
+  m.ns_per_call = static_cast<double>(sum) / calls;
+  m.allocs_per_call = static_cast<double>(allocs) / calls;
+
+  // Latency pass: every call timed individually
+  std::vector<std::vector<uint64_t>> lat(static_cast<size_t>(threads));
+  bench::StartGate gate2(threads);
+  ts.clear();
+  for (int t = 0; t < threads; ++t) {
+    ts.emplace_back([&, t] {
+      Logger lg = base;
+      auto& v = lat[static_cast<size_t>(t)];
+      v.resize(static_cast<size_t>(lat_iters));
+      gate2.ArriveAndWait();
+      for (long i = 0; i < lat_iters; ++i) {
+        const uint64_t t0 = bench::NowNs();
+        c.fn(lg, static_cast<int>(i));
+        v[static_cast<size_t>(i)] = bench::NowNs() - t0;
+      }
+    });
+  }
+  for (auto& th : ts) th.join();
+  std::vector<uint64_t> all;
+  for (auto& v : lat) all.insert(all.end(), v.begin(), v.end());
+  m.p50 = bench::Percentile(all, 0.50);
+  m.p99 = bench::Percentile(all, 0.99);
+  return m;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const long iters      = bench::ArgOr(argc, argv, "--iters", 200000);
+  const long lat_iters  = bench::ArgOr(argc, argv, "--lat-iters", 20000);
+  const long hw         = std::max(1u, std::thread::hardware_concurrency());
+  const int  max_thr    = static_cast<int>(bench::ArgOr(argc, argv, "--threads", std::min(4L, hw)));
+  std::string file_path = "/tmp/logging_bench.log";
+  for (int i = 1; i + 1 < argc; ++i) if (std::string_view(argv[i]) == "--file") file_path = argv[i + 1];
+
+  // Console output goes to /dev/null so we measure formatting + stream cost only
+  std::ofstream devnull("/dev/null");
+  auto* saved_cout = std::cout.rdbuf(devnull.rdbuf());
+
+  auto& LM = LogManager::Instance();
+  LM.SetGlobalIds("ECU1", "BNCH");
+  LM.SetDefaultLevel(LogLevel::kInfo);
+
+  auto capture = std::make_shared<CaptureSink>();
+  std::shared_ptr<FlightRecorder> ring = FlightRecorder::Create("logging_bench");
+
+  std::vector<Case> cases;
+  cases.push_back({"disabled_level", "capture", capture, Disabled});
+  for (int n = 0; n <= 6; ++n)
+    cases.push_back({"enabled_args_" + std::to_string(n), "capture", capture, kArgFns[n]});
+  cases.push_back({"kv_fields_2", "capture", capture, Fields2});
+  cases.push_back({"rate_limited_storm", "capture", capture, Limited});
+  cases.push_back({"enabled_args_2", "console_devnull", std::make_shared<ConsoleSink>(), Args2});
+  cases.push_back({"enabled_args_2", "dlt_verbose", MakeDltSink(false), Args2});
+  cases.push_back({"enabled_args_2", "dlt_nonverbose", MakeDltSink(true), Args2});
+  cases.push_back({"enabled_args_2", "file", std::make_shared<FileSink>(file_path), Args2});
+  if (ring)
+    cases.push_back({"enabled_args_2", "flight_recorder", std::make_shared<FlightRecorderSink>(ring), Args2});
+
+  // Powers of two below --threads, then --threads itself
+  std::vector<int> thread_counts;
+  for (int thr = 1; thr < max_thr; thr *= 2) thread_counts.push_back(thr);
+  thread_counts.push_back(std::max(max_thr, 1));
+
+  bench::JsonRows rows;
+  for (const auto& c : cases) {
+    for (const int thr : thread_counts) {
+      const Measured m = Run(c, thr, iters, lat_iters);
+      rows.Add(bench::JsonRows::Row()
+                   .Str("case", c.name)
+                   .Str("sink", c.sink_name)
+                   .Int("threads", static_cast<uint64_t>(thr))
+                   .Num("ns_per_call", m.ns_per_call)
+                   .Int("p50_ns", m.p50)
+                   .Int("p99_ns", m.p99)
+                   .Num("allocs_per_call", m.allocs_per_call));
+    }
+  }
+
+  std::cout.rdbuf(saved_cout);
+  LM.ClearSinks();
+  rows.Print(std::cout, "logging_bench");
+  return 0;
+}
@@ -0,0 +1,307 @@
+// persistency_bench: the persistency engines side by side, per workload and
+// fsync policy.
+//
+//   ./persistency_bench [--ops N] [--keys N] [--value-bytes N] [--file-kb N] [--files N]
+//                       [--enum-keys N] [--enum-iters N] [--sync-every N] [--dir PATH]
+//
+// Workloads, each on a fresh directory:
+//   hot_key      overwrite one 8-byte value ("last_speed") --ops times
+//   mixed_90_10  random reads/writes over --keys keys of --value-bytes,
+//   mixed_50_50  after an untimed preload
+//   large_file   stream --files files of --file-kb in 64 KiB chunks, then
+//                read each back (read_mb_per_sec)
+//   enumerate    list --enum-keys keys --enum-iters times
+//
+// Engines: the kv "file" engine, the same under write-back staging, the kv
+// "log" engine with each durability, and FileStorage with and without group
+// commit. Policies that defer fsync sync every --sync-every ops and once at
+// the end, inside the timed region. New engines go into MakeEngines().
+//
+// Reports ops/s, p50/p99/p99.9 op latency, the bytes the workload asked to
+// store (logical_bytes), the bytes passed to write(2) and the bytes the
+// process caused to be written to the block layer (both from /proc/self/io),
+// and write_amplification = disk_write_bytes / logical_bytes, as JSON on
+// stdout. tmpfs writes reach no block device; point --dir at a real file
+// system for meaningful disk numbers.
+#include "bench_util.hpp"
+
+#include <persistency/key_value_storage_backend.hpp>
+#include <persistency/log_structured_backend.hpp>
+#include <persistency/staged_backend.hpp>
+#include <ara/per/file_storage.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+
+namespace {
+
+// What one engine offers the workloads; lambdas keep the engine alive
+struct Engine {
+  std::function<bool(const std::string&, const std::string&)> write;
+  std::function<bool(const std::string&)> read;
+  std::function<size_t()> enumerate;
+  std::function<bool(const std::string&, const std::string&)> write_large;   // streaming where possible
+  std::function<void()> sync;                                                 // null: every write is durable
+};
+
+struct EngineSpec {
+  std::string name;
+  std::string fsync;
+  std::function<Engine(const std::string& dir)> open;
+};
+
+// Counters from /proc/self/io; zero where the kernel does not provide them
+struct IoCounters {
+  uint64_t wchar{0};         // bytes passed to write-like syscalls
+  uint64_t write_bytes{0};   // bytes sent to the block layer
+};
+
+IoCounters ReadIo() {
+  IoCounters c;
+  std::ifstream in("/proc/self/io");
+  std::string name;
+  uint64_t value = 0;
+  while (in >> name >> value) {
+    if (name == "wchar:") c.wchar = value;
+    else if (name == "write_bytes:") c.write_bytes = value;
+  }
+  return c;
+}
+
+Engine KvEngine(std::shared_ptr<persistency::IKeyValueBackend> kv, bool deferred) {
+  Engine e;
+  e.write = [kv](const std::string& k, const std::string& v) { return kv->SetValue(k, v).HasValue(); };
+  e.read = [kv](const std::string& k) { return kv->GetValue(k).HasValue(); };
+  e.enumerate = [kv] { auto r = kv->GetAllKeys(); return r.HasValue() ? r.Value().size() : 0; };
+  e.write_large = e.write;
+  if (deferred) e.sync = [kv] { (void)kv->SyncToStorage(); };
+  return e;
+}
+
+Engine FilesEngine(std::shared_ptr<ara::per::FileStorage> fs) {
+  Engine e;
+  e.write = [fs](const std::string& k, const std::string& v) {
+    return fs->WriteFile(k, std::vector<uint8_t>(v.begin(), v.end())).HasValue();
+  };
+  e.read = [fs](const std::string& k) { return fs->ReadFile(k).HasValue(); };
+  e.enumerate = [fs] { auto r = fs->ListFiles(); return r.HasValue() ? r.Value().size() : 0; };
+  e.write_large = [fs](const std::string& k, const std::string& v) {
+    auto acc = fs->OpenFileWriteOnly(k);
+    if (!acc.HasValue()) return false;
+    constexpr size_t kChunk = 64 * 1024;
+    for (size_t off = 0; off < v.size(); off += kChunk) {
+      const size_t n = std::min(kChunk, v.size() - off);
+      const auto* p = reinterpret_cast<const uint8_t*>(v.data() + off);
+      if (!acc.Value()->WriteBinary(ara::core::Span<const uint8_t>(p, n)).HasValue()) return false;
+    }
+    return acc.Value()->Close().HasValue();
+  };
+  return e;
+}
+
+std::vector<EngineSpec> MakeEngines() {
+  using persistency::Durability;
+  std::vector<EngineSpec> v;
+  v.push_back({"kv_file", "every_write", [](const std::string& dir) {
+    return KvEngine(std::make_shared<persistency::KeyValueStorageBackend>(dir, SIZE_MAX), false);
+  }});
+  v.push_back({"kv_file_write_back", "on_sync", [](const std::string& dir) {
+    auto inner = std::make_shared<persistency::KeyValueStorageBackend>(dir, SIZE_MAX);
+    return KvEngine(std::make_shared<persistency::StagedKeyValueBackend>(inner), true);
+  }});
+  const std::pair<const char*, Durability> log_policies[] = {
+      {"every_write", Durability::EveryWrite}, {"on_sync", Durability::OnSync}, {"none", Durability::None}};
+  for (const auto& [label, durability] : log_policies) {
+    v.push_back({"kv_log", label, [durability = durability](const std::string& dir) {
+      persistency::LogStructuredBackend::Options opts;
+      opts.durability = durability;
+      auto kv = std::make_shared<persistency::LogStructuredBackend>(dir, SIZE_MAX, opts);
+      return KvEngine(kv, durability != Durability::EveryWrite);
+    }});
+  }
+  v.push_back({"file_storage", "every_write", [](const std::string& dir) {
+    return FilesEngine(std::make_shared<ara::per::FileStorage>(dir));
+  }});
+  v.push_back({"file_storage", "group_commit", [](const std::string& dir) {
+    persistency::GroupCommitOptions gc;
+    gc.enabled = true;
+    return FilesEngine(std::make_shared<ara::per::FileStorage>(dir, SIZE_MAX, gc));
+  }});
+  return v;
+}
+
+struct Params {
+  long ops, keys, value_bytes, file_kb, files, enum_keys, enum_iters, sync_every;
+};
+
+struct Measured {
+  uint64_t ops{0};
+  uint64_t logical_bytes{0};
+  std::vector<uint64_t> lat;
+  double secs{0};
+  double read_mb_per_sec{-1};   // large_file only
+};
+
+std::string KeyName(long i) { return "k" + std::to_string(i); }
+
+// Times fn per op; syncs deferred engines every sync_every writes
+class Timer {
+public:
+  Timer(const Engine& e, const Params& p, Measured& m) : e_(e), p_(p), m_(m) { t0_ = bench::NowNs(); }
+  template<class F> void Op(F&& fn, bool is_write) {
+    const uint64_t t = bench::NowNs();
+    fn();
+    if (is_write && e_.sync && ++writes_ % static_cast<uint64_t>(p_.sync_every) == 0) e_.sync();
+    m_.lat.push_back(bench::NowNs() - t);
+    ++m_.ops;
+  }
+  void Finish() {
+    if (e_.sync) e_.sync();
+    m_.secs = static_cast<double>(bench::NowNs() - t0_) / 1e9;
+  }
+private:
+  const Engine& e_;
+  const Params& p_;
+  Measured& m_;
+  uint64_t t0_{0};
+  uint64_t writes_{0};
+};
+
+void Preload(const Engine& e, long keys, const std::string& value) {
+  for (long i = 0; i < keys; ++i) e.write(KeyName(i), value);
+  if (e.sync) e.sync();
+}
+
+using Workload = std::function<void(const Engine&, const Params&, Measured&, IoCounters&)>;
+
+void HotKey(const Engine& e, const Params& p, Measured& m, IoCounters& io) {
+  io = ReadIo();
+  Timer t(e, p, m);
+  std::string value(8, '\0');
+  for (long i = 0; i < p.ops; ++i) {
+    const double speed = static_cast<double>(i % 250);
+    std::memcpy(value.data(), &speed, sizeof speed);
+    t.Op([&] { e.write("last_speed", value); }, true);
+    m.logical_bytes += sizeof("last_speed") - 1 + value.size();
+  }
+  t.Finish();
+}
+
+Workload Mixed(int read_pct) {
+  return [read_pct](const Engine& e, const Params& p, Measured& m, IoCounters& io) {
+    const std::string value(static_cast<size_t>(p.value_bytes), 'v');
+    Preload(e, p.keys, value);
+    std::mt19937 rng(7);
+    io = ReadIo();
+    Timer t(e, p, m);
+    for (long i = 0; i < p.ops; ++i) {
+      const std::string key = KeyName(static_cast<long>(rng() % static_cast<unsigned>(p.keys)));
+      if (static_cast<int>(rng() % 100) < read_pct) {
+        t.Op([&] { (void)e.read(key); }, false);
+      } else {
+        t.Op([&] { e.write(key, value); }, true);
+        m.logical_bytes += key.size() + value.size();
+      }
+    }
+    t.Finish();
+  };
+}
+
+void LargeFile(const Engine& e, const Params& p, Measured& m, IoCounters& io) {
+  std::string blob(static_cast<size_t>(p.file_kb) * 1024, '\0');
+  std::mt19937 rng(3);
+  for (auto& c : blob) c = static_cast<char>(rng());
+  io = ReadIo();
+  Timer t(e, p, m);
+  for (long i = 0; i < p.files; ++i) {
+    t.Op([&] { e.write_large("blob" + std::to_string(i), blob); }, true);
+    m.logical_bytes += blob.size();
+  }
+  t.Finish();
+
+  const uint64_t r0 = bench::NowNs();
+  for (long i = 0; i < p.files; ++i) (void)e.read("blob" + std::to_string(i));
+  const double secs = static_cast<double>(bench::NowNs() - r0) / 1e9;
+  m.read_mb_per_sec = static_cast<double>(blob.size()) * static_cast<double>(p.files) / (1024.0 * 1024.0) / secs;
+}
+
+void Enumerate(const Engine& e, const Params& p, Measured& m, IoCounters& io) {
+  Preload(e, p.enum_keys, std::string(16, 'v'));
+  io = ReadIo();
+  Timer t(e, p, m);
+  for (long i = 0; i < p.enum_iters; ++i) {
+    t.Op([&] {
+      if (e.enumerate() != static_cast<size_t>(p.enum_keys)) std::cerr << "enumerate: short listing\n";
+    }, false);
+  }
+  t.Finish();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  namespace fs = std::filesystem;
+  Params p;
+  p.ops         = bench::ArgOr(argc, argv, "--ops", 2000);
+  p.keys        = bench::ArgOr(argc, argv, "--keys", 256);
+  p.value_bytes = bench::ArgOr(argc, argv, "--value-bytes", 256);
+  p.file_kb     = bench::ArgOr(argc, argv, "--file-kb", 1024);
+  p.files       = bench::ArgOr(argc, argv, "--files", 8);
+  p.enum_keys   = bench::ArgOr(argc, argv, "--enum-keys", 10000);
+  p.enum_iters  = bench::ArgOr(argc, argv, "--enum-iters", 20);
+  p.sync_every  = std::max(1L, bench::ArgOr(argc, argv, "--sync-every", 100));
+  std::string dir = "/tmp/persistency_bench";
+  for (int i = 1; i + 1 < argc; ++i) if (std::string_view(argv[i]) == "--dir") dir = argv[i + 1];
+
+  const std::vector<std::pair<std::string, Workload>> workloads = {
+      {"hot_key", HotKey},
+      {"mixed_90_10", Mixed(90)},
+      {"mixed_50_50", Mixed(50)},
+      {"large_file", LargeFile},
+      {"enumerate", Enumerate},
+  };
+
+  std::error_code ec;
+  bench::JsonRows rows;
+  for (const auto& [wname, run] : workloads) {
+    for (const auto& spec : MakeEngines()) {
+      const std::string path = dir + "/" + wname + "_" + spec.name + "_" + spec.fsync;
+      fs::remove_all(path, ec);
+      Measured m;
+      IoCounters before;
+      {
+        const Engine e = spec.open(path);
+        run(e, p, m, before);
+      }
+      const IoCounters after = ReadIo();
+      fs::remove_all(path, ec);
+
+      const uint64_t wchar = after.wchar - before.wchar;
+      const uint64_t disk = after.write_bytes - before.write_bytes;
+      bench::JsonRows::Row row;
+      row.Str("workload", wname)
+         .Str("engine", spec.name)
+         .Str("fsync", spec.fsync)
+         .Int("ops", m.ops)
+         .Num("ops_per_sec", static_cast<double>(m.ops) / m.secs)
+         .Int("p50_ns", bench::Percentile(m.lat, 0.50))
+         .Int("p99_ns", bench::Percentile(m.lat, 0.99))
+         .Int("p999_ns", bench::Percentile(m.lat, 0.999))
+         .Int("logical_bytes", m.logical_bytes)
+         .Int("syscall_write_bytes", wchar)
+         .Int("disk_write_bytes", disk)
+         .Num("write_amplification",
+              m.logical_bytes ? static_cast<double>(disk) / static_cast<double>(m.logical_bytes) : 0.0);
+      if (m.read_mb_per_sec >= 0) row.Num("read_mb_per_sec", m.read_mb_per_sec);
+      rows.Add(row);
+    }
+  }
+
+  fs::remove_all(dir, ec);
+  rows.Print(std::cout, "persistency_bench");
+  return 0;
+}
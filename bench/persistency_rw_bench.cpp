@@ -0,0 +1,146 @@
+// persistency_rw_bench: read scaling of the persistency back ends while a
+// writer keeps fsync'ing.
+//
+//   ./persistency_rw_bench [--ms N] [--threads MAX] [--keys N] [--value-bytes N] [--dir PATH]
+//
+// For each store (kv file engine, kv log engine with every_write, FileStorage)
+// and for 1..MAX reader threads, one writer thread overwrites random keys as
+// fast as it can while the readers read random keys for --ms milliseconds.
+// Reports total and per-thread reads/s, p50/p99 read latency and the writer's
+// rate, as JSON on stdout. With reads off the write path, reads/s should grow
+// with the reader count and p99 should stay far below one fsync.
+#include "bench_util.hpp"
+
+#include <persistency/key_value_storage_backend.hpp>
+#include <persistency/log_structured_backend.hpp>
+#include <ara/per/file_storage.hpp>
+
+#include <filesystem>
+#include <functional>
+#include <random>
+
+namespace {
+
+struct Store {
+  std::string name;
+  std::function<bool(const std::string&)> read;
+  std::function<bool(const std::string&, const std::string&)> write;
+};
+
+struct Measured {
+  uint64_t reads{0};
+  uint64_t writes{0};
+  uint64_t p50{0};
+  uint64_t p99{0};
+  double   secs{0};
+};
+
+std::string KeyName(long i) { return "k" + std::to_string(i); }
+
+Measured Run(const Store& s, int readers, long ms, long keys, const std::string& value) {
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> writes{0};
+  std::vector<uint64_t> reads(static_cast<size_t>(readers));
+  std::vector<std::vector<uint64_t>> lat(static_cast<size_t>(readers));
+  bench::StartGate gate(readers + 1);
+
+  std::vector<std::thread> ts;
+  ts.emplace_back([&] {
+    std::mt19937 rng(1);
+    gate.ArriveAndWait();
+    while (!stop.load(std::memory_order_relaxed)) {
+      if (s.write(KeyName(static_cast<long>(rng() % static_cast<unsigned>(keys))), value))
+        writes.fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+  for (int t = 0; t < readers; ++t) {
+    ts.emplace_back([&, t] {
+      std::mt19937 rng(static_cast<unsigned>(t) + 2);
+      auto& v = lat[static_cast<size_t>(t)];
+      v.reserve(1u << 20);
+      gate.ArriveAndWait();
+      uint64_t n = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        const std::string key = KeyName(static_cast<long>(rng() % static_cast<unsigned>(keys)));
+        const uint64_t t0 = bench::NowNs();
+        (void)s.read(key);
+        if (v.size() < v.capacity()) v.push_back(bench::NowNs() - t0);
+        ++n;
+      }
+      reads[static_cast<size_t>(t)] = n;
+    });
+  }
+
+  const uint64_t t0 = bench::NowNs();
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  stop = true;
+  for (auto& th : ts) th.join();
+
+  Measured m;
+  m.secs = static_cast<double>(bench::NowNs() - t0) / 1e9;
+  for (auto r : reads) m.reads += r;
+  m.writes = writes.load();
+  std::vector<uint64_t> all;
+  for (auto& v : lat) all.insert(all.end(), v.begin(), v.end());
+  m.p50 = bench::Percentile(all, 0.50);
+  m.p99 = bench::Percentile(all, 0.99);
+  return m;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  namespace fs = std::filesystem;
+  const long ms       = bench::ArgOr(argc, argv, "--ms", 1000);
+  const long keys     = bench::ArgOr(argc, argv, "--keys", 256);
+  const long vbytes   = bench::ArgOr(argc, argv, "--value-bytes", 256);
+  const long hw       = std::max(1u, std::thread::hardware_concurrency());
+  const int  max_thr  = static_cast<int>(bench::ArgOr(argc, argv, "--threads", std::min(8L, hw)));
+  std::string dir = "/tmp/persistency_rw_bench";
+  for (int i = 1; i + 1 < argc; ++i) if (std::string_view(argv[i]) == "--dir") dir = argv[i + 1];
+
+  std::error_code ec;
+  fs::remove_all(dir, ec);
+  const std::string value(static_cast<size_t>(vbytes), 'v');
+
+  auto kv_file = std::make_shared<persistency::KeyValueStorageBackend>(dir + "/kv_file", SIZE_MAX);
+  persistency::LogStructuredBackend::Options lopts;
+  lopts.durability = persistency::Durability::EveryWrite;
+  auto kv_log = std::make_shared<persistency::LogStructuredBackend>(dir + "/kv_log", SIZE_MAX, lopts);
+  auto files = std::make_shared<ara::per::FileStorage>(dir + "/files");
+
+  std::vector<Store> stores;
+  stores.push_back({"kv_file",
+                    [&](const std::string& k) { return kv_file->GetValue(k).HasValue(); },
+                    [&](const std::string& k, const std::string& v) { return kv_file->SetValue(k, v).HasValue(); }});
+  stores.push_back({"kv_log_every_write",
+                    [&](const std::string& k) { return kv_log->GetValue(k).HasValue(); },
+                    [&](const std::string& k, const std::string& v) { return kv_log->SetValue(k, v).HasValue(); }});
+  const std::vector<uint8_t> bytes(value.begin(), value.end());
+  stores.push_back({"file_storage",
+                    [&](const std::string& k) { return files->ReadFile(k).HasValue(); },
+                    [&](const std::string& k, const std::string&) { return files->WriteFile(k, bytes).HasValue(); }});
+
+  for (const auto& s : stores)
+    for (long i = 0; i < keys; ++i) s.write(KeyName(i), value);
+
+  bench::JsonRows rows;
+  for (const auto& s : stores) {
+    for (int thr = 1; thr <= max_thr; thr *= 2) {
+      const Measured m = Run(s, thr, ms, keys, value);
+      const double rps = static_cast<double>(m.reads) / m.secs;
+      rows.Add(bench::JsonRows::Row()
+                   .Str("store", s.name)
+                   .Int("readers", static_cast<uint64_t>(thr))
+                   .Num("reads_per_sec", rps)
+                   .Num("reads_per_sec_per_thread", rps / thr)
+                   .Int("read_p50_ns", m.p50)
+                   .Int("read_p99_ns", m.p99)
+                   .Num("writes_per_sec", static_cast<double>(m.writes) / m.secs));
+    }
+  }
+
+  fs::remove_all(dir, ec);
+  rows.Print(std::cout, "persistency_rw_bench");
+  return 0;
+}
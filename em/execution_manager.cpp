@@ -7,15 +7,21 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <cerrno>
 #include <unordered_map>
 #include <log.hpp>
 #include <sinks_console.hpp>
+#include <sinks_flight_recorder.hpp>
 #include <persistency/storage_registry.hpp>
 #include "someip_binding.hpp"
 #include <vsomeip/vsomeip.hpp>
 #include <phm/phm_ids.hpp>
+#include <phm/heartbeat_slot.hpp>
 #include <phm/phm_supervisor.hpp>
+#include <phm/timer_wheel.hpp>
 #include <arpa/inet.h>
 #include <cstring>
 #include <csignal>
@@ -25,6 +31,7 @@
 #include <sstream>
 #include <cstdlib>
 #include <unordered_set>
+#include <algorithm>
 
 
 // #include "sinks_dlt.hpp"   // enable later when we can start dlt-daemon
@@ -49,6 +56,11 @@ struct AppConfig {
         int allowed_missed_cycles{3};
         std::vector<std::uint32_t> required_checkpoints;
         bool require_alive{false};
+        // logical supervision graph ("logical" object)
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> transitions;
+        std::vector<std::uint32_t> initial_checkpoints;
+        std::vector<std::uint32_t> final_checkpoints;
+        std::vector<PhmSupervisor::Config::Deadline> deadlines;
     }phm{};
     struct{
         uint16_t service_id{0};
@@ -56,6 +68,11 @@ struct AppConfig {
         uint16_t event_group{0x0001}; // default event group
         std::vector<uint16_t> subscribe_events;
     }com{};
+    struct{
+        bool enabled{true};
+        size_t slots{FlightRecorder::kDefaultSlots};
+        size_t dump_records{32};   // printed after an abnormal exit
+    }flight_recorder{};
 };
 
 // Build SOMEIP_REQUEST_EVENTS env var from manifest for this app.
@@ -107,17 +124,24 @@ build_client_to_appid_map(const std::string& vsomeip_config_path,
 
 
 //Monitoring apps
+static PhmSupervisor::Config supervisor_config(const AppConfig& cfg) {
+    PhmSupervisor::Config c;
+    c.supervision_cycle_ms = cfg.phm.period_ms;
+    c.allowed_missed_cycles = cfg.phm.allowed_missed_cycles;
+    c.required_checkpoints = cfg.phm.required_checkpoints;
+    c.allowed_transitions = cfg.phm.transitions;
+    c.initial_checkpoints = cfg.phm.initial_checkpoints;
+    c.final_checkpoints = cfg.phm.final_checkpoints;
+    c.deadlines = cfg.phm.deadlines;
+    return c;
+}
+
 struct AppMonitor {
-    PhmSupervisor sup;
+    PhmSupervisor sup;   // not movable: built in place, attached to the PHM timer wheel
     // constructor that injects config
-    explicit AppMonitor(const AppConfig& cfg) {
-        PhmSupervisor::Config c;
-        c.supervision_cycle_ms = cfg.phm.period_ms;
-        c.allowed_missed_cycles = cfg.phm.allowed_missed_cycles;
-        c.required_checkpoints = cfg.phm.required_checkpoints;
-        sup = PhmSupervisor(c);
-    }
+    explicit AppMonitor(const AppConfig& cfg) : sup(supervisor_config(cfg)) {}
     bool require_alive{false}; // separate flag from manifest
+    std::shared_ptr<phm::HeartbeatSlot> heartbeat;   // shared-memory reports; SOME/IP if null
 };
 
 // Load manifest files
@@ -166,6 +190,40 @@ std::vector<AppConfig> load_manifests(const std::string& path) {
                     }
                 }
             }
+
+            // "logical": {"initial": [..], "final": [..], "transitions": [[from, to], ..]}
+            if (p.contains("logical") && p["logical"].is_object()) {
+                const auto& l = p["logical"];
+                auto cp_id = [](const nlohmann::json& v) -> uint32_t {
+                    if (v.is_string()) return static_cast<uint32_t>(std::stoul(v.get<std::string>(), nullptr, 0));
+                    return v.get<uint32_t>();
+                };
+                auto cp_list = [&](const char* key, std::vector<uint32_t>& out) {
+                    if (!l.contains(key) || !l[key].is_array()) return;
+                    for (const auto& it : l[key]) out.push_back(cp_id(it));
+                };
+                cp_list("initial", app.phm.initial_checkpoints);
+                cp_list("final", app.phm.final_checkpoints);
+                if (l.contains("transitions") && l["transitions"].is_array()) {
+                    for (const auto& t : l["transitions"]) {
+                        if (t.is_array() && t.size() == 2)
+                            app.phm.transitions.emplace_back(cp_id(t[0]), cp_id(t[1]));
+                    }
+                }
+            }
+
+            // "deadlines": [{"from": .., "to": .., "min_ms": .., "max_ms": ..}, ..]
+            if (p.contains("deadlines") && p["deadlines"].is_array()) {
+                auto cp_id = [](const nlohmann::json& v) -> uint32_t {
+                    if (v.is_string()) return static_cast<uint32_t>(std::stoul(v.get<std::string>(), nullptr, 0));
+                    return v.get<uint32_t>();
+                };
+                for (const auto& d : p["deadlines"]) {
+                    if (!d.is_object() || !d.contains("from") || !d.contains("to")) continue;
+                    app.phm.deadlines.push_back({cp_id(d["from"]), cp_id(d["to"]),
+                                                 d.value("min_ms", 0), d.value("max_ms", 0)});
+                }
+            }
         }
 
         // com.someip
@@ -194,6 +252,14 @@ std::vector<AppConfig> load_manifests(const std::string& path) {
             }
         }
 
+        // flight recorder (post-mortem log ring)
+        if (j.contains("flight_recorder") && j["flight_recorder"].is_object()) {
+            const auto& f = j["flight_recorder"];
+            app.flight_recorder.enabled      = f.value("enabled", true);
+            app.flight_recorder.slots        = f.value("slots", app.flight_recorder.slots);
+            app.flight_recorder.dump_records = f.value("dump_records", app.flight_recorder.dump_records);
+        }
+
         // Skip non-app JSONs (e.g., persistency.json)
         if (app.app_id.empty() || app.executable.empty())
             continue;
@@ -206,13 +272,24 @@ std::vector<AppConfig> load_manifests(const std::string& path) {
 
 
 // Launch application and return PID
-pid_t launch_app(const AppConfig& app, const std::string& extra_env = {}) {
+pid_t launch_app(const AppConfig& app, const std::string& extra_env = {}, int flight_fd = -1,
+                 int heartbeat_fd = -1) {
     pid_t pid = fork();
     if (pid == 0) {
         // Child process
         if (!extra_env.empty()){
             ::setenv("SOMEIP_REQUEST_EVENTS", extra_env.c_str(), 1);
         }
+        if (flight_fd >= 0) {
+            // The ring is created close-on-exec; only this child gets to keep it
+            ::fcntl(flight_fd, F_SETFD, 0);
+            ::setenv(kFlightRecorderFdEnv, std::to_string(flight_fd).c_str(), 1);
+        }
+        if (heartbeat_fd >= 0) {
+            // Same for the PHM heartbeat slot
+            ::fcntl(heartbeat_fd, F_SETFD, 0);
+            ::setenv(phm::kHeartbeatFdEnv, std::to_string(heartbeat_fd).c_str(), 1);
+        }
         execl(app.executable.c_str(), app.executable.c_str(), nullptr);
         perror("execl failed");
         exit(1);
@@ -226,6 +303,18 @@ pid_t launch_app(const AppConfig& app, const std::string& extra_env = {}) {
     }
 }
 
+// Print the tail of an app's flight recorder after it died abnormally
+static void dump_flight_recorder(const std::string& app_id, const FlightRecorder& ring, size_t n) {
+    const auto recs = ring.ReadLast(n);
+    if (recs.empty()) return;
+    std::cerr << "[EM] Flight recorder for " << app_id << " (last "
+              << recs.size() << " records):\n";
+    for (const auto& r : recs) {
+        std::cerr << "[EM]   #" << r.seq << " [" << ToString(r.level) << "] "
+                  << r.ctx_id << ": " << r.message << "\n";
+    }
+}
+
 static void register_phm_handlers(
     std::unordered_map<std::string, AppMonitor>& mon_by_app,
     const std::unordered_map<uint16_t, std::string>& app_by_client) {
@@ -281,7 +370,29 @@ static void register_phm_handlers(
 
 //Used for better shutdown behavior
 static std::atomic_bool running{true};
-static void on_sig(int){ running=false; }
+// eventfd the main loop sleeps on; written by the signal handlers and the
+// PHM timer wheel (write() is async-signal-safe)
+static int wake_fd = -1;
+static void wake_main_loop() {
+    const uint64_t one = 1;
+    if (wake_fd >= 0) { ssize_t r = ::write(wake_fd, &one, sizeof one); (void)r; }
+}
+static void on_sig(int){ running=false; wake_main_loop(); }
+static void on_chld(int){ wake_main_loop(); }
+
+// Sleeps until `until`, or less if wake_main_loop() is called
+static void wait_for_wakeup(std::chrono::steady_clock::time_point until) {
+    int timeout_ms = -1;
+    if (until != std::chrono::steady_clock::time_point::max()) {
+        const auto left = std::chrono::ceil<std::chrono::milliseconds>(until - std::chrono::steady_clock::now());
+        timeout_ms = static_cast<int>(std::clamp<long long>(left.count(), 0, 60000));
+    }
+    pollfd pfd{wake_fd, POLLIN, 0};
+    if (::poll(&pfd, 1, timeout_ms) > 0) {
+        uint64_t n = 0;
+        ssize_t r = ::read(wake_fd, &n, sizeof n); (void)r;
+    }
+}
 
 int main() {
 
@@ -289,8 +400,10 @@ int main() {
     std::string config_path  = manifest_dir + "/persistency.json";
 
     //For better shutdown
+    wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
     std::signal(SIGINT, on_sig);
     std::signal(SIGTERM, on_sig);
+    std::signal(SIGCHLD, on_chld);   // a child exit ends the wait for the next PHM timer
 
     auto r = persistency::StorageRegistry::Instance().InitFromFile(config_path);
     if (!r.HasValue()) {
@@ -314,10 +427,11 @@ int main() {
     //PhmSupervisor phm;
     //register_phm_handlers(phm);
     //phm.maintenance_tick(); //Moved to loop below
-    // Periodic PHM maintenance (100 ms cadence; adjust according to system requirements)
+    // Every supervisor's cycle end and deadline is a timer on one wheel; the
+    // loop below sleeps until the earliest of them instead of polling
     using clock = std::chrono::steady_clock;
-    const auto tick_period = std::chrono::milliseconds(100);
-    auto next_tick = clock::now() + tick_period;
+    phm::TimerWheel phm_wheel(std::chrono::milliseconds(1));
+    phm_wheel.set_wakeup(wake_main_loop);   // a deadline armed from the SOME/IP thread
 
     // Maps
     std::unordered_map<std::string, AppConfig>  app_by_id;    // app_id -> config
@@ -336,16 +450,27 @@ int main() {
         const bool has_phm =
             (a.phm.period_ms > 0) ||
             a.phm.require_alive ||
-            !a.phm.required_checkpoints.empty(); //TODO: required checkpoints seem redundant? Remove later
+            !a.phm.required_checkpoints.empty() ||
+            !a.phm.transitions.empty() ||
+            !a.phm.deadlines.empty(); //TODO: required checkpoints seem redundant? Remove later
 
         if (has_phm) {
-            AppMonitor m(a);                         // uses AppConfig-based ctor
+            // insert once; no operator[] + emplace combo
+            auto [it, inserted] = mon_by_app.try_emplace(a.app_id, a);   // uses AppConfig-based ctor
+            if (!inserted) continue;
+            AppMonitor& m = it->second;
             m.require_alive = a.phm.require_alive;   // carry the flag if you use it separately
             m.sup.set_violation_callback([aid = a.app_id](const char* reason){
                 std::cerr << "[PHM] Violation in " << aid << ": "
                         << (reason ? reason : "") << "\n";
             });
-            mon_by_app.emplace(a.app_id, std::move(m)); // insert once; no operator[] + emplace combo
+            m.sup.attach(phm_wheel);   // map nodes stay put
+
+            // Local apps report alive/checkpoints through shared memory; the
+            // SOME/IP handlers below stay for entities we did not launch
+            m.heartbeat = phm::HeartbeatSlot::create(a.app_id);
+            if (m.heartbeat) m.sup.attach_heartbeat(m.heartbeat);
+            else std::cerr << "[EM] No heartbeat slot for " << a.app_id << "; PHM reports go over SOME/IP\n";
         }
     }
 
@@ -361,6 +486,27 @@ int main() {
     std::map<std::string, int> restart_count;
     const int max_restarts = 3;
 
+    // One flight recorder per app, kept across restarts
+    std::unordered_map<std::string, std::unique_ptr<FlightRecorder>> recorder_by_app;
+    for (const auto& a : apps) {
+        if (!a.flight_recorder.enabled) continue;
+        auto ring = FlightRecorder::Create(a.app_id, a.flight_recorder.slots);
+        if (!ring) {
+            std::cerr << "[EM] Could not create flight recorder for " << a.app_id << "\n";
+            continue;
+        }
+        recorder_by_app.emplace(a.app_id, std::move(ring));
+    }
+    auto flight_fd_for = [&](const std::string& app_id) {
+        auto it = recorder_by_app.find(app_id);
+        return it != recorder_by_app.end() ? it->second->Fd() : -1;
+    };
+    // Kept across restarts too: the slot's counters only grow
+    auto heartbeat_fd_for = [&](const std::string& app_id) {
+        auto it = mon_by_app.find(app_id);
+        return it != mon_by_app.end() && it->second.heartbeat ? it->second.heartbeat->fd() : -1;
+    };
+
     // Start apps marked with start_on_boot
     // Removing (but keep for reference if it doesn't work) to handle multiple handlers
     //for (const auto& app : apps) {
@@ -423,7 +569,7 @@ int main() {
     for (const auto& id : topo) {
         const auto& app = app_by_id[id];
         const auto env = build_someip_env(app);
-        pid_t pid = launch_app(app, env);
+        pid_t pid = launch_app(app, env, flight_fd_for(app.app_id), heartbeat_fd_for(app.app_id));
         if (pid > 0) {
             running_apps[pid] = app;
             restart_count[app.app_id] = 0;
@@ -435,19 +581,9 @@ int main() {
     using namespace std::chrono_literals;
 
     while (running) {
-        // PHM periodic tick
-        //Run at ~100 ms regardless of child process activity
-        auto now = clock::now();
-        if (now >= next_tick) {
-            // If we were busy (e.g., reaping), catch up without drifting.
-            do {
-                for (auto& [aid, mon] : mon_by_app) {
-                    mon.sup.maintenance_tick();
-                }
-                next_tick += tick_period;
-                now = clock::now();
-            } while (running && now >= next_tick);
-        }
+        // PHM: only the supervisors whose cycle or deadline is up do any work
+        phm_wheel.advance(clock::now());
+
         int status = 0;
         pid_t pid = waitpid(-1, &status, WNOHANG);
 
@@ -463,6 +599,11 @@ int main() {
                 (WIFEXITED(status) && WEXITSTATUS(status) != 0) ||
                 (WIFSIGNALED(status));
 
+                if (auto fr = recorder_by_app.find(app.app_id); fr != recorder_by_app.end()) {
+                    if (failed) dump_flight_recorder(app.app_id, *fr->second, app.flight_recorder.dump_records);
+                    fr->second->Reset();
+                }
+
                 if (app.restart_policy == "on-failure" && failed) {
                     int& cnt = restart_count[app.app_id];
                     ++cnt;
@@ -470,7 +611,8 @@ int main() {
                         std::cout << "[EM] Restarting app: " << app.app_id
                                 << " (Attempt " << cnt << ")" << std::endl;
                         const auto env = build_someip_env(app);
-                        pid_t new_pid = launch_app(app, env);
+                        pid_t new_pid = launch_app(app, env, flight_fd_for(app.app_id),
+                                                   heartbeat_fd_for(app.app_id));
                         if (new_pid > 0) {
                             running_apps[new_pid] = app;
                         }
@@ -484,8 +626,9 @@ int main() {
         }
 
         if (pid == 0) {
-            // no child changed -> short sleep to avoid busy spin
-            std::this_thread::sleep_for(100ms);
+            // no child changed -> sleep until the next PHM timer, a child
+            // exit or a signal
+            wait_for_wakeup(phm_wheel.next_expiry());
             continue;
         }
 
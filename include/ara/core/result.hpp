@@ -14,7 +14,10 @@ enum class PersistencyErrc {
     kQuotaExceeded,
     kCorruption,
     kPermissionDenied,
-    kUnknown
+    kUnknown,
+    kIsEof,             // accessor read at end of file
+    kInvalidPosition,   // accessor seek outside the file
+    kResourceBusy       // storage is open; the operation needs it closed
 };
 
 class ErrorCode {
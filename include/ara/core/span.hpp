@@ -0,0 +1,51 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace ara::core {
+
+// Minimal non-owning view over contiguous elements (C++17 has no std::span).
+template <typename T>
+class Span {
+public:
+    using element_type = T;
+    using value_type   = std::remove_cv_t<T>;
+
+    constexpr Span() noexcept = default;
+    constexpr Span(T* data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+    template <std::size_t N>
+    constexpr Span(T (&arr)[N]) noexcept : data_(arr), size_(N) {}
+
+    template <typename U, std::size_t N,
+              typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr Span(std::array<U, N>& arr) noexcept : data_(arr.data()), size_(N) {}
+
+    template <typename U, std::size_t N,
+              typename = std::enable_if_t<std::is_convertible_v<const U (*)[], T (*)[]>>>
+    constexpr Span(const std::array<U, N>& arr) noexcept : data_(arr.data()), size_(N) {}
+
+    template <typename U, typename A,
+              typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    Span(std::vector<U, A>& v) noexcept : data_(v.data()), size_(v.size()) {}
+
+    template <typename U, typename A,
+              typename = std::enable_if_t<std::is_convertible_v<const U (*)[], T (*)[]>>>
+    Span(const std::vector<U, A>& v) noexcept : data_(v.data()), size_(v.size()) {}
+
+    constexpr T* data() const noexcept { return data_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr std::size_t size_bytes() const noexcept { return size_ * sizeof(T); }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T& operator[](std::size_t i) const noexcept { return data_[i]; }
+    constexpr T* begin() const noexcept { return data_; }
+    constexpr T* end() const noexcept { return data_ + size_; }
+
+private:
+    T* data_{nullptr};
+    std::size_t size_{0};
+};
+
+} // namespace ara::core
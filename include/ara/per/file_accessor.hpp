@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ara/core/result.hpp>
+#include <ara/core/span.hpp>
+#include <persistency/compression.hpp>
+
+namespace ara::per {
+
+class FileStorage;
+
+template <typename T>
+using UniqueHandle = std::unique_ptr<T>;
+
+enum class Origin : uint8_t { kBeginning, kCurrent, kEnd };
+
+// Positioned access to one file of a FileStorage. Every read goes straight
+// into the caller's buffer (or one sized to the request), so memory use does
+// not depend on the file size; a compressed file is decoded one block at a
+// time (persistency::BlockReader). A reader keeps the file it opened: a
+// concurrent WriteFile replaces the name, not the open file.
+class ReadAccessor {
+public:
+    virtual ~ReadAccessor() noexcept;
+    ReadAccessor(const ReadAccessor&) = delete;
+    ReadAccessor& operator=(const ReadAccessor&) = delete;
+
+    ara::core::Result<char> PeekChar() const noexcept;
+    ara::core::Result<char> GetChar() noexcept;
+    ara::core::Result<std::string> ReadText() noexcept;                 // up to the end
+    ara::core::Result<std::string> ReadText(uint64_t n) noexcept;
+    ara::core::Result<std::string> ReadLine(char delimiter = '\n') noexcept;   // delimiter consumed, not returned
+    ara::core::Result<std::vector<uint8_t>> ReadBinary(uint64_t n) noexcept;
+    // Fills buf from the current position; returns the filled prefix (shorter at EOF)
+    ara::core::Result<ara::core::Span<uint8_t>> ReadBinary(ara::core::Span<uint8_t> buf) noexcept;
+
+    uint64_t GetPosition() const noexcept { return pos_; }
+    ara::core::Result<void> SetPosition(uint64_t pos) noexcept;
+    ara::core::Result<int64_t> MovePosition(Origin origin, int64_t offset) noexcept;   // new position
+    bool IsEof() const noexcept { return pos_ >= GetSize(); }
+    uint64_t GetSize() const noexcept;
+
+protected:
+    friend class FileStorage;
+    explicit ReadAccessor(int fd) noexcept : fd_(fd) {}
+    ssize_t ReadAt_(void* buf, size_t n, uint64_t off) const noexcept;   // raw content
+
+    int fd_;
+    uint64_t pos_{0};
+    std::unique_ptr<::persistency::BlockReader> blocks_;   // set for a compressed file
+};
+
+// Writes go to a private working copy next to the file; Close() (or the
+// destructor) makes it durable and renames it over the file, so readers only
+// ever see the old or the complete new content. The accessor must not
+// outlive its FileStorage.
+class ReadWriteAccessor : public ReadAccessor {
+public:
+    ~ReadWriteAccessor() noexcept override;   // Close(), errors dropped
+
+    ara::core::Result<void> WriteText(std::string_view text) noexcept;
+    ara::core::Result<void> WriteBinary(ara::core::Span<const uint8_t> data) noexcept;
+    ara::core::Result<void> SetFileSize(uint64_t size) noexcept;
+    ara::core::Result<void> SyncToFile() noexcept;   // fsync the working copy; not yet visible
+    // Commit: fsync, rename over the file, fsync the directory. After a
+    // failed write the working copy is dropped instead and kUnknown returned.
+    ara::core::Result<void> Close() noexcept;
+
+    ReadWriteAccessor& operator<<(std::string_view text) noexcept;
+
+private:
+    friend class FileStorage;
+    ReadWriteAccessor(int fd, FileStorage& storage, std::string rel, std::string tmp,
+                      uint64_t max_size) noexcept
+        : ReadAccessor(fd), storage_(storage), rel_(std::move(rel)), tmp_(std::move(tmp)),
+          max_size_(max_size) {}
+
+    FileStorage& storage_;
+    std::string rel_;         // target, relative to the storage
+    std::string tmp_;         // working copy, absolute
+    uint64_t max_size_;       // quota headroom at open
+    bool failed_{false};
+    bool closed_{false};
+};
+
+} // namespace ara::per
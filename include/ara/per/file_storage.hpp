@@ -1,42 +1,143 @@
 #pragma once
+#include <condition_variable>
 #include <cstdint>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <ara/core/result.hpp>
 #include <ara/core/instance_specifier.hpp>
+#include <ara/per/file_accessor.hpp>
+#include <persistency/compression.hpp>
+#include <persistency/group_commit.hpp>
+#include <persistency/io_scheduler.hpp>
+#include <persistency/lock_stripes.hpp>
+#include <persistency/mapped_file.hpp>
 
 namespace ara::per {
 
+// Reads take no lock: writes go through tmp + rename, so a reader sees the
+// old or the new file. Writers serialize per path (lock stripe) and only
+// briefly on mtx_ to check and reserve quota; neither the file nor the
+// directory fsync happens under mtx_.
+//
+// The committed files and their sizes are indexed once at construction and
+// kept current by every commit and remove, so a quota check costs O(1) and
+// ListFiles O(files) without touching the directory tree. Changes made
+// behind the storage's back are only seen with watch_external (inotify,
+// Linux), which re-stats the paths the kernel reports before each check.
+//
+// With an io queue every write is admitted by persistency::IoScheduler
+// first, once its path lock and quota are settled.
+//
+// With compression, files of at least min_bytes are stored as a block
+// container (persistency/compression.hpp) when that saves space; quota,
+// admission and GetUsedSpace count the stored bytes. Reads decode
+// transparently, accessors one block at a time.
 class FileStorage {
 public:
-    explicit FileStorage(const std::string& base_path, size_t quota_bytes = SIZE_MAX);
+    explicit FileStorage(const std::string& base_path, size_t quota_bytes = SIZE_MAX,
+                         ::persistency::GroupCommitOptions group_commit = {},
+                         bool watch_external = false,
+                         ::persistency::IoScheduler::QueueHandle io = {},
+                         ::persistency::CompressionOptions compression = {});
+    ~FileStorage();   // waits for WriteFileAsync calls still in flight
 
     ara::core::Result<void> WriteFile(std::string_view path,
                                       const std::vector<uint8_t>& data) noexcept;
     ara::core::Result<std::vector<uint8_t>> ReadFile(std::string_view path) const noexcept;
+
+    // WriteFile without blocking the caller: quota is checked and reserved
+    // up front, the write/fsync/rename then runs on persistency::AsyncIo.
+    // Async writes to one path commit in call order; they are not ordered
+    // against a concurrent synchronous WriteFile of the same path.
+    std::future<ara::core::Result<void>> WriteFileAsync(std::string_view path,
+                                                        std::vector<uint8_t> data) noexcept;
     ara::core::Result<void> RemoveFile(std::string_view path) noexcept;
     ara::core::Result<std::vector<std::string>> ListFiles() const noexcept;
 
+    // In-place updates of large files: only the changed bytes reach the
+    // disk, plus what they overwrite in an undo journal ("<name>.undo") from
+    // which the next open rolls back a write a crash cut short (see
+    // persistency/undo_journal.hpp). Unlike WriteFile they are not atomic
+    // towards readers: open accessors and mapped views may see a range half
+    // written. offset may not lie past the end; a missing file is created.
+    // Not ordered against a concurrent WriteFileAsync of the same path.
+    // A compressed file is rewritten whole (tmp + rename) instead.
+    ara::core::Result<void> WriteRange(std::string_view path, uint64_t offset,
+                                       ara::core::Span<const uint8_t> data) noexcept;
+    ara::core::Result<void> Append(std::string_view path, ara::core::Span<const uint8_t> data) noexcept;
+
+    // Zero-copy read of a whole file through the process-wide mapping
+    // cache; repeated reads of a hot file cost no syscall. The view keeps
+    // the version it was taken from alive, even across a later WriteFile.
+    // A compressed file is decoded into a private buffer instead.
+    ara::core::Result<::persistency::MappedView> ReadFileMapped(std::string_view path) const noexcept;
+
+    // Streaming access for files too large to hold in one buffer.
+    // WriteOnly starts empty, ReadWrite from a copy of the current content;
+    // both commit with tmp + rename on ReadWriteAccessor::Close().
+    ara::core::Result<UniqueHandle<ReadAccessor>> OpenFileReadOnly(std::string_view path) const noexcept;
+    ara::core::Result<UniqueHandle<ReadWriteAccessor>> OpenFileReadWrite(std::string_view path) noexcept;
+    ara::core::Result<UniqueHandle<ReadWriteAccessor>> OpenFileWriteOnly(std::string_view path) noexcept;
+
     size_t GetUsedSpace() const;
 
     ara::core::Result<void> SyncToStorage() const noexcept;
     ara::core::Result<void> DiscardPendingChanges() const noexcept;
 
 private:
+    friend class ReadWriteAccessor;
+    ara::core::Result<void> WriteFile_(std::string_view path, const std::vector<uint8_t>& data,
+                                       bool admit) noexcept;
+    ara::core::Result<void> ReplaceLocked_(const std::string& file, const std::string& key,
+                                           const std::vector<uint8_t>& stored, bool admit) noexcept;
+    ara::core::Result<UniqueHandle<ReadWriteAccessor>> OpenForWrite_(std::string_view path, bool keep) noexcept;
+    ara::core::Result<void> CommitWorkingCopy_(const std::string& rel, const std::string& tmp) noexcept;
+    ara::core::Result<void> WriteInPlace_(std::string_view rel, uint64_t offset,
+                                          ara::core::Span<const uint8_t> data) noexcept;
+
+    // Index upkeep; the NoLock_ variants expect mtx_ held
+    void Committed_(const std::string& key, uint64_t size);
+    void Removed_(const std::string& key);
+    uint64_t IndexedSizeNoLock_(const std::string& key) const;
+    void RescanNoLock_(std::vector<std::string>* journals = nullptr) const;
+    void RevalidateNoLock_() const;
+    void WatchDirNoLock_(const std::string& rel_dir) const;
+
     std::string base_path_;
     size_t quota_;
-    mutable std::mutex mtx_;
+    ::persistency::GroupCommitOptions group_commit_;
+    ::persistency::IoScheduler::QueueHandle io_;   // null: not scheduled
+    ::persistency::CompressionOptions compression_;
+    mutable std::mutex mtx_;                   // quota check, reserved_ and the index
+    size_t reserved_{0};                       // growth of writes in flight
+    // Committed files (normalized relative path -> size) and their total;
+    // mutable so that const readers can fold in inotify events
+    mutable std::unordered_map<std::string, uint64_t> index_;
+    mutable size_t used_{0};
+    int inotify_fd_{-1};                       // watch_external only
+    mutable std::unordered_map<int, std::string> watch_dirs_;   // wd -> relative dir
+    size_t async_pending_{0};                  // WriteFileAsync not yet done
+    std::condition_variable async_cv_;
+    ::persistency::LockStripes<> write_locks_; // per relative path
 };
 
 using SharedFileHandle = std::shared_ptr<FileStorage>;
 
-// Free functions per ara::per facade
+// Free functions per ara::per facade. Opens of one instance spec share a
+// single FileStorage for as long as any handle to it is held.
 ara::core::Result<SharedFileHandle>
 OpenFileStorage(ara::core::InstanceSpecifier fs, size_t quota_bytes = SIZE_MAX) noexcept;
 
+// Removes working copies a crash left behind ("<name>.tmp", "<name>.tmp<N>";
+// these suffixes and ".undo" are reserved). Undo journals are settled by
+// the next open instead. Fails with kResourceBusy while the storage
+// is open; with recover_on_start, OpenFileStorage runs it whenever it opens
+// the storage afresh.
 ara::core::Result<void> RecoverFileStorage(ara::core::InstanceSpecifier fs) noexcept;
 ara::core::Result<void> ResetFileStorage(ara::core::InstanceSpecifier fs) noexcept;
 
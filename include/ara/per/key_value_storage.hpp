@@ -1,46 +1,123 @@
 
 #pragma once
+#include <future>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 #include <string_view>
-#include <sstream>
 #include <ara/core/result.hpp>
 #include <ara/core/instance_specifier.hpp>
-#include "persistency/key_value_storage_backend.hpp"
+#include <ara/core/span.hpp>
+#include "persistency/async_io.hpp"
+#include "persistency/ikey_value_backend.hpp"
+#include "ara/per/value_codec.hpp"
 
 namespace ara::per {
 
+// Lazy walk over the keys with a prefix, in ascending order. Keys are
+// fetched kBatch at a time, each batch under one short read lock, and the
+// next batch resumes after the last key returned. Writes between batches
+// are fine: no key comes twice, and keys added or removed meanwhile may or
+// may not show up.
+class KeyCursor {
+public:
+    static constexpr size_t kBatch = 64;
+
+    KeyCursor(std::shared_ptr<::persistency::IKeyValueBackend> backend, std::string prefix,
+              std::string start_after = {})
+        : backend_(std::move(backend)), prefix_(std::move(prefix)), last_(std::move(start_after)) {}
+
+    // The next key, or nullopt at the end; the view is valid until the next call
+    std::optional<std::string_view> Next() noexcept {
+        if (pos_ == filled_ && (done_ || !Fill_())) return std::nullopt;
+        return std::string_view(batch_[pos_++]);
+    }
+
+    // Why the walk ended early, if it did
+    std::optional<ara::core::ErrorCode> Error() const noexcept { return error_; }
+
+private:
+    // Strings are reused across batches, so steady-state iteration only
+    // allocates for keys longer than any seen before
+    bool Fill_() noexcept {
+        if (batch_.size() < kBatch) batch_.resize(kBatch);
+        pos_ = filled_ = 0;
+        auto r = backend_->VisitKeys(prefix_, last_, [this](std::string_view key) {
+            batch_[filled_++].assign(key);
+            return filled_ < kBatch;
+        });
+        if (!r.HasValue()) error_ = r.Error();
+        done_ = !r.HasValue() || filled_ < kBatch;
+        if (filled_ == 0) return false;
+        last_.assign(batch_[filled_ - 1]);
+        return true;
+    }
+
+    std::shared_ptr<::persistency::IKeyValueBackend> backend_;
+    std::string prefix_;
+    std::string last_;                  // resume point; empty: from the start
+    std::vector<std::string> batch_;
+    size_t pos_{0};
+    size_t filled_{0};
+    bool done_{false};
+    std::optional<ara::core::ErrorCode> error_;
+};
+
 class KeyValueStorage {
 public:
-    explicit KeyValueStorage(std::shared_ptr<::persistency::KeyValueStorageBackend> backend)
-        : backend_(std::move(backend)) {}
+    explicit KeyValueStorage(std::shared_ptr<::persistency::IKeyValueBackend> backend,
+                             ::persistency::ValueEncoding encoding = ::persistency::ValueEncoding::Binary)
+        : backend_(std::move(backend)), encoding_(encoding) {}
 
+    // Typed value, encoded per the storage's ValueEncoding; arithmetic types
+    // and short strings are encoded without heap allocation.
     template<class T>
     ara::core::Result<void> SetValue(ara::core::StringView key, const T& value) noexcept {
-        std::ostringstream oss;
-        oss << value;
-        return backend_->SetValue(std::string(key), oss.str());
+        codec::Encoded buf;
+        codec::Encode(buf, value, encoding_);
+        return backend_->SetValue(key, buf.View());
     }
 
+    // Raw overload: the string is stored verbatim, without a type tag (one
+    // that starts with codec::kMarker behind the escape that Decode strips)
     ara::core::Result<void> SetValue(ara::core::StringView key, const std::string& value) noexcept {
-        return backend_->SetValue(std::string(key), value);
+        if (!codec::detail::NeedsEscape(value)) return backend_->SetValue(key, value);
+        codec::Encoded buf;
+        codec::detail::EncodeText(buf, value);
+        return backend_->SetValue(key, buf.View());
     }
 
+    ara::core::Result<void> SetValue(ara::core::StringView key, ara::core::Span<const uint8_t> bytes) noexcept {
+        codec::Encoded buf;
+        codec::Encode(buf, bytes, encoding_);
+        return backend_->SetValue(key, buf.View());
+    }
+
+    // Reads binary and text encodings alike (values written before the
+    // binary format, or via the raw overload, decode as text)
     template<class T>
     ara::core::Result<T> GetValue(ara::core::StringView key) const noexcept {
-        auto r = backend_->GetValue(std::string(key));
+        auto r = backend_->GetValue(key);
         if (!r.HasValue()) return r.Error();
-        std::istringstream iss(r.Value());
-        T out{};
-        iss >> out;
-        if (iss.fail())
-            return ara::core::ErrorCode(ara::core::PersistencyErrc::kCorruption);
-        return out;
+        return codec::Decode<T>(r.Value());
     }
 
     ara::core::Result<std::string> GetValueString(ara::core::StringView key) const noexcept {
-        return backend_->GetValue(std::string(key));
+        auto r = backend_->GetValue(key);
+        if (r.HasValue()) r.Value().erase(0, r.Value().size() - codec::Unescape(r.Value()).size());
+        return r;
+    }
+
+    // Stored bytes without a copy where the engine allows (see
+    // IKeyValueBackend::GetValueView); valid as long as the view lives
+    ara::core::Result<::persistency::MappedView> GetValueView(ara::core::StringView key) const noexcept {
+        auto r = backend_->GetValueView(key);
+        if (r.HasValue()) {
+            auto& view = r.Value();
+            view.remove_prefix(view.size() - codec::Unescape(view.AsStringView()).size());
+        }
+        return r;
     }
 
     ara::core::Result<ara::core::Vector<ara::core::String>> GetAllKeys() const noexcept {
@@ -49,22 +126,76 @@ public:
         return r.Value();
     }
 
+    // Ordered, for apps that namespace their keys ("trip/", "cal/"). Only
+    // the matching keys are copied; IterateKeys holds one batch at a time.
+    ara::core::Result<ara::core::Vector<ara::core::String>> GetKeysWithPrefix(ara::core::StringView prefix) const noexcept {
+        ara::core::Vector<ara::core::String> keys;
+        auto r = backend_->VisitKeys(prefix, {}, [&keys](std::string_view key) {
+            keys.emplace_back(key);
+            return true;
+        });
+        if (!r.HasValue()) return r.Error();
+        return keys;
+    }
+
+    ara::core::Result<size_t> CountKeys(ara::core::StringView prefix = {}) const noexcept {
+        return backend_->CountKeys(prefix);
+    }
+
+    // start_after resumes a walk (or starts a range) after that key
+    KeyCursor IterateKeys(ara::core::StringView prefix = {}, ara::core::StringView start_after = {}) const {
+        return KeyCursor(backend_, std::string(prefix), std::string(start_after));
+    }
+
     ara::core::Result<bool> HasKey(ara::core::StringView key) const noexcept {
-        return backend_->HasKey(std::string(key));
+        return backend_->HasKey(key);
     }
 
     ara::core::Result<void> RemoveKey(ara::core::StringView key) noexcept {
-        return backend_->RemoveKey(std::string(key));
+        return backend_->RemoveKey(key);
+    }
+
+    // One batch, so it is all or nothing
+    ara::core::Result<void> RemoveAllKeys() noexcept {
+        auto keys = backend_->GetAllKeys();
+        if (!keys.HasValue()) return keys.Error();
+        std::vector<::persistency::BatchOp> ops;
+        ops.reserve(keys.Value().size());
+        for (auto& k : keys.Value()) ops.push_back({std::move(k), std::nullopt});
+        return backend_->ApplyBatch(ops);
     }
 
     ara::core::Result<void> SyncToStorage() const noexcept { return backend_->SyncToStorage(); }
     ara::core::Result<void> DiscardPendingChanges() const noexcept { return backend_->DiscardPendingChanges(); }
 
+    // Non-blocking variants for ara::com callbacks and other threads that
+    // must not wait on storage: the call runs on the persistency::AsyncIo
+    // pool and holds its own reference to the back end.
+    template<class T>
+    std::future<ara::core::Result<T>> GetValueAsync(ara::core::StringView key) const {
+        return ::persistency::AsyncIo::Instance().Run(
+            [backend = backend_, key = std::string(key)]() -> ara::core::Result<T> {
+                auto r = backend->GetValue(key);
+                if (!r.HasValue()) return r.Error();
+                return codec::Decode<T>(r.Value());
+            });
+    }
+
+    std::future<ara::core::Result<void>> SyncToStorageAsync() const {
+        return ::persistency::AsyncIo::Instance().Run([backend = backend_] { return backend->SyncToStorage(); });
+    }
+
 private:
-    std::shared_ptr<::persistency::KeyValueStorageBackend> backend_;
+    std::shared_ptr<::persistency::IKeyValueBackend> backend_;
+    ::persistency::ValueEncoding encoding_;
 };
 
 using SharedHandle = std::shared_ptr<KeyValueStorage>;
+
+// Opens of one instance spec share a single KeyValueStorage for as long as
+// any handle to it is held; a re-open then costs no file access. Recover
+// fails with kResourceBusy while the storage is open, Reset empties it
+// through the open handle.
 ara::core::Result<SharedHandle> OpenKeyValueStorage(ara::core::InstanceSpecifier kvs) noexcept;
 ara::core::Result<void> RecoverKeyValueStorage(ara::core::InstanceSpecifier kvs) noexcept;
 ara::core::Result<void> ResetKeyValueStorage(ara::core::InstanceSpecifier kvs) noexcept;
@@ -0,0 +1,286 @@
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <ara/core/result.hpp>
+#include <ara/core/span.hpp>
+#include "persistency/ikey_value_backend.hpp"
+
+// Value encoding used by ara::per::KeyValueStorage::SetValue<T>/GetValue<T>.
+//
+// Binary (default): 0xB1 marker, one type tag, then the payload in
+// little-endian byte order; strings and byte vectors carry a u32 length.
+// 0xB1 can't start UTF-8 text, so values written before (plain text) or via
+// the raw std::string overload still decode through the text path. Text or
+// raw bytes that do start with 0xB1 are written behind 0xB1 kVerbatim.
+// Text (compatibility): std::to_chars / std::from_chars, no locale.
+namespace ara::per::codec {
+
+constexpr uint8_t kMarker = 0xB1;
+
+enum class Tag : uint8_t {
+    kBool = 1,
+    kInt8, kInt16, kInt32, kInt64,
+    kUInt8, kUInt16, kUInt32, kUInt64,
+    kFloat32, kFloat64,
+    kString, kBytes,
+    kVerbatim   // escape: the rest is text that happens to start with kMarker
+};
+
+template <class T>
+using Bare = std::remove_cv_t<std::remove_reference_t<T>>;
+
+template <class T>
+constexpr bool kIsBytes = std::is_same_v<Bare<T>, std::vector<uint8_t>> ||
+                          std::is_same_v<Bare<T>, ara::core::Span<const uint8_t>> ||
+                          std::is_same_v<Bare<T>, ara::core::Span<uint8_t>>;
+
+template <class T>
+constexpr bool kIsStringLike = !kIsBytes<T> && std::is_convertible_v<const T&, std::string_view>;
+
+template <class T>
+constexpr bool kIsScalar = std::is_arithmetic_v<Bare<T>> || std::is_enum_v<Bare<T>>;
+
+template <class T>
+constexpr Tag TagOf() {
+    using U = Bare<T>;
+    if constexpr (std::is_same_v<U, bool>) return Tag::kBool;
+    else if constexpr (std::is_floating_point_v<U>) return sizeof(U) == 4 ? Tag::kFloat32 : Tag::kFloat64;
+    else if constexpr (std::is_signed_v<U>)
+        return sizeof(U) == 1 ? Tag::kInt8 : sizeof(U) == 2 ? Tag::kInt16 : sizeof(U) == 4 ? Tag::kInt32 : Tag::kInt64;
+    else
+        return sizeof(U) == 1 ? Tag::kUInt8 : sizeof(U) == 2 ? Tag::kUInt16 : sizeof(U) == 4 ? Tag::kUInt32 : Tag::kUInt64;
+}
+
+// Encoding target: scalars and short strings stay in the inline buffer, so
+// SetValue<float> etc. never touch the heap.
+class Encoded {
+public:
+    Encoded() = default;
+    Encoded(const Encoded&) = delete;
+    Encoded& operator=(const Encoded&) = delete;
+
+    char* Reserve(size_t n) {
+        if (n <= sizeof(small_)) { heap_.clear(); size_ = n; return small_; }
+        heap_.resize(n);
+        size_ = n;
+        return heap_.data();
+    }
+    std::string_view View() const noexcept {
+        return {size_ <= sizeof(small_) ? small_ : heap_.data(), size_};
+    }
+
+private:
+    char small_[64];
+    std::string heap_;
+    size_t size_{0};
+};
+
+namespace detail {
+
+inline void PutLe(char* p, const void* v, size_t n) {
+    std::memcpy(p, v, n);   // host order is little-endian on our targets
+}
+
+inline void EncodeBlob(Encoded& out, Tag tag, const void* data, size_t n) {
+    const uint32_t len = static_cast<uint32_t>(n);
+    char* p = out.Reserve(2 + sizeof(len) + n);
+    p[0] = static_cast<char>(kMarker);
+    p[1] = static_cast<char>(tag);
+    PutLe(p + 2, &len, sizeof(len));
+    if (n) std::memcpy(p + 2 + sizeof(len), data, n);
+}
+
+inline bool NeedsEscape(std::string_view text) {
+    return !text.empty() && static_cast<uint8_t>(text[0]) == kMarker;
+}
+
+inline void EncodeText(Encoded& out, std::string_view text) {
+    const size_t pre = NeedsEscape(text) ? 2 : 0;
+    char* p = out.Reserve(pre + text.size());
+    if (pre) {
+        p[0] = static_cast<char>(kMarker);
+        p[1] = static_cast<char>(Tag::kVerbatim);
+    }
+    if (!text.empty()) std::memcpy(p + pre, text.data(), text.size());
+}
+
+inline std::string_view TrimTrailingSpace(std::string_view s) {
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\n' || s.back() == '\r' || s.back() == '\t'))
+        s.remove_suffix(1);
+    return s;
+}
+
+template <class To, class From>
+inline bool NarrowInto(From v, To& out) {
+    if constexpr (std::is_floating_point_v<To>) {
+        out = static_cast<To>(v);
+        return true;
+    } else {
+        if constexpr (std::is_signed_v<From> && !std::is_signed_v<To>) {
+            if (v < 0) return false;
+        }
+        if constexpr (!std::is_signed_v<From> && std::is_signed_v<To>) {
+            if (v > static_cast<std::make_unsigned_t<To>>(std::numeric_limits<To>::max())) return false;
+        } else if constexpr (std::is_signed_v<From> == std::is_signed_v<To>) {
+            if (v < std::numeric_limits<To>::min() || v > std::numeric_limits<To>::max()) return false;
+        } else {
+            if (static_cast<std::make_unsigned_t<From>>(v) > std::numeric_limits<To>::max()) return false;
+        }
+        out = static_cast<To>(v);
+        return true;
+    }
+}
+
+// Binary scalar payload -> T (integers of any width convert if in range)
+template <class T>
+inline bool DecodeScalar(Tag tag, std::string_view p, T& out) {
+    auto take = [&](auto v) {
+        if (p.size() != sizeof(v)) return false;
+        std::memcpy(&v, p.data(), sizeof(v));
+        if constexpr (std::is_same_v<T, bool>) { out = v != 0; return true; }
+        else return NarrowInto(v, out);
+    };
+    if constexpr (std::is_same_v<T, bool>) {
+        if (tag != Tag::kBool) return false;
+        return take(uint8_t{});
+    } else if constexpr (std::is_floating_point_v<T>) {
+        if (tag == Tag::kFloat32) return take(float{});
+        if (tag == Tag::kFloat64) return take(double{});
+        return false;
+    } else {
+        switch (tag) {
+            case Tag::kInt8:   return take(int8_t{});
+            case Tag::kInt16:  return take(int16_t{});
+            case Tag::kInt32:  return take(int32_t{});
+            case Tag::kInt64:  return take(int64_t{});
+            case Tag::kUInt8:  return take(uint8_t{});
+            case Tag::kUInt16: return take(uint16_t{});
+            case Tag::kUInt32: return take(uint32_t{});
+            case Tag::kUInt64: return take(uint64_t{});
+            default:           return false;
+        }
+    }
+}
+
+template <class T>
+inline bool ParseText(std::string_view s, T& out) {
+    s = TrimTrailingSpace(s);
+    if constexpr (std::is_same_v<T, bool>) {
+        if (s == "1" || s == "true")  { out = true;  return true; }
+        if (s == "0" || s == "false") { out = false; return true; }
+        return false;
+    } else {
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+        return ec == std::errc() && ptr == s.data() + s.size();
+    }
+}
+
+} // namespace detail
+
+// ---------- Encode ----------
+template <class T>
+inline void Encode(Encoded& out, const T& v, ::persistency::ValueEncoding enc) {
+    using U = Bare<T>;
+    if constexpr (std::is_enum_v<U>) {
+        Encode(out, static_cast<std::underlying_type_t<U>>(v), enc);
+    } else if constexpr (kIsScalar<U>) {
+        if (enc == ::persistency::ValueEncoding::Text) {
+            char* p = out.Reserve(64);
+            if constexpr (std::is_same_v<U, bool>) {
+                p[0] = v ? '1' : '0';
+                out.Reserve(1);
+            } else {
+                auto res = std::to_chars(p, p + 64, v);   // shortest round-trip form for floats
+                out.Reserve(static_cast<size_t>(res.ptr - p));
+            }
+        } else {
+            char* p = out.Reserve(2 + sizeof(U));
+            p[0] = static_cast<char>(kMarker);
+            p[1] = static_cast<char>(TagOf<U>());
+            if constexpr (std::is_same_v<U, bool>) { const uint8_t b = v ? 1 : 0; detail::PutLe(p + 2, &b, 1); }
+            else detail::PutLe(p + 2, &v, sizeof(U));
+        }
+    } else if constexpr (kIsBytes<U>) {
+        if (enc == ::persistency::ValueEncoding::Text) {
+            detail::EncodeText(out, {reinterpret_cast<const char*>(v.data()), v.size()});
+        } else {
+            detail::EncodeBlob(out, Tag::kBytes, v.data(), v.size());
+        }
+    } else if constexpr (kIsStringLike<U>) {
+        const std::string_view s(v);
+        if (enc == ::persistency::ValueEncoding::Text) {
+            detail::EncodeText(out, s);
+        } else {
+            detail::EncodeBlob(out, Tag::kString, s.data(), s.size());
+        }
+    } else {
+        // Anything else that streams keeps the old text form
+        std::ostringstream oss;
+        oss << v;
+        detail::EncodeText(out, oss.str());
+    }
+}
+
+// ---------- Decode ----------
+// Text form of a stored value: stored itself unless it carries the escape
+inline std::string_view Unescape(std::string_view stored) noexcept {
+    if (stored.size() >= 2 && static_cast<uint8_t>(stored[0]) == kMarker &&
+        static_cast<Tag>(stored[1]) == Tag::kVerbatim) {
+        stored.remove_prefix(2);
+    }
+    return stored;
+}
+
+// Accepts both encodings regardless of the storage's current mode.
+template <class T>
+inline ara::core::Result<T> Decode(std::string_view stored) {
+    using ara::core::ErrorCode;
+    using ara::core::PersistencyErrc;
+    const std::string_view text = Unescape(stored);
+    const bool binary = text.size() == stored.size() && stored.size() >= 2 &&
+                        static_cast<uint8_t>(stored[0]) == kMarker;
+    const Tag tag = binary ? static_cast<Tag>(stored[1]) : Tag{};
+    auto blob = [&](Tag want, std::string_view& body) {
+        if (tag != want || stored.size() < 6) return false;
+        uint32_t len = 0;
+        std::memcpy(&len, stored.data() + 2, sizeof(len));
+        if (stored.size() != 6u + len) return false;
+        body = stored.substr(6);
+        return true;
+    };
+
+    if constexpr (std::is_enum_v<T>) {
+        auto r = Decode<std::underlying_type_t<T>>(stored);
+        if (!r.HasValue()) return r.Error();
+        return static_cast<T>(r.Value());
+    } else if constexpr (kIsScalar<T>) {
+        T out{};
+        const bool ok = binary ? detail::DecodeScalar(tag, stored.substr(2), out)
+                               : detail::ParseText(text, out);
+        if (!ok) return ErrorCode(PersistencyErrc::kCorruption);
+        return out;
+    } else if constexpr (std::is_same_v<T, std::vector<uint8_t>>) {
+        std::string_view body = text;
+        if (binary && !blob(Tag::kBytes, body)) return ErrorCode(PersistencyErrc::kCorruption);
+        return std::vector<uint8_t>(body.begin(), body.end());
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        std::string_view body = text;
+        if (binary && !blob(Tag::kString, body)) return ErrorCode(PersistencyErrc::kCorruption);
+        return std::string(body);
+    } else {
+        std::istringstream iss{std::string(text)};
+        T out{};
+        iss >> out;
+        if (iss.fail()) return ErrorCode(PersistencyErrc::kCorruption);
+        return out;
+    }
+}
+
+} // namespace ara::per::codec
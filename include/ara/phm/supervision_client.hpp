@@ -1,18 +1,26 @@
 #pragma once
 #include <string>
 #include <cstdint>
+#include <memory>
+
+namespace phm { class HeartbeatSlot; }
 
 namespace ara { namespace phm {
 
+// Reports go to the EM's shared-memory heartbeat slot when the EM launched
+// this app with one (no IPC per report), otherwise as SOME/IP requests to
+// the PHM service, e.g. for an entity started by hand or on another ECU.
 class SupervisionClient {
 public:
     explicit SupervisionClient(const std::string& app_name); // used by vsomeip init
-    void Connect();  // request_service()
+    ~SupervisionClient();
+    void Connect();  // request_service(); not needed with a heartbeat slot
     void ReportAlive() noexcept;
     void ReportCheckpoint(std::uint32_t id) noexcept;
 
 private:
     std::string app_name_;
+    std::shared_ptr<::phm::HeartbeatSlot> slot_;
 };
 
 }} // namespace ara::phm
\ No newline at end of file
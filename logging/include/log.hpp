@@ -10,6 +10,8 @@
 #include <utility>
 #include <sstream>
 #include <optional>
+#include "log_args.hpp"
+#include "rate_limiter.hpp"
 
 namespace ara::log {
 
@@ -40,11 +42,29 @@ struct LogRecord {
   uint64_t    ts_ns;
   const char* file = nullptr;
   uint32_t    line = 0;
+  // Non-verbose support: build-time id of the format literal plus the
+  // arguments in binary (log_args.hpp). args is only filled if a sink asks.
+  uint32_t         msg_id = 0;
+  std::string_view fmt;
+  std::string      args;
+  // Structured key/value fields (ARA_LOG*_KV), binary; see ForEachField()
+  std::string      fields;
+  // Handle this sink returned from BindContext() for the emitting Logger
+  void*            sink_ctx = nullptr;
 };
 
 struct ISink {
   virtual ~ISink() = default;
   virtual void write(const LogRecord& rec) noexcept = 0;
+
+  // Called once per Logger at creation; the result is handed back in
+  // LogRecord::sink_ctx so sinks need no per-record lookups.
+  virtual void* BindContext(const std::string& /*app_id*/, const std::string& /*ctx_id*/,
+                            const std::string& /*ctx_desc*/) { return nullptr; }
+  // Sink consumes LogRecord::msg_id/args (non-verbose transports).
+  virtual bool WantsBinaryArgs() const noexcept { return false; }
+  // Sink reads LogRecord::message. If no sink does, formatting is skipped.
+  virtual bool WantsText() const noexcept { return true; }
 };
 
 using SinkPtr = std::shared_ptr<ISink>;
@@ -74,6 +94,12 @@ public:
     sinks_.push_back(std::move(s));
   }
 
+  // Loggers created earlier keep their own snapshot of the sink list
+  void ClearSinks() {
+    std::scoped_lock lk(mu_);
+    sinks_.clear();
+  }
+
   // Snapshot sinks/ids for fast use in Logger
   void Snapshot(std::vector<SinkPtr>& out, std::string& ecu, std::string& app, LogLevel& def) const {
     std::scoped_lock lk(mu_);
@@ -92,30 +118,25 @@ private:
 // ---------- Logger (per-context) ----------
 class Logger {
 public:
-  // Create a context logger (ctxId like "EM", "SOME", ctxDesc not used here but handy for DLT registration in your DltSink)
-  static Logger CreateLogger(std::string ctxId, std::string /*ctxDesc*/ = "", std::optional<LogLevel> level = std::nullopt) {
+  // Create a context logger (ctxId like "EM", "SOME"; ctxDesc is passed on to sinks, e.g. for DLT registration)
+  static Logger CreateLogger(std::string ctxId, std::string ctxDesc = "", std::optional<LogLevel> level = std::nullopt) {
     std::vector<SinkPtr> sinks; std::string ecu, app; LogLevel def{};
     LogManager::Instance().Snapshot(sinks, ecu, app, def);
     Logger L(std::move(ctxId), std::move(ecu), std::move(app), sinks, level.value_or(def));
+    L.BindSinks(ctxDesc.empty() ? L.ctx_id_ : ctxDesc);
     return L;
   }
 
   LogLevel Level() const noexcept { return level_; }
   void SetLevel(LogLevel lvl) noexcept { level_ = lvl; }
+  bool IsEnabled(LogLevel lvl) const noexcept { return ShouldLog(lvl); }
 
   // Basic logging with preformatted message
   void Log(LogLevel lvl, std::string_view msg, const char* file = nullptr, uint32_t line = 0) {
     if (!ShouldLog(lvl)) return;
-    LogRecord r;
-    r.ecu_id = ecu_id_;
-    r.app_id = app_id_;
-    r.ctx_id = ctx_id_;
-    r.level  = lvl;
+    LogRecord r = MakeRecord(lvl, file, line);
     r.message = std::string(msg);
-    r.file = file;
-    r.line = line;
-    r.ts_ns = NowNs();
-    for (const auto& s : sinks_) if (s) s->write(r);
+    Dispatch(r);
   }
 
   // Convenience helpers
@@ -129,10 +150,23 @@ public:
   // Tiny formatting helper that doesn’t depend on fmt/std::format:
   template <typename... Args>
   void LogF(LogLevel lvl, const char* file, uint32_t line, std::string_view fmt, Args&&... args) {
+    LogF(lvl, 0, file, line, fmt, std::forward<Args>(args)...);
+  }
+
+  // Same, with a build-time message id (see ARA_LOG_MSG_ID) for non-verbose sinks
+  template <typename... Args>
+  void LogF(LogLevel lvl, uint32_t msg_id, const char* file, uint32_t line, std::string_view fmt, Args&&... args) {
     if (!ShouldLog(lvl)) return;
-    std::ostringstream oss;
-    FormatInto(oss, fmt, std::forward<Args>(args)...); //
-    Log(lvl, oss.str(), file, line);
+    LogRecord r = MakeRecord(lvl, file, line);
+    r.msg_id = msg_id;
+    r.fmt    = fmt;
+    if (want_args_) EncodeArgs(r.args, args...);
+    if (want_text_ || msg_id == 0) {
+      std::ostringstream oss;
+      FormatInto(oss, fmt, std::forward<Args>(args)...); //
+      r.message = oss.str();
+    }
+    Dispatch(r);
   }
 
   template <typename... Args> void FatalF (const char* f, uint32_t l, std::string_view fmt, Args&&... a){ LogF(LogLevel::kFatal,   f,l,fmt,std::forward<Args>(a)...); }
@@ -142,7 +176,21 @@ public:
   template <typename... Args> void DebugF (const char* f, uint32_t l, std::string_view fmt, Args&&... a){ LogF(LogLevel::kDebug,   f,l,fmt,std::forward<Args>(a)...); }
   template <typename... Args> void VerboseF(const char* f, uint32_t l, std::string_view fmt, Args&&... a){ LogF(LogLevel::kVerbose, f,l,fmt,std::forward<Args>(a)...); }
 
-  // Structured extension point (add key/value pairs later if you like)
+  // Structured logging: message plus typed key/value pairs, e.g.
+  // ARA_LOGINFO_KV(lg, "speed", "v", speed, "max", max_speed). Fields are only
+  // encoded here; rendering (text/JSON) is left to the sinks.
+  template <typename... KV>
+  void LogKV(LogLevel lvl, uint32_t msg_id, const char* file, uint32_t line, std::string_view msg, const KV&... kv) {
+    static_assert(sizeof...(KV) % 2 == 0, "ARA_LOG*_KV expects key/value pairs");
+    if (!ShouldLog(lvl)) return;
+    LogRecord r = MakeRecord(lvl, file, line);
+    r.msg_id  = msg_id;
+    r.fmt     = msg;
+    r.message = std::string(msg);
+    EncodeFields(r.fields, kv...);
+    Dispatch(r);
+  }
+
   const std::string& ContextId() const noexcept { return ctx_id_; }
 
 private:
@@ -151,6 +199,37 @@ private:
       : ctx_id_(std::move(ctx)), ecu_id_(std::move(ecu)), app_id_(std::move(app)),
         sinks_(std::move(sinks)), level_(lvl) {}
 
+  void BindSinks(const std::string& ctx_desc) {
+    sink_ctx_.clear();
+    want_args_ = false;
+    want_text_ = false;
+    for (const auto& s : sinks_) {
+      sink_ctx_.push_back(s ? s->BindContext(app_id_, ctx_id_, ctx_desc) : nullptr);
+      if (s && s->WantsBinaryArgs()) want_args_ = true;
+      if (s && s->WantsText())       want_text_ = true;
+    }
+  }
+
+  LogRecord MakeRecord(LogLevel lvl, const char* file, uint32_t line) const {
+    LogRecord r;
+    r.ecu_id = ecu_id_;
+    r.app_id = app_id_;
+    r.ctx_id = ctx_id_;
+    r.level  = lvl;
+    r.file = file;
+    r.line = line;
+    r.ts_ns = NowNs();
+    return r;
+  }
+
+  void Dispatch(LogRecord& r) const {
+    for (size_t i = 0; i < sinks_.size(); ++i) {
+      if (!sinks_[i]) continue;
+      r.sink_ctx = i < sink_ctx_.size() ? sink_ctx_[i] : nullptr;
+      sinks_[i]->write(r);
+    }
+  }
+
   static uint64_t NowNs() {
     using namespace std::chrono;
     return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
@@ -182,16 +261,66 @@ private:
   std::string ecu_id_;
   std::string app_id_;
   std::vector<SinkPtr> sinks_;
+  std::vector<void*> sink_ctx_;   // parallel to sinks_
+  bool want_args_{false};
+  bool want_text_{true};
   LogLevel level_;
 };
 
 // ---------- Convenience macros to capture file/line ----------
-#define ARA_LOGFATAL(lg, fmt, ...)   (lg).FatalF(__FILE__, __LINE__, (fmt), ##__VA_ARGS__)
-#define ARA_LOGERROR(lg, fmt, ...)   (lg).ErrorF(__FILE__, __LINE__, (fmt), ##__VA_ARGS__)
-#define ARA_LOGWARN(lg,  fmt, ...)   (lg).WarnF (__FILE__, __LINE__, (fmt), ##__VA_ARGS__)
-#define ARA_LOGINFO(lg,  fmt, ...)   (lg).InfoF (__FILE__, __LINE__, (fmt), ##__VA_ARGS__)
-#define ARA_LOGDEBUG(lg, fmt, ...)   (lg).DebugF(__FILE__, __LINE__, (fmt), ##__VA_ARGS__)
-#define ARA_LOGVERBOSE(lg, fmt, ...) (lg).VerboseF(__FILE__, __LINE__, (fmt), ##__VA_ARGS__)
+// fmt must be a string literal: its message id is computed at compile time and
+// tools/gen_log_catalog.py puts the same id/format pair into the catalog.
+// The format travels in __VA_ARGS__ (ARA_LOGINFO(lg, fmt, args...)), so a
+// message without arguments leaves no "..." empty, which ISO C++ before
+// C++20 does not allow.
+#define ARA_LOG_MSG_ID(fmt) (::std::integral_constant<uint32_t, ::ara::log::MessageId(fmt)>::value)
+#define ARA_LOG_FMT_(fmt, ...) fmt
+#define ARA_LOG_(lg, lvl, ...) \
+  (lg).LogF((lvl), ARA_LOG_MSG_ID(ARA_LOG_FMT_(__VA_ARGS__, 0)), __FILE__, __LINE__, __VA_ARGS__)
+
+#define ARA_LOGFATAL(lg, ...)   ARA_LOG_(lg, ::ara::log::LogLevel::kFatal,   __VA_ARGS__)
+#define ARA_LOGERROR(lg, ...)   ARA_LOG_(lg, ::ara::log::LogLevel::kError,   __VA_ARGS__)
+#define ARA_LOGWARN(lg,  ...)   ARA_LOG_(lg, ::ara::log::LogLevel::kWarn,    __VA_ARGS__)
+#define ARA_LOGINFO(lg,  ...)   ARA_LOG_(lg, ::ara::log::LogLevel::kInfo,    __VA_ARGS__)
+#define ARA_LOGDEBUG(lg, ...)   ARA_LOG_(lg, ::ara::log::LogLevel::kDebug,   __VA_ARGS__)
+#define ARA_LOGVERBOSE(lg, ...) ARA_LOG_(lg, ::ara::log::LogLevel::kVerbose, __VA_ARGS__)
+
+// ---------- Structured variants: message literal + "key", value, ... ----------
+#define ARA_LOG_KV_(lg, lvl, msg, ...) \
+  (lg).LogKV((lvl), ARA_LOG_MSG_ID(msg), __FILE__, __LINE__, (msg), __VA_ARGS__)
+
+#define ARA_LOGFATAL_KV(lg, msg, ...)   ARA_LOG_KV_(lg, ::ara::log::LogLevel::kFatal,   msg, __VA_ARGS__)
+#define ARA_LOGERROR_KV(lg, msg, ...)   ARA_LOG_KV_(lg, ::ara::log::LogLevel::kError,   msg, __VA_ARGS__)
+#define ARA_LOGWARN_KV(lg,  msg, ...)   ARA_LOG_KV_(lg, ::ara::log::LogLevel::kWarn,    msg, __VA_ARGS__)
+#define ARA_LOGINFO_KV(lg,  msg, ...)   ARA_LOG_KV_(lg, ::ara::log::LogLevel::kInfo,    msg, __VA_ARGS__)
+#define ARA_LOGDEBUG_KV(lg, msg, ...)   ARA_LOG_KV_(lg, ::ara::log::LogLevel::kDebug,   msg, __VA_ARGS__)
+#define ARA_LOGVERBOSE_KV(lg, msg, ...) ARA_LOG_KV_(lg, ::ara::log::LogLevel::kVerbose, msg, __VA_ARGS__)
+
+// ---------- Rate-limited variants (one token bucket per call site) ----------
+// Disabled levels don't consume tokens. Once a storm is over, the next message
+// that gets through is preceded by "suppressed K similar messages".
+#define ARA_LOG_RL(lg, lvl, burst, per_sec, ...)                                         \
+  do {                                                                                   \
+    static ::ara::log::RateLimiter ara_log_rl_site_{(burst), (per_sec)};                 \
+    if ((lg).IsEnabled(lvl)) {                                                           \
+      uint32_t ara_log_rl_suppressed_ = 0;                                               \
+      if (ara_log_rl_site_.Allow(ara_log_rl_suppressed_)) {                              \
+        if (ara_log_rl_suppressed_ != 0)                                                 \
+          ARA_LOG_(lg, lvl, "suppressed {} similar messages", ara_log_rl_suppressed_);   \
+        ARA_LOG_(lg, lvl, __VA_ARGS__);                                                  \
+      }                                                                                  \
+    }                                                                                    \
+  } while (0)
+
+#define ARA_LOG_RL_DEFAULT_(lg, lvl, ...) \
+  ARA_LOG_RL(lg, lvl, ::ara::log::RateLimiter::kDefaultBurst, ::ara::log::RateLimiter::kDefaultPerSecond, __VA_ARGS__)
+
+#define ARA_LOGFATAL_RL(lg, ...)   ARA_LOG_RL_DEFAULT_(lg, ::ara::log::LogLevel::kFatal,   __VA_ARGS__)
+#define ARA_LOGERROR_RL(lg, ...)   ARA_LOG_RL_DEFAULT_(lg, ::ara::log::LogLevel::kError,   __VA_ARGS__)
+#define ARA_LOGWARN_RL(lg,  ...)   ARA_LOG_RL_DEFAULT_(lg, ::ara::log::LogLevel::kWarn,    __VA_ARGS__)
+#define ARA_LOGINFO_RL(lg,  ...)   ARA_LOG_RL_DEFAULT_(lg, ::ara::log::LogLevel::kInfo,    __VA_ARGS__)
+#define ARA_LOGDEBUG_RL(lg, ...)   ARA_LOG_RL_DEFAULT_(lg, ::ara::log::LogLevel::kDebug,   __VA_ARGS__)
+#define ARA_LOGVERBOSE_RL(lg, ...) ARA_LOG_RL_DEFAULT_(lg, ::ara::log::LogLevel::kVerbose, __VA_ARGS__)
 
 //Ola: Check if possible to use source info / src info type instead.
 
@@ -0,0 +1,234 @@
+// include/log_args.hpp
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace ara::log {
+
+// ---------- Build-time message ids ----------
+// FNV-1a over the format literal. Identical formats share an id, which is fine
+// for decoding; tools/gen_log_catalog.py computes the same hash for the catalog.
+constexpr uint32_t MessageId(std::string_view fmt) noexcept {
+  uint32_t h = 2166136261u;
+  for (char c : fmt) { h ^= static_cast<uint8_t>(c); h *= 16777619u; }
+  return h != 0 ? h : 1; // 0 means "no id"
+}
+
+// ---------- Binary argument encoding ----------
+// Each argument is a one-byte type tag followed by its payload in host byte
+// order (little-endian on all our targets); strings carry a u16 length prefix.
+enum class ArgType : uint8_t {
+  kBool = 1, kInt32, kUInt32, kInt64, kUInt64, kFloat32, kFloat64, kString
+};
+
+struct ArgView {
+  ArgType type{};
+  union { bool b; int64_t i; uint64_t u; double d; };
+  std::string_view s;  // kString only
+  ArgView() : u(0) {}
+};
+
+namespace detail {
+
+template <typename T>
+inline void PutRaw(std::string& out, ArgType t, const T& v) {
+  char buf[1 + sizeof(T)];
+  buf[0] = static_cast<char>(t);
+  std::memcpy(buf + 1, &v, sizeof(T));
+  out.append(buf, sizeof(buf));
+}
+
+inline void PutString(std::string& out, std::string_view s) {
+  const uint16_t n = static_cast<uint16_t>(s.size() > 0xFFFF ? 0xFFFF : s.size());
+  char hdr[3];
+  hdr[0] = static_cast<char>(ArgType::kString);
+  std::memcpy(hdr + 1, &n, sizeof(n));
+  out.append(hdr, sizeof(hdr));
+  out.append(s.data(), n);
+}
+
+template <typename T>
+inline void EncodeArg(std::string& out, const T& v) {
+  using U = std::decay_t<T>;
+  if constexpr (std::is_same_v<U, bool>) {
+    PutRaw(out, ArgType::kBool, static_cast<uint8_t>(v ? 1 : 0));
+  } else if constexpr (std::is_same_v<U, char>) {
+    PutString(out, std::string_view(&v, 1));
+  } else if constexpr (std::is_enum_v<U>) {
+    EncodeArg(out, static_cast<std::underlying_type_t<U>>(v));
+  } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+    if constexpr (sizeof(U) <= 4) PutRaw(out, ArgType::kInt32, static_cast<int32_t>(v));
+    else                          PutRaw(out, ArgType::kInt64, static_cast<int64_t>(v));
+  } else if constexpr (std::is_integral_v<U>) {
+    if constexpr (sizeof(U) <= 4) PutRaw(out, ArgType::kUInt32, static_cast<uint32_t>(v));
+    else                          PutRaw(out, ArgType::kUInt64, static_cast<uint64_t>(v));
+  } else if constexpr (std::is_same_v<U, float>) {
+    PutRaw(out, ArgType::kFloat32, v);
+  } else if constexpr (std::is_floating_point_v<U>) {
+    PutRaw(out, ArgType::kFloat64, static_cast<double>(v));
+  } else if constexpr (std::is_convertible_v<const U&, std::string_view>) {
+    PutString(out, std::string_view(v));
+  } else {
+    // Anything else that streams: ship its text form
+    std::ostringstream oss;
+    oss << v;
+    PutString(out, oss.str());
+  }
+}
+
+template <typename T>
+inline bool Take(std::string_view& in, T& v) {
+  if (in.size() < sizeof(T)) return false;
+  std::memcpy(&v, in.data(), sizeof(T));
+  in.remove_prefix(sizeof(T));
+  return true;
+}
+
+} // namespace detail
+
+template <typename... Args>
+inline void EncodeArgs(std::string& out, const Args&... args) {
+  (detail::EncodeArg(out, args), ...);
+}
+
+// Decode one argument from the front of `in`. False on malformed input.
+inline bool DecodeArg(std::string_view& in, ArgView& a) {
+  uint8_t tag = 0;
+  if (!detail::Take(in, tag)) return false;
+  a.type = static_cast<ArgType>(tag);
+  switch (a.type) {
+    case ArgType::kBool:    { uint8_t v;  if (!detail::Take(in, v)) return false; a.b = v != 0; return true; }
+    case ArgType::kInt32:   { int32_t v;  if (!detail::Take(in, v)) return false; a.i = v; return true; }
+    case ArgType::kUInt32:  { uint32_t v; if (!detail::Take(in, v)) return false; a.u = v; return true; }
+    case ArgType::kInt64:   return detail::Take(in, a.i);
+    case ArgType::kUInt64:  return detail::Take(in, a.u);
+    case ArgType::kFloat32: { float v;    if (!detail::Take(in, v)) return false; a.d = v; return true; }
+    case ArgType::kFloat64: return detail::Take(in, a.d);
+    case ArgType::kString: {
+      uint16_t n = 0;
+      if (!detail::Take(in, n) || in.size() < n) return false;
+      a.s = in.substr(0, n);
+      in.remove_prefix(n);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Calls fn(const ArgView&) for every argument; false if the buffer is malformed.
+template <typename Fn>
+inline bool ForEachArg(std::string_view buf, Fn&& fn) {
+  while (!buf.empty()) {
+    ArgView a;
+    if (!DecodeArg(buf, a)) return false;
+    fn(a);
+  }
+  return true;
+}
+
+// Text rendering of a decoded argument, matching what operator<< would print.
+inline void AppendArg(std::ostringstream& oss, const ArgView& a) {
+  switch (a.type) {
+    case ArgType::kBool:    oss << a.b; break;
+    case ArgType::kInt32:
+    case ArgType::kInt64:   oss << a.i; break;
+    case ArgType::kUInt32:
+    case ArgType::kUInt64:  oss << a.u; break;
+    case ArgType::kFloat32: oss << static_cast<float>(a.d); break;
+    case ArgType::kFloat64: oss << a.d; break;
+    case ArgType::kString:  oss << a.s; break;
+  }
+}
+
+// ---------- Structured key/value fields ----------
+// Each field is [u8 key length][key bytes] followed by one encoded argument.
+// Producers only encode; sinks decide whether to render text, JSON or binary.
+template <typename T>
+inline void EncodeField(std::string& out, std::string_view key, const T& v) {
+  const uint8_t n = static_cast<uint8_t>(key.size() > 0xFF ? 0xFF : key.size());
+  out.push_back(static_cast<char>(n));
+  out.append(key.data(), n);
+  detail::EncodeArg(out, v);
+}
+
+namespace detail {
+inline void EncodeFieldPairs(std::string&) {}
+template <typename K, typename V, typename... Rest>
+inline void EncodeFieldPairs(std::string& out, const K& key, const V& v, const Rest&... rest) {
+  EncodeField(out, std::string_view(key), v);
+  EncodeFieldPairs(out, rest...);
+}
+} // namespace detail
+
+// EncodeFields(out, "v", speed, "max", max_speed)
+template <typename... KV>
+inline void EncodeFields(std::string& out, const KV&... kv) {
+  static_assert(sizeof...(KV) % 2 == 0, "fields must be key/value pairs");
+  detail::EncodeFieldPairs(out, kv...);
+}
+
+// Calls fn(std::string_view key, const ArgView&) per field; false if malformed.
+template <typename Fn>
+inline bool ForEachField(std::string_view buf, Fn&& fn) {
+  while (!buf.empty()) {
+    const auto n = static_cast<uint8_t>(buf.front());
+    if (buf.size() < 1u + n) return false;
+    std::string_view key = buf.substr(1, n);
+    buf.remove_prefix(1u + n);
+    ArgView a;
+    if (!DecodeArg(buf, a)) return false;
+    fn(key, a);
+  }
+  return true;
+}
+
+// "v=51.2 max=90"
+inline std::string RenderFieldsText(std::string_view buf) {
+  std::ostringstream oss;
+  bool first = true;
+  ForEachField(buf, [&](std::string_view key, const ArgView& a) {
+    if (!first) oss << ' ';
+    first = false;
+    oss << key << '=';
+    AppendArg(oss, a);
+  });
+  return oss.str();
+}
+
+// {"v":51.2,"max":90}
+inline std::string RenderFieldsJson(std::string_view buf) {
+  auto quoted = [](std::ostringstream& oss, std::string_view s) {
+    static const char* hex = "0123456789abcdef";
+    oss << '"';
+    for (char c : s) {
+      if (c == '"' || c == '\\') oss << '\\' << c;
+      else if (static_cast<unsigned char>(c) < 0x20)
+        oss << "\\u00" << hex[(c >> 4) & 0xF] << hex[c & 0xF];
+      else oss << c;
+    }
+    oss << '"';
+  };
+  std::ostringstream oss;
+  oss << '{';
+  bool first = true;
+  ForEachField(buf, [&](std::string_view key, const ArgView& a) {
+    if (!first) oss << ',';
+    first = false;
+    quoted(oss, key);
+    oss << ':';
+    if (a.type == ArgType::kString) quoted(oss, a.s);
+    else if (a.type == ArgType::kBool) oss << (a.b ? "true" : "false");
+    else if ((a.type == ArgType::kFloat32 || a.type == ArgType::kFloat64) && !std::isfinite(a.d))
+      oss << "null";   // JSON has no NaN or Inf
+    else AppendArg(oss, a);
+  });
+  oss << '}';
+  return oss.str();
+}
+
+} // namespace ara::log
@@ -0,0 +1,70 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace ara::log {
+
+// ---------- Per-call-site token bucket ----------
+// Meant to live in a function-local static (see ARA_LOG_RL), so every call site
+// gets its own budget. While tokens remain, Allow() costs one fetch_sub plus one
+// load; the clock is only read when the bucket runs dry.
+class RateLimiter {
+public:
+  static constexpr uint32_t kDefaultBurst     = 10;
+  static constexpr uint32_t kDefaultPerSecond = 1;
+
+  using NowFn = uint64_t (*)();
+
+  constexpr RateLimiter(uint32_t burst = kDefaultBurst, uint32_t per_second = kDefaultPerSecond) noexcept
+      : burst_(burst ? burst : 1),
+        interval_ns_(per_second ? 1'000'000'000ull / per_second : 0),
+        tokens_(burst ? burst : 1) {}
+
+  RateLimiter(const RateLimiter&) = delete;
+  RateLimiter& operator=(const RateLimiter&) = delete;
+
+  // True if this call may log. `suppressed` receives the number of calls that
+  // were dropped since the last one that passed (0 in the common case).
+  bool Allow(uint32_t& suppressed, NowFn now = SteadyNowNs) noexcept {
+    const int64_t t = tokens_.fetch_sub(1, std::memory_order_relaxed);
+    if (t > 0) {
+      if (t == static_cast<int64_t>(burst_) &&
+          last_refill_ns_.load(std::memory_order_relaxed) == 0) {
+        last_refill_ns_.store(now(), std::memory_order_relaxed); // first use starts the clock
+      }
+      suppressed = suppressed_.load(std::memory_order_relaxed) == 0
+                       ? 0 : suppressed_.exchange(0, std::memory_order_relaxed);
+      return true;
+    }
+
+    // Bucket empty: lazily credit the tokens earned since the last refill.
+    const uint64_t ts = now();
+    uint64_t last = last_refill_ns_.load(std::memory_order_relaxed);
+    if (interval_ns_ != 0 && ts - last >= interval_ns_ &&
+        last_refill_ns_.compare_exchange_strong(last, ts, std::memory_order_relaxed)) {
+      const uint64_t earned = std::min<uint64_t>((ts - last) / interval_ns_, burst_);
+      tokens_.store(static_cast<int64_t>(earned) - 1, std::memory_order_relaxed);
+      suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+      return true;
+    }
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  static uint64_t SteadyNowNs() noexcept {
+    using namespace std::chrono;
+    return static_cast<uint64_t>(
+        duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+  }
+
+private:
+  const uint32_t burst_;
+  const uint64_t interval_ns_;          // 0 => never refills
+  std::atomic<int64_t>  tokens_;
+  std::atomic<uint64_t> last_refill_ns_{0};
+  std::atomic<uint32_t> suppressed_{0};
+};
+
+} // namespace ara::log
@@ -7,7 +7,9 @@ namespace ara::log {
 struct ConsoleSink : ISink {
   void write(const LogRecord& r) noexcept override {
     std::cout << "[" << ToString(r.level) << "] "
-              << r.ctx_id << ": " << r.message << std::endl;
+              << r.ctx_id << ": " << r.message;
+    if (!r.fields.empty()) std::cout << ' ' << RenderFieldsText(r.fields);
+    std::cout << std::endl;
   }
 };
 
@@ -8,22 +8,35 @@ namespace ara::log {
 
 class DltSink : public ISink {
 public:
+  // kVerbose sends the formatted text. kNonVerbose sends only the build-time
+  // message id plus binary arguments; the format strings live in the catalog
+  // produced by tools/gen_log_catalog.py.
+  enum class Mode { kVerbose, kNonVerbose };
+
   // You can pass a default app description shown in tools; optional.
-  explicit DltSink(std::string app_description = "AdaptiveApp");
+  explicit DltSink(std::string app_description = "AdaptiveApp", Mode mode = Mode::kVerbose);
   ~DltSink();
 
   void write(const LogRecord& r) noexcept override;
 
+  // Registers app/context once per Logger; write() then uses the cached handle
+  // without taking mu_.
+  void* BindContext(const std::string& app_id, const std::string& ctx_id,
+                    const std::string& ctx_desc) override;
+  bool WantsBinaryArgs() const noexcept override { return mode_ == Mode::kNonVerbose; }
+  bool WantsText() const noexcept override { return mode_ == Mode::kVerbose; }
+
 private:
   void ensureAppRegistered(const std::string& app_id);
-  void ensureCtxRegistered(const std::string& app_id,
-                           const std::string& ctx_id,
-                           const std::string& ctx_desc);
+  void* ensureCtxRegistered(const std::string& app_id,
+                            const std::string& ctx_id,
+                            const std::string& ctx_desc);
 
   // Map ctx_id -> DLT context handle
   struct CtxHandle { void* h = nullptr; }; // opaque to avoid including dlt headers here
   std::mutex mu_;
   std::string app_desc_;
+  Mode mode_;
   std::string registered_app_id_;
   std::unordered_map<std::string, CtxHandle> ctx_by_id_;
 };
@@ -0,0 +1,81 @@
+#pragma once
+#include "log.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ara::log {
+
+// Env var through which the EM hands the ring's file descriptor to a child.
+inline constexpr const char* kFlightRecorderFdEnv = "ARA_LOG_FLIGHT_FD";
+
+// One decoded entry of the ring (reader side only).
+struct FlightRecord {
+  uint64_t    seq;      // monotonically increasing record number
+  uint64_t    ts_ns;
+  LogLevel    level;
+  std::string ctx_id;
+  std::string message;  // truncated to what fits in a slot
+  uint32_t    line;
+};
+
+// Fixed-size binary ring in a shared memory segment (memfd).
+// Writers claim a slot with a single fetch_add and publish it with a release
+// store, so the logging path never enters the kernel. The segment outlives a
+// crashing writer, which lets the EM read the tail after waitpid().
+class FlightRecorder {
+public:
+  static constexpr size_t kDefaultSlots = 256;
+  static constexpr size_t kSlotBytes    = 256;
+
+  // EM side: create and initialize a fresh segment. Returns nullptr on failure
+  // (or on platforms without memfd).
+  static std::unique_ptr<FlightRecorder> Create(const std::string& name,
+                                                size_t slots = kDefaultSlots);
+  // App side: map a segment inherited from the parent. Takes ownership of fd.
+  static std::unique_ptr<FlightRecorder> Attach(int fd);
+
+  ~FlightRecorder();
+  FlightRecorder(const FlightRecorder&) = delete;
+  FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+  int Fd() const noexcept { return fd_; }
+  size_t Slots() const noexcept;
+
+  void Append(const LogRecord& r) noexcept;
+
+  // Last n published records, oldest first. Slots torn by a crash are skipped.
+  std::vector<FlightRecord> ReadLast(size_t n) const;
+
+  // Forget all records (EM calls this before relaunching the app).
+  void Reset() noexcept;
+
+private:
+  struct Header;
+  struct Slot;
+
+  FlightRecorder(int fd, void* base, size_t bytes) : fd_(fd), base_(base), bytes_(bytes) {}
+  Header* hdr() const noexcept;
+  Slot*   slot(uint64_t idx) const noexcept;
+
+  int    fd_;
+  void*  base_;
+  size_t bytes_;
+};
+
+struct FlightRecorderSink : ISink {
+  explicit FlightRecorderSink(std::shared_ptr<FlightRecorder> ring) : ring_(std::move(ring)) {}
+
+  // Attaches to the ring named by kFlightRecorderFdEnv and clears the variable;
+  // nullptr if the process was not launched with one (e.g. started by hand).
+  static std::shared_ptr<FlightRecorderSink> FromEnvironment();
+
+  void write(const LogRecord& r) noexcept override { ring_->Append(r); }
+
+private:
+  std::shared_ptr<FlightRecorder> ring_;
+};
+
+} // namespace ara::log
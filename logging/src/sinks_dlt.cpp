@@ -20,10 +20,26 @@ static DltLogLevelType to_dlt_level(LogLevel l) {
     default:                 return DLT_LOG_INFO;
   }
 }
+
+// Append one binary argument to an open DLT message.
+static void write_dlt_arg(DltContextData& cd, const ArgView& a) {
+  switch (a.type) {
+    case ArgType::kBool:    dlt_user_log_write_bool(&cd, a.b ? 1 : 0); break;
+    case ArgType::kInt32:   dlt_user_log_write_int32(&cd, static_cast<int32_t>(a.i)); break;
+    case ArgType::kUInt32:  dlt_user_log_write_uint32(&cd, static_cast<uint32_t>(a.u)); break;
+    case ArgType::kInt64:   dlt_user_log_write_int64(&cd, a.i); break;
+    case ArgType::kUInt64:  dlt_user_log_write_uint64(&cd, a.u); break;
+    case ArgType::kFloat32: dlt_user_log_write_float32(&cd, static_cast<float>(a.d)); break;
+    case ArgType::kFloat64: dlt_user_log_write_float64(&cd, a.d); break;
+    case ArgType::kString:
+      dlt_user_log_write_sized_string(&cd, a.s.data(), static_cast<uint16_t>(a.s.size()));
+      break;
+  }
+}
 #endif
 
-DltSink::DltSink(std::string app_description)
-  : app_desc_(std::move(app_description)) {}
+DltSink::DltSink(std::string app_description, Mode mode)
+  : app_desc_(std::move(app_description)), mode_(mode) {}
 
 DltSink::~DltSink() {
 #ifdef HAVE_DLT
@@ -36,36 +52,70 @@ void DltSink::ensureAppRegistered(const std::string& app_id) {
   if (registered_app_id_ == app_id) return;
   // Register new app
   dlt_register_app(app_id.c_str(), app_desc_.c_str());
+  if (mode_ == Mode::kNonVerbose) dlt_nonverbose_mode();
   registered_app_id_ = app_id;
 #else
   (void)app_id; // unused
 #endif
 }
 
-void DltSink::ensureCtxRegistered(const std::string& /*app_id*/,
-                                  const std::string& ctx_id,
-                                  const std::string& ctx_desc) {
+void* DltSink::ensureCtxRegistered(const std::string& /*app_id*/,
+                                   const std::string& ctx_id,
+                                   const std::string& ctx_desc) {
 #ifdef HAVE_DLT
-  if (ctx_by_id_.find(ctx_id) != ctx_by_id_.end()) return;
+  auto it = ctx_by_id_.find(ctx_id);
+  if (it != ctx_by_id_.end()) return it->second.h;
   DltContext* ctx = new DltContext(); // freed on process exit
   std::memset(ctx, 0, sizeof(DltContext));
   dlt_register_context(ctx, ctx_id.c_str(), ctx_desc.c_str());
   ctx_by_id_[ctx_id] = CtxHandle{ctx};
+  return ctx;
 #else
   (void)ctx_id; (void)ctx_desc;
+  return nullptr;
 #endif
 }
 
+void* DltSink::BindContext(const std::string& app_id, const std::string& ctx_id,
+                           const std::string& ctx_desc) {
+  std::scoped_lock lk(mu_);
+  ensureAppRegistered(app_id);
+  return ensureCtxRegistered(app_id, ctx_id, ctx_desc);
+}
+
 void DltSink::write(const LogRecord& r) noexcept {
 #ifdef HAVE_DLT
-  std::scoped_lock lk(mu_);
-  ensureAppRegistered(r.app_id);
-  // You may want a nicer description per context; we use ctx_id as desc for now.
-  ensureCtxRegistered(r.app_id, r.ctx_id, r.ctx_id);
+  // Fast path: handle bound at Logger creation. Fallback for records that
+  // did not come through a Logger.
+  void* h = r.sink_ctx;
+  if (h == nullptr) h = BindContext(r.app_id, r.ctx_id, r.ctx_id);
+  if (h == nullptr) return;
+  auto* ctx = static_cast<DltContext*>(h);
 
-  auto it = ctx_by_id_.find(r.ctx_id);
-  if (it == ctx_by_id_.end() || it->second.h == nullptr) return;
-  auto* ctx = static_cast<DltContext*>(it->second.h);
+  if (mode_ == Mode::kNonVerbose && r.msg_id != 0) {
+    DltContextData cd;
+    if (dlt_user_log_write_start_id(ctx, &cd, to_dlt_level(r.level), r.msg_id) > 0) {
+      ForEachArg(r.args, [&](const ArgView& a) { write_dlt_arg(cd, a); });
+      // Field names are in the catalog; only the values go on the wire
+      ForEachField(r.fields, [&](std::string_view, const ArgView& a) { write_dlt_arg(cd, a); });
+      dlt_user_log_write_finish(&cd);
+    }
+    return;
+  }
+
+  if (!r.fields.empty()) {
+    // Verbose structured record: message, then "key" + typed value per field
+    DltContextData cd;
+    if (dlt_user_log_write_start(ctx, &cd, to_dlt_level(r.level)) > 0) {
+      dlt_user_log_write_string(&cd, r.message.c_str());
+      ForEachField(r.fields, [&](std::string_view key, const ArgView& a) {
+        dlt_user_log_write_sized_string(&cd, key.data(), static_cast<uint16_t>(key.size()));
+        write_dlt_arg(cd, a);
+      });
+      dlt_user_log_write_finish(&cd);
+    }
+    return;
+  }
 
   // You can add file/line as separate args if you like.
   DLT_LOG(*ctx, to_dlt_level(r.level), DLT_STRING(r.message.c_str()));
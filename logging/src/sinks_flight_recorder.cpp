@@ -0,0 +1,189 @@
+#include "sinks_flight_recorder.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(__linux__)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace ara::log {
+
+namespace {
+constexpr uint32_t kMagic   = 0x464C5452; // "FLTR"
+constexpr uint32_t kVersion = 1;
+} // namespace
+
+struct FlightRecorder::Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slots;
+  uint32_t slot_bytes;
+  std::atomic<uint64_t> head;   // next record number to claim
+  char pad[64 - 24];
+};
+
+// seq == 0 while a slot is empty or being rewritten, record number + 1 once
+// published. A writer that dies mid-record leaves 0 behind and the reader
+// simply skips the slot.
+struct FlightRecorder::Slot {
+  std::atomic<uint64_t> seq;
+  uint64_t ts_ns;
+  uint32_t line;
+  uint8_t  level;
+  uint8_t  ctx_len;
+  uint16_t msg_len;
+  char     ctx[8];
+  char     msg[kSlotBytes - 32];
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t) &&
+              std::atomic<uint64_t>::is_always_lock_free,
+              "flight recorder needs address-free 64-bit atomics");
+
+FlightRecorder::Header* FlightRecorder::hdr() const noexcept {
+  return static_cast<Header*>(base_);
+}
+
+FlightRecorder::Slot* FlightRecorder::slot(uint64_t idx) const noexcept {
+  auto* first = reinterpret_cast<Slot*>(static_cast<char*>(base_) + sizeof(Header));
+  return first + (idx % hdr()->slots);
+}
+
+size_t FlightRecorder::Slots() const noexcept { return hdr()->slots; }
+
+std::unique_ptr<FlightRecorder> FlightRecorder::Create(const std::string& name, size_t slots) {
+#if defined(__linux__)
+  if (slots == 0) return nullptr;
+  const size_t bytes = sizeof(Header) + slots * sizeof(Slot);
+  int fd = ::memfd_create(("flight:" + name).c_str(), MFD_CLOEXEC);
+  if (fd < 0) return nullptr;
+  if (::ftruncate(fd, static_cast<off_t>(bytes)) != 0) { ::close(fd); return nullptr; }
+  void* base = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) { ::close(fd); return nullptr; }
+
+  // Fresh memfd pages are zero-filled, so all slots start out empty.
+  auto* h = new (base) Header{};
+  h->magic      = kMagic;
+  h->version    = kVersion;
+  h->slots      = static_cast<uint32_t>(slots);
+  h->slot_bytes = static_cast<uint32_t>(sizeof(Slot));
+  h->head.store(0, std::memory_order_release);
+  return std::unique_ptr<FlightRecorder>(new FlightRecorder(fd, base, bytes));
+#else
+  (void)name; (void)slots;
+  return nullptr;
+#endif
+}
+
+std::unique_ptr<FlightRecorder> FlightRecorder::Attach(int fd) {
+#if defined(__linux__)
+  struct stat st{};
+  if (fd < 0 || ::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header))
+    return nullptr;
+  const size_t bytes = static_cast<size_t>(st.st_size);
+  void* base = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) return nullptr;
+
+  auto* h = static_cast<const Header*>(base);
+  if (h->magic != kMagic || h->version != kVersion || h->slot_bytes != sizeof(Slot) ||
+      sizeof(Header) + size_t{h->slots} * sizeof(Slot) > bytes || h->slots == 0) {
+    ::munmap(base, bytes);
+    return nullptr;
+  }
+  // Don't leak the segment into our own children.
+  ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+  return std::unique_ptr<FlightRecorder>(new FlightRecorder(fd, base, bytes));
+#else
+  (void)fd;
+  return nullptr;
+#endif
+}
+
+FlightRecorder::~FlightRecorder() {
+#if defined(__linux__)
+  if (base_) ::munmap(base_, bytes_);
+  if (fd_ >= 0) ::close(fd_);
+#endif
+}
+
+void FlightRecorder::Append(const LogRecord& r) noexcept {
+  const uint64_t idx = hdr()->head.fetch_add(1, std::memory_order_relaxed);
+  Slot* s = slot(idx);
+
+  s->seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  s->ts_ns   = r.ts_ns;
+  s->line    = r.line;
+  s->level   = static_cast<uint8_t>(r.level);
+  s->ctx_len = static_cast<uint8_t>(std::min(r.ctx_id.size(), sizeof(s->ctx)));
+  std::memcpy(s->ctx, r.ctx_id.data(), s->ctx_len);
+  size_t len = std::min(r.message.size(), sizeof(s->msg));
+  std::memcpy(s->msg, r.message.data(), len);
+  if (!r.fields.empty() && len < sizeof(s->msg)) {
+    // Post-mortem readers want plain text; fields are rare enough to render here
+    const std::string kv = " " + RenderFieldsText(r.fields);
+    const size_t n = std::min(kv.size(), sizeof(s->msg) - len);
+    std::memcpy(s->msg + len, kv.data(), n);
+    len += n;
+  }
+  s->msg_len = static_cast<uint16_t>(len);
+
+  s->seq.store(idx + 1, std::memory_order_release);
+}
+
+std::vector<FlightRecord> FlightRecorder::ReadLast(size_t n) const {
+  std::vector<FlightRecord> out;
+  const uint64_t head  = hdr()->head.load(std::memory_order_acquire);
+  const uint64_t avail = std::min<uint64_t>(head, hdr()->slots);
+  const uint64_t first = head - std::min<uint64_t>(avail, n);
+  out.reserve(static_cast<size_t>(head - first));
+
+  for (uint64_t idx = first; idx < head; ++idx) {
+    const Slot* s = slot(idx);
+    if (s->seq.load(std::memory_order_acquire) != idx + 1) continue;
+
+    FlightRecord fr;
+    fr.seq     = idx;
+    fr.ts_ns   = s->ts_ns;
+    fr.level   = static_cast<LogLevel>(s->level);
+    fr.line    = s->line;
+    fr.ctx_id.assign(s->ctx, std::min<size_t>(s->ctx_len, sizeof(s->ctx)));
+    fr.message.assign(s->msg, std::min<size_t>(s->msg_len, sizeof(s->msg)));
+
+    // Overwritten by a live writer while we copied? Drop it.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s->seq.load(std::memory_order_relaxed) != idx + 1) continue;
+    out.push_back(std::move(fr));
+  }
+  return out;
+}
+
+void FlightRecorder::Reset() noexcept {
+  auto* first = reinterpret_cast<Slot*>(static_cast<char*>(base_) + sizeof(Header));
+  for (uint32_t i = 0; i < hdr()->slots; ++i) first[i].seq.store(0, std::memory_order_relaxed);
+  hdr()->head.store(0, std::memory_order_release);
+}
+
+std::shared_ptr<FlightRecorderSink> FlightRecorderSink::FromEnvironment() {
+  const char* env = std::getenv(kFlightRecorderFdEnv);
+  if (!env || !*env) return nullptr;
+  char* end = nullptr;
+  long fd = std::strtol(env, &end, 10);
+  if (end == env || fd < 0) return nullptr;
+  std::shared_ptr<FlightRecorder> ring = FlightRecorder::Attach(static_cast<int>(fd));
+  if (!ring) return nullptr;
+#if defined(__linux__)
+  // The ring owns the fd now; children we spawn must not attach to it
+  ::unsetenv(kFlightRecorderFdEnv);
+#endif
+  return std::make_shared<FlightRecorderSink>(std::move(ring));
+}
+
+} // namespace ara::log
@@ -0,0 +1,111 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <ara/core/result.hpp>
+
+namespace persistency {
+
+// Process-wide executor that keeps storage latency off the caller's thread
+// (typically an ara::com callback).
+//
+// WriteAndRename goes to an io_uring ring when the kernel offers one: the
+// write, fsync, renameat and directory fsync of a request are submitted as
+// one linked chain, so the whole commit costs a single io_uring_enter and
+// no thread blocks on it. Without io_uring (old kernel, seccomp, or
+// ARA_PER_IO_URING=0), and for chains the ring cannot finish (short write,
+// kernel without renameat), the same steps run on a small worker pool.
+// If the ring itself fails, it is abandoned: the chains it still holds
+// are redone on the pool and every later write takes the pool path.
+// Run() hands arbitrary blocking work (reads, SyncToStorage) to that pool.
+//
+// Completion callbacks run on the ring or pool thread and must not block.
+class AsyncIo {
+public:
+    struct Stats {
+        uint64_t ring_chains{0};     // writes committed by the ring
+        uint64_t pool_writes{0};     // writes that took the pool path
+        uint64_t pool_tasks{0};      // Run() calls
+    };
+
+    static AsyncIo& Instance();
+    ~AsyncIo();
+
+    // Writes data to tmp_path (created or truncated), fsyncs it, renames it
+    // over final_path and fsyncs the directory. Requests for one final_path
+    // commit in submission order. on_done(ok) runs before the future is
+    // ready; on failure the tmp file is removed and the target untouched.
+    std::future<ara::core::Result<void>>
+    WriteAndRename(std::string tmp_path, std::string final_path, std::vector<uint8_t> data,
+                   std::function<void(bool)> on_done = {});
+
+    template<class F>
+    std::future<std::invoke_result_t<F>> Run(F fn) {
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::move(fn));
+        auto fut = task->get_future();
+        Post_([task] { (*task)(); }, true);
+        return fut;
+    }
+
+    bool UsesIoUring() const noexcept { return ring_ != nullptr && !ring_failed_; }
+    Stats GetStats() const;
+
+private:
+    struct Ring;
+    struct Write {
+        std::string tmp;
+        std::string final;
+        std::vector<uint8_t> data;
+        std::function<void(bool)> on_done;
+        std::promise<ara::core::Result<void>> done;
+        int fd{-1};
+        int dir_fd{-1};
+        int res[4]{};                 // per linked step
+        int seen{0};                  // completions received
+        unsigned nop_mask{0};         // steps replaced by NOPs after a partial submit
+    };
+
+    AsyncIo();
+    void Post_(std::function<void()> job, bool count_as_task);
+    void PoolLoop_();
+    void RingLoop_();
+    void AbandonRing_();
+    void Start_(Write* w);
+    bool SubmitChain_(Write* w);
+    void OnChainDone_(Write* w);
+    void WriteOnPool_(Write* w);
+    void Finish_(Write* w, bool ok);
+
+    static constexpr unsigned kRingEntries = 64;
+    static constexpr unsigned kMaxChains = kRingEntries / 4;   // 4 SQEs per write
+
+    std::unique_ptr<Ring> ring_;       // null: pool only
+    std::thread ring_thread_;
+    std::atomic<bool> ring_failed_{false};   // set under submit_mtx and mtx_
+
+    mutable std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> jobs_;
+    std::vector<std::thread> pool_;
+    bool stop_{false};
+
+    // Writes queued behind an earlier one to the same target (front = running)
+    std::unordered_map<std::string, std::deque<Write*>> by_target_;
+    std::deque<Write*> backlog_;       // waiting for ring capacity
+    unsigned chains_in_flight_{0};
+    std::unordered_set<Write*> in_ring_;   // submitted, completion not seen yet
+    Stats stats_;
+};
+
+} // namespace persistency
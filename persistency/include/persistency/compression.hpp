@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <sys/types.h>   // ssize_t
+#include <ara/core/result.hpp>
+#include <ara/core/span.hpp>
+
+namespace persistency {
+
+// Transparent block compression of stored files and values. LZ4 and zstd
+// are compiled in when the build finds them (HAVE_LZ4, HAVE_ZSTD); without
+// the library a storage configured for it stores data as it is.
+enum class Codec : uint8_t { None = 0, Lz4 = 1, Zstd = 2 };
+
+// Per storage ("compression" in the persistency manifest)
+struct CompressionOptions {
+    Codec  codec{Codec::None};
+    size_t min_bytes{4096};   // smaller payloads are stored as they are
+    int    level{0};          // 0: the codec's default
+};
+
+const char* CodecName(Codec codec) noexcept;
+bool CodecAvailable(Codec codec) noexcept;
+
+// Stored form: a 24-byte header (magic, codec, block size, raw size, CRC of
+// the header) followed by blocks of kCompressionBlockBytes raw bytes each
+// (the last may be shorter). A block is [raw_len][stored_len][bytes]; a
+// block that would not shrink is kept raw, flagged in stored_len. Blocks
+// decode independently, so a reader needs one block in memory at a time.
+//
+// Anything else is a raw payload. A raw payload that happens to start with
+// a valid header is wrapped in a container of raw blocks, so it cannot be
+// mistaken for one.
+inline constexpr size_t kCompressedHeaderBytes = 24;
+inline constexpr size_t kCompressionBlockBytes = 64 * 1024;
+
+// Raw size, if `head` (the first bytes of a stored payload) is a container header
+std::optional<uint64_t> CompressedRawSize(const uint8_t* head, size_t n) noexcept;
+
+// True and `out` set to the container if the options call for compression
+// and it saves space (or data needs wrapping); false: store data as it is
+bool Compress(ara::core::Span<const uint8_t> data, const CompressionOptions& opts,
+              std::vector<uint8_t>& out);
+
+// Whole container into out[0, raw_size); raw_size from CompressedRawSize
+ara::core::Result<void> Decompress(ara::core::Span<const uint8_t> stored, uint8_t* out,
+                                   size_t raw_size) noexcept;
+
+// Streaming variants, one block in memory at a time. CompressFile writes the
+// container for in_fd's first raw_size bytes to out_fd (at its offset 0) and
+// returns its size; DecompressFile writes the raw content of a container.
+ara::core::Result<uint64_t> CompressFile(int in_fd, uint64_t raw_size, int out_fd,
+                                         const CompressionOptions& opts) noexcept;
+ara::core::Result<void> DecompressFile(int in_fd, int out_fd) noexcept;
+
+// Positioned reads of a container file's raw content. Block offsets are
+// learned on the way (8 bytes of index per block), the last decoded block
+// is kept, so sequential reads decode every block once.
+class BlockReader {
+public:
+    // Null if the file does not start with a container header. The reader
+    // borrows fd; the caller keeps it open.
+    static std::unique_ptr<BlockReader> Open(int fd) noexcept;
+
+    uint64_t RawSize() const noexcept { return raw_size_; }
+    // Like pread: bytes read, 0 at the end, -1 on an I/O or decode error
+    ssize_t ReadAt(void* buf, size_t n, uint64_t off) noexcept;
+
+private:
+    BlockReader(int fd, Codec codec, uint32_t block_bytes, uint64_t raw_size) noexcept
+        : fd_(fd), codec_(codec), block_bytes_(block_bytes), raw_size_(raw_size) {}
+    bool LoadBlock_(uint64_t index) noexcept;
+
+    int fd_;
+    Codec codec_;
+    uint32_t block_bytes_;
+    uint64_t raw_size_;
+    std::vector<uint64_t> offsets_{kCompressedHeaderBytes};   // of each block found so far
+    uint64_t loaded_{UINT64_MAX};                              // block in raw_
+    std::vector<uint8_t> raw_;
+    std::vector<uint8_t> packed_;
+};
+
+} // namespace persistency
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace persistency {
+
+// CRC-32C (Castagnoli), as used by the log-structured KV engine's record frames.
+// Pass the previous result as `crc` to checksum data in several pieces.
+// Uses the CPU's CRC32 instruction where there is one (SSE4.2, picked at
+// run time; ARMv8 CRC when compiled in), a lookup table otherwise.
+uint32_t Crc32c(const void* data, size_t len, uint32_t crc = 0) noexcept;
+
+// Table implementation; same results, kept callable for tests and benchmarks
+uint32_t Crc32cSoftware(const void* data, size_t len, uint32_t crc = 0) noexcept;
+bool Crc32cIsHardwareAccelerated() noexcept;
+
+} // namespace persistency
@@ -0,0 +1,65 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ara/core/result.hpp>
+
+namespace persistency {
+
+// Per storage ("group_commit" in the persistency manifest)
+struct GroupCommitOptions {
+    bool enabled{false};
+    std::chrono::milliseconds max_latency{5};   // longest a write waits for company
+};
+
+// Process-wide commit thread for tmp + rename writes. A writer hands over
+// its written (not yet synced) tmp file and waits on the future. The thread
+// collects requests until the earliest deadline passes or max_batch are
+// queued, then fsyncs every tmp file, renames them in submission order and
+// fsyncs each affected directory once. N concurrent writers into one
+// directory thus cost one directory fsync instead of N, and their file
+// fsyncs land in the same journal commit.
+class GroupCommitter {
+public:
+    struct Stats {
+        uint64_t batches{0};
+        uint64_t files{0};
+        uint64_t dir_syncs{0};
+    };
+
+    static GroupCommitter& Instance();
+    ~GroupCommitter();
+
+    // On failure the tmp file is removed and the target left untouched
+    std::future<ara::core::Result<void>> Submit(std::string tmp_path, std::string final_path,
+                                                std::chrono::milliseconds max_latency);
+    Stats GetStats() const;
+
+private:
+    struct Pending {
+        std::string tmp;
+        std::string final;
+        std::chrono::steady_clock::time_point deadline;
+        std::promise<ara::core::Result<void>> done;
+    };
+
+    GroupCommitter() = default;
+    void Loop_();
+    void CommitBatch_(std::vector<Pending>& batch);
+
+    static constexpr size_t kMaxBatch = 64;
+
+    mutable std::mutex mtx_;
+    std::condition_variable cv_;
+    std::vector<Pending> queue_;
+    bool stop_{false};
+    std::thread thread_;   // started by the first Submit
+    Stats stats_;
+};
+
+} // namespace persistency
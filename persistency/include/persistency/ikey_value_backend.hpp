@@ -0,0 +1,107 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ara/core/result.hpp>
+#include <persistency/mapped_file.hpp>
+
+namespace persistency {
+
+// When an engine makes writes durable (fsync). Engines that cannot defer
+// (the "file" engine) ignore it.
+enum class Durability {
+    EveryWrite,   // fsync before SetValue/RemoveKey return
+    OnSync,       // fsync in SyncToStorage() and on segment rollover
+    None          // leave it to the kernel
+};
+
+// How ara::per::KeyValueStorage encodes typed values (see ara/per/value_codec.hpp)
+enum class ValueEncoding {
+    Binary,   // tag + little-endian payload
+    Text      // to_chars text, readable by older tooling
+};
+
+// One staged change; no value means "remove the key".
+struct BatchOp {
+    std::string key;
+    std::optional<std::string> value;
+};
+
+// Called per key by IKeyValueBackend::VisitKeys; false stops the scan
+using KeyVisitor = std::function<bool(std::string_view key)>;
+
+// VisitKeys over an ordered map keyed by std::string with std::less<>
+template<class Map>
+void VisitOrderedKeys(const Map& index, std::string_view prefix, std::string_view after, const KeyVisitor& fn) {
+    auto it = after.empty() || after < prefix ? index.lower_bound(prefix) : index.upper_bound(after);
+    for (; it != index.end(); ++it) {
+        const std::string_view key = it->first;
+        if (key.compare(0, prefix.size(), prefix) != 0 || !fn(key)) break;
+    }
+}
+
+// Storage engine behind ara::per::KeyValueStorage. Selected per storage by
+// "engine" in the persistency manifest (see StorageConfig::engine).
+class IKeyValueBackend {
+public:
+    virtual ~IKeyValueBackend() = default;
+
+    virtual ara::core::Result<void> SetValue(std::string_view key, std::string_view value) noexcept = 0;
+    virtual ara::core::Result<std::string> GetValue(std::string_view key) const noexcept = 0;
+    virtual ara::core::Result<std::vector<std::string>> GetAllKeys() const noexcept = 0;
+    virtual ara::core::Result<bool> HasKey(std::string_view key) const noexcept = 0;
+    virtual ara::core::Result<void> RemoveKey(std::string_view key) noexcept = 0;
+    virtual ara::core::Result<void> SyncToStorage() const noexcept = 0;
+    virtual ara::core::Result<void> DiscardPendingChanges() const noexcept = 0;
+
+    // Applies all ops or none of them, surviving a crash at any point.
+    // Removing a missing key is not an error here.
+    virtual ara::core::Result<void> ApplyBatch(const std::vector<BatchOp>& ops) noexcept = 0;
+    // Stored size of one value without reading it; kNotFound if absent
+    virtual ara::core::Result<size_t> ValueSize(std::string_view key) const noexcept = 0;
+    // Whether SetValue would take this key (kPermissionDenied if not)
+    virtual bool ValidKey(std::string_view key) const noexcept { return !key.empty(); }
+    // Read-only view of a value. Engines that keep one file per value
+    // return a cached mapping; the default wraps a GetValue copy.
+    virtual ara::core::Result<MappedView> GetValueView(std::string_view key) const noexcept {
+        auto r = GetValue(key);
+        if (!r.HasValue()) return r.Error();
+        return MappedView::FromString(std::move(r.Value()));
+    }
+
+    // Ordered scan without copying the keys: fn sees each key that starts
+    // with `prefix` and sorts after `after` (from the first when empty), in
+    // ascending byte order, until it returns false. fn runs under the
+    // engine's read lock and must not call back into the storage. The
+    // default sorts a GetAllKeys copy; the engines scan their index.
+    virtual ara::core::Result<void> VisitKeys(std::string_view prefix, std::string_view after,
+                                              const KeyVisitor& fn) const noexcept {
+        auto r = GetAllKeys();
+        if (!r.HasValue()) return r.Error();
+        auto& keys = r.Value();
+        std::sort(keys.begin(), keys.end());
+        auto it = after.empty() || after < prefix
+                      ? std::lower_bound(keys.begin(), keys.end(), prefix)
+                      : std::upper_bound(keys.begin(), keys.end(), after);
+        for (; it != keys.end(); ++it) {
+            if (it->compare(0, prefix.size(), prefix) != 0 || !fn(*it)) break;
+        }
+        return {};
+    }
+    // Keys starting with prefix; the engines answer an empty prefix in O(1)
+    virtual ara::core::Result<size_t> CountKeys(std::string_view prefix) const noexcept {
+        size_t n = 0;
+        auto r = VisitKeys(prefix, {}, [&n](std::string_view) { ++n; return true; });
+        if (!r.HasValue()) return r.Error();
+        return n;
+    }
+
+    // Bytes charged against the quota (sum of live value sizes)
+    virtual size_t GetUsedSpace() const = 0;
+    virtual size_t GetQuota() const = 0;
+};
+
+} // namespace persistency
@@ -0,0 +1,110 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace persistency {
+
+enum class IoPriority { Critical, Normal, Bulk };
+
+// Per storage ("io" in the persistency manifest)
+struct IoClassOptions {
+    IoPriority priority{IoPriority::Normal};
+    uint64_t   bytes_per_sec{0};                 // the storage's own budget; 0: none
+    uint64_t   burst_bytes{0};                   // 0: 100 ms worth of bytes_per_sec
+    std::chrono::milliseconds deadline{0};       // 0: the class default (10/100/1000 ms)
+};
+
+// Process-wide admission gate in front of the storages' writes, so a bulk
+// writer cannot starve a latency-critical one on the same flash device.
+//
+// Every write asks for its byte count before it touches the disk. A storage
+// is paced by its own token bucket (bytes_per_sec), and all of them share
+// the device budget (Options::device_bytes_per_sec): Critical storages may
+// overdraw it, Normal ones take what is there, Bulk ones leave a quarter of
+// the burst to the others. Waiting requests are served earliest deadline
+// first (deadline = arrival + the storage's relative deadline); requests
+// of one storage keep their order. Admission only ever waits for time to
+// pass, never for another write to finish, so it cannot deadlock against
+// the storages' own locks.
+//
+// Without a device budget and a storage budget the gate costs one lock and
+// still counts the requests.
+class IoScheduler {
+public:
+    struct Options {
+        uint64_t device_bytes_per_sec{0};   // 0: unlimited
+        uint64_t device_burst_bytes{0};     // 0: 100 ms worth
+    };
+
+    // Queueing delay is the time from the request to its admission
+    struct QueueStats {
+        uint64_t requests{0};
+        uint64_t bytes{0};
+        uint64_t delayed{0};               // admitted later than asked
+        uint64_t deadline_misses{0};       // admitted after their deadline
+        uint64_t queued{0};                // waiting right now
+        std::chrono::microseconds total_delay{0};
+        std::chrono::microseconds max_delay{0};
+    };
+
+    struct Queue;
+    using QueueHandle = std::shared_ptr<Queue>;
+
+    static IoScheduler& Instance();
+    ~IoScheduler();
+
+    void Configure(const Options& opts);
+
+    // One queue per storage name; registering a name again updates its
+    // options and keeps its statistics
+    QueueHandle Register(const std::string& storage, const IoClassOptions& opts);
+
+    // Blocks until `bytes` may be written. A null queue is admitted at once.
+    void Admit(const QueueHandle& queue, uint64_t bytes);
+    // Runs go() once admitted, in admission order: on the caller's thread if
+    // that is right away, otherwise on the scheduler's thread. go must not block.
+    void AdmitAsync(const QueueHandle& queue, uint64_t bytes, std::function<void()> go);
+
+    std::optional<QueueStats> GetStats(std::string_view storage) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Waiter;
+    using WaitKey = std::tuple<Clock::time_point, int, uint64_t>;   // deadline, priority, arrival
+
+    IoScheduler() = default;
+    void Enqueue_(Waiter* w);
+    void Dispatch_(Clock::time_point now);
+    void DrainReady_(std::unique_lock<std::mutex>& lock);
+    void Wake_();   // starts the thread on first use
+    void Loop_();
+
+    mutable std::mutex mtx_;
+    std::condition_variable granted_cv_;    // synchronous waiters
+    std::condition_variable thread_cv_;
+    std::map<std::string, QueueHandle, std::less<>> queues_;
+    std::map<WaitKey, Waiter*> waiting_;
+    std::vector<std::function<void()>> ready_;   // admitted AdmitAsync calls
+    bool running_ready_{false};                  // someone is running ready_
+    Options opts_;
+    double device_tokens_{0};
+    Clock::time_point device_refilled_{};
+    Clock::time_point retry_at_{Clock::time_point::max()};
+    uint64_t arrivals_{0};
+    uint64_t pass_{0};
+    bool stop_{false};
+    std::thread thread_;   // started by the first request that has to wait
+};
+
+} // namespace persistency
@@ -1,33 +1,77 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
+#include <map>
 #include <filesystem>
 #include <fstream>
 #include <mutex>
+#include <shared_mutex>
 #include <ara/core/result.hpp>
+#include <persistency/compression.hpp>
+#include <persistency/ikey_value_backend.hpp>
+#include <persistency/io_scheduler.hpp>
+#include <persistency/rw_lock.hpp>
+#include <persistency/lock_stripes.hpp>
 
 namespace persistency {
 
-class KeyValueStorageBackend {
+// "file" engine: one file per key, tmp + rename on every write.
+//
+// Locking: mtx_ (shared) covers only the in-memory index, so lookups run in
+// parallel and reads of the value file happen with no lock at all (rename
+// makes a reader see either the old or the new file). Writers hold the
+// stripe of their key across the file I/O and take mtx_ exclusively only to
+// reserve quota and to publish the new size. fsync never runs under mtx_.
+// Writes with an io queue are admitted by IoScheduler under their stripes.
+// Values are compressed before any lock is taken; index_, the quota and
+// ValueSize count stored bytes.
+class KeyValueStorageBackend : public IKeyValueBackend {
 public:
     static constexpr size_t kDefaultQuota = 1024 * 1024; // 1MB per storage
-    KeyValueStorageBackend(const std::string& base_path, size_t quota = kDefaultQuota);
-    ara::core::Result<void> SetValue(const std::string& key, const std::string& value) noexcept;
-    ara::core::Result<std::string> GetValue(const std::string& key) const noexcept;
-    ara::core::Result<std::vector<std::string>> GetAllKeys() const noexcept;
-    ara::core::Result<bool> HasKey(const std::string& key) const noexcept;
-    ara::core::Result<void> RemoveKey(const std::string& key) noexcept;
-    ara::core::Result<void> SyncToStorage() const noexcept;
-    ara::core::Result<void> DiscardPendingChanges() const noexcept;
-    size_t GetUsedSpace() const;           // locks mtx_
-
-    size_t GetQuota() const { return quota_; }
+    KeyValueStorageBackend(const std::string& base_path, size_t quota = kDefaultQuota,
+                           IoScheduler::QueueHandle io = {}, CompressionOptions compression = {});
+    ara::core::Result<void> SetValue(std::string_view key, std::string_view value) noexcept override;
+    ara::core::Result<std::string> GetValue(std::string_view key) const noexcept override;
+    ara::core::Result<std::vector<std::string>> GetAllKeys() const noexcept override;
+    ara::core::Result<bool> HasKey(std::string_view key) const noexcept override;
+    ara::core::Result<void> RemoveKey(std::string_view key) noexcept override;
+    ara::core::Result<void> SyncToStorage() const noexcept override;
+    ara::core::Result<void> DiscardPendingChanges() const noexcept override;
+    ara::core::Result<void> ApplyBatch(const std::vector<BatchOp>& ops) noexcept override;
+    ara::core::Result<size_t> ValueSize(std::string_view key) const noexcept override;
+    bool ValidKey(std::string_view key) const noexcept override;
+    ara::core::Result<MappedView> GetValueView(std::string_view key) const noexcept override;
+    ara::core::Result<void> VisitKeys(std::string_view prefix, std::string_view after,
+                                      const KeyVisitor& fn) const noexcept override;
+    ara::core::Result<size_t> CountKeys(std::string_view prefix) const noexcept override;
+    size_t GetUsedSpace() const override;  // shared lock on mtx_
+
+    size_t GetQuota() const override { return quota_; }
+
+    // Finishes a batch a crash left in base_path: redone if its journal
+    // committed, dropped if not. Also for engines taking over the directory.
+    // False if a redo step failed; the batch is then kept for the next try.
+    static bool FinishBatch(const std::string& base_path) noexcept;
 
 private:
     std::string base_path_;
     size_t quota_{kDefaultQuota};
-    mutable std::mutex mtx_;
+    IoScheduler::QueueHandle io_;   // null: not scheduled
+    CompressionOptions compression_;
+    mutable RwLock mtx_;            // guards index_ and used_bytes_
+    LockStripes<> write_locks_;       // per key; all of them for ApplyBatch
+
+    // In-memory index: key -> value size in bytes. Loaded from the directory
+    // once in the ctor, then kept current by SetValue/RemoveKey, so HasKey,
+    // GetAllKeys and the quota check never touch the filesystem.
+    // Files added behind our back are not seen until reopen.
+    // used_bytes_ includes quota reserved by writes still in flight.
+    // Ordered, for prefix scans; std::less<> finds string_views as they are.
+    std::map<std::string, size_t, std::less<>> index_;
+    size_t used_bytes_{0};
+
+    void LoadIndexNoLock_() noexcept;
 
     // NEW: use this only while mtx_ is already held
     size_t GetUsedSpaceNoLock_() const noexcept;
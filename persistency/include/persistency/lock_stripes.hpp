@@ -0,0 +1,32 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string_view>
+
+namespace persistency {
+
+// Fixed set of mutexes picked by key hash: writers of different keys run in
+// parallel, writers of the same key serialize. lock()/unlock() take every
+// stripe (in a fixed order), for operations spanning many keys, so
+// std::lock_guard<LockStripes<>> works for those.
+template <size_t N = 16>
+class LockStripes {
+public:
+    std::mutex& For(std::string_view key) noexcept {
+        return m_[std::hash<std::string_view>{}(key) % N];
+    }
+
+    void lock() {
+        for (auto& m : m_) m.lock();
+    }
+    void unlock() noexcept {
+        for (auto it = m_.rbegin(); it != m_.rend(); ++it) it->unlock();
+    }
+
+private:
+    std::array<std::mutex, N> m_;
+};
+
+} // namespace persistency
@@ -0,0 +1,179 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <ara/core/result.hpp>
+#include <persistency/ikey_value_backend.hpp>
+#include <persistency/io_scheduler.hpp>
+#include <persistency/rw_lock.hpp>
+
+namespace persistency {
+
+// "log" engine: append-only segment files with CRC-framed records and an
+// in-memory hash index. A write is a single append to the active segment; a
+// segment that reaches segment_bytes is sealed and a new one is started.
+// Once dead (overwritten/removed) bytes in sealed segments exceed
+// compaction_threshold of their size, a background thread copies the live
+// records into a fresh segment and deletes the old ones.
+//
+// On disk (base_path):
+//   seg-<id>.log   header: "KVLG" u16 version u16 flags u32 id u32 n
+//                          u32 replaced_id[n] u32 crc32c(header)
+//                  records: u32 crc32c | u64 seq | u32 value_len | u16 key_len
+//                           u8 type (1 put, 2 delete, 3 batch) | u8 0 | key | value
+//                  a batch has no key; its value is a run of put/delete records
+//   ..import       while files left by the "file" engine are being imported
+// The CRC covers everything after itself. A compacted segment lists the ids it
+// replaces, so a crash between writing it and deleting the old ones is
+// harmless. Recovery replays all segments keeping the highest seq per key and
+// truncates a torn tail. It maps each segment and walks it once front to
+// back, so its cost follows the bytes stored, not the number of keys. Appends
+// then go to a fresh segment, never to a compaction's output.
+//
+// With Options::mirror every segment has a byte-identical B copy under
+// mirror_path, written by the same appends and synced with it. Recovery
+// continues from the B copy where the A copy stops (torn or corrupt frame)
+// and patches A from it; a segment whose copy is missing or has a bad
+// header is restored from the other one. Reads fall back to B on a CRC
+// mismatch. scrub_on_open additionally compares the two copies and
+// rewrites B where it differs.
+//
+// Reads (GetValue is one pread) share mtx_; appends take it exclusively.
+// fdatasync for "every_write" and SyncToStorage runs after mtx_ is released
+// on a dup of the segment fd, so a slow flush doesn't stall readers and one
+// flush can cover appends made by other threads meanwhile.
+class LogStructuredBackend : public IKeyValueBackend {
+public:
+    struct Options {
+        size_t     segment_bytes{4u * 1024u * 1024u};
+        double     compaction_threshold{0.5};   // dead / total of sealed segments
+        Durability durability{Durability::OnSync};
+        bool        mirror{false};        // A/B redundant segments
+        std::string mirror_path;          // default: <base_path>/.mirror
+        bool        scrub_on_open{false};
+        IoScheduler::QueueHandle io;      // admits appends and compaction output
+    };
+
+    // What the last open did
+    struct RecoveryStats {
+        uint32_t segments{0};
+        uint64_t bytes_scanned{0};
+        uint64_t records{0};
+        uint64_t truncated_bytes{0};     // torn/corrupt tails dropped
+        uint64_t repaired_bytes{0};      // copied from the other copy
+        std::chrono::microseconds duration{0};
+    };
+
+    struct Stats {
+        size_t   segments{0};
+        uint64_t disk_bytes{0};     // all segment files
+        uint64_t dead_bytes{0};     // reclaimable by compaction
+        uint64_t compactions{0};
+    };
+
+    LogStructuredBackend(const std::string& base_path, size_t quota, Options opts);
+    explicit LogStructuredBackend(const std::string& base_path, size_t quota = SIZE_MAX)
+        : LogStructuredBackend(base_path, quota, Options{}) {}
+    ~LogStructuredBackend() override;
+
+    LogStructuredBackend(const LogStructuredBackend&) = delete;
+    LogStructuredBackend& operator=(const LogStructuredBackend&) = delete;
+
+    ara::core::Result<void> SetValue(std::string_view key, std::string_view value) noexcept override;
+    ara::core::Result<std::string> GetValue(std::string_view key) const noexcept override;
+    ara::core::Result<std::vector<std::string>> GetAllKeys() const noexcept override;
+    ara::core::Result<bool> HasKey(std::string_view key) const noexcept override;
+    ara::core::Result<void> VisitKeys(std::string_view prefix, std::string_view after,
+                                      const KeyVisitor& fn) const noexcept override;
+    ara::core::Result<size_t> CountKeys(std::string_view prefix) const noexcept override;
+    ara::core::Result<void> RemoveKey(std::string_view key) noexcept override;
+    ara::core::Result<void> SyncToStorage() const noexcept override;
+    ara::core::Result<void> DiscardPendingChanges() const noexcept override;
+    ara::core::Result<void> ApplyBatch(const std::vector<BatchOp>& ops) noexcept override;
+    ara::core::Result<size_t> ValueSize(std::string_view key) const noexcept override;
+    bool ValidKey(std::string_view key) const noexcept override;
+    size_t GetUsedSpace() const override;   // shared lock on mtx_
+    size_t GetQuota() const override { return quota_; }
+
+    // Compact all sealed segments now (the background thread calls this too)
+    ara::core::Result<void> Compact() noexcept;
+    Stats GetStats() const;
+    RecoveryStats GetRecoveryStats() const;
+
+private:
+    struct Location {
+        uint32_t seg;
+        uint64_t off;        // record start within the segment file
+        uint32_t rec_len;    // header + key + value
+        uint32_t value_len;
+        uint64_t seq;
+    };
+    struct Segment {
+        int      fd{-1};
+        uint64_t size{0};    // bytes in the file, header included
+        uint64_t dead{0};    // bytes of records no longer referenced
+        int      mirror_fd{-1};   // B copy, same size as the A copy
+        uint64_t min_seq{UINT64_MAX};   // oldest record in it; max: none
+    };
+    struct FdPair {
+        int a{-1};
+        int b{-1};           // mirror
+    };
+
+    std::string base_path_;
+    std::string mirror_dir_;                         // empty unless opts_.mirror
+    size_t quota_;
+    Options opts_;
+    RecoveryStats recovery_;
+
+    mutable RwLock mtx_;                           // guards everything below
+    std::map<std::string, Location, std::less<>> index_;   // ordered for prefix scans
+    // Latest delete of each removed key still on disk. Compaction keeps one
+    // while a segment it does not rewrite may hold an older put of the key.
+    std::map<std::string, Location, std::less<>> tombstones_;
+    std::map<uint32_t, Segment> segments_;           // by id
+    uint32_t active_id_{0};
+    uint32_t next_id_{1};
+    uint64_t next_seq_{1};
+    uint64_t used_bytes_{0};                         // live value bytes (quota)
+    uint64_t disk_bytes_{0};
+    uint64_t dead_bytes_{0};
+    uint64_t compactions_{0};
+    bool     ok_{false};                             // false if open/recovery failed
+    bool     compacting_{false};
+
+    std::condition_variable_any cv_;
+    bool stop_{false};
+    bool compact_requested_{false};
+    std::thread compactor_;
+
+    bool OpenNoLock_() noexcept;
+    bool OpenSegmentNoLock_(uint32_t id, size_t& header_len, std::vector<uint32_t>& replaced) noexcept;
+    // scan(data, from, end) replays the records in data[from, end) and
+    // returns where the valid ones stop
+    bool ReplaySegmentNoLock_(uint32_t id, Segment& seg, uint64_t start,
+                              const std::function<uint64_t(const char*, uint64_t, uint64_t)>& scan) noexcept;
+    bool ImportLegacyFilesNoLock_(const std::vector<std::string>& files) noexcept;
+    bool RollNoLock_() noexcept;
+    ara::core::Result<void> WriteFrameNoLock_(const std::string& rec, uint64_t min_seq, uint64_t& off) noexcept;
+    ara::core::Result<void> AppendNoLock_(uint8_t type, std::string_view key,
+                                          std::string_view value, Location& loc) noexcept;
+    FdPair DupActiveFdsNoLock_(bool want) const noexcept;   // -1s unless want
+    static bool SyncAndClose_(FdPair fds) noexcept;
+    void CloseSegment_(Segment& seg) noexcept;
+    void MaybeRequestCompactionNoLock_() noexcept;
+    void CompactorLoop_();
+    std::string SegmentPath_(uint32_t id) const;
+    std::string MirrorPath_(uint32_t id) const;
+};
+
+} // namespace persistency
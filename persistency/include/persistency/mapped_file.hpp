@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <ara/core/result.hpp>
+#include <ara/core/span.hpp>
+
+namespace persistency {
+
+// Read-only view of a stored value or file. It holds a reference to the
+// mapping (or buffer) behind it, so it stays valid after the file is
+// replaced or removed and keeps showing the content it was taken from.
+class MappedView {
+public:
+    MappedView() = default;
+    MappedView(std::shared_ptr<const void> owner, const uint8_t* data, size_t size) noexcept
+        : owner_(std::move(owner)), data_(data), size_(size) {}
+
+    // Owned copy, for back ends that have no file to map
+    static MappedView FromString(std::string value);
+
+    const uint8_t* data() const noexcept { return data_; }
+    size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    std::string_view AsStringView() const noexcept {
+        return {reinterpret_cast<const char*>(data_), size_};
+    }
+    ara::core::Span<const uint8_t> AsSpan() const noexcept { return {data_, size_}; }
+    void remove_prefix(size_t n) noexcept { data_ += n; size_ -= n; }
+
+private:
+    std::shared_ptr<const void> owner_;
+    const uint8_t* data_{nullptr};
+    size_t size_{0};
+};
+
+// Process-wide LRU cache of read-only file mappings, keyed by path. Every
+// path in this library that replaces or removes a file (rename, remove,
+// Reset*) invalidates its entry, so a hit costs a hash lookup and no
+// syscall. Files changed by other processes are only picked up once their
+// entry is evicted. Files larger than the byte budget are mapped but not
+// cached.
+class MappingCache {
+public:
+    struct Stats {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        uint64_t invalidations{0};
+        size_t   entries{0};
+        size_t   bytes{0};
+    };
+
+    static MappingCache& Instance();
+
+    // kNotFound if the file does not exist
+    ara::core::Result<MappedView> Get(const std::string& path) noexcept;
+    void Invalidate(const std::string& path) noexcept;
+    void InvalidatePrefix(const std::string& dir) noexcept;   // everything under dir
+    void SetLimits(size_t max_entries, size_t max_bytes) noexcept;
+    Stats GetStats() const;
+
+private:
+    struct Mapping;
+    struct Entry {
+        std::shared_ptr<const Mapping> map;
+        std::list<std::string>::iterator lru;
+    };
+
+    void EraseNoLock_(std::unordered_map<std::string, Entry>::iterator it) noexcept;
+    void EvictNoLock_() noexcept;
+
+    mutable std::mutex mtx_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_;                 // front = most recently used
+    size_t bytes_{0};
+    size_t max_entries_{64};
+    size_t max_bytes_{64u * 1024u * 1024u};
+    // Bumped by every invalidation; a miss only caches its mapping if no
+    // invalidation happened while it was opening the file
+    uint64_t generation_{0};
+    Stats stats_;
+};
+
+} // namespace persistency
@@ -0,0 +1,39 @@
+#pragma once
+#include <pthread.h>
+
+namespace persistency {
+
+// SharedMutex (usable with std::shared_lock / std::unique_lock) in which a
+// waiting writer goes ahead of readers that arrive after it. glibc's default
+// rwlock, and so std::shared_mutex, prefers readers: a steady stream of
+// GetValue calls could hold off SetValue indefinitely. Not recursive, not
+// even for readers.
+class RwLock {
+public:
+    RwLock() noexcept {
+        pthread_rwlockattr_t attr;
+        pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+        pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+        pthread_rwlock_init(&lock_, &attr);
+        pthread_rwlockattr_destroy(&attr);
+    }
+    ~RwLock() { pthread_rwlock_destroy(&lock_); }
+
+    RwLock(const RwLock&) = delete;
+    RwLock& operator=(const RwLock&) = delete;
+
+    void lock() noexcept { pthread_rwlock_wrlock(&lock_); }
+    bool try_lock() noexcept { return pthread_rwlock_trywrlock(&lock_) == 0; }
+    void unlock() noexcept { pthread_rwlock_unlock(&lock_); }
+
+    void lock_shared() noexcept { pthread_rwlock_rdlock(&lock_); }
+    bool try_lock_shared() noexcept { return pthread_rwlock_tryrdlock(&lock_) == 0; }
+    void unlock_shared() noexcept { pthread_rwlock_unlock(&lock_); }
+
+private:
+    pthread_rwlock_t lock_;
+};
+
+} // namespace persistency
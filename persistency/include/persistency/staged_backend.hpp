@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ara/core/result.hpp>
+#include <persistency/ikey_value_backend.hpp>
+
+namespace persistency {
+
+// Write-back layer ("write_mode": "write_back"). SetValue/RemoveKey only
+// update an in-memory staging map that reads see immediately;
+// SyncToStorage hands all staged changes to the engine as one atomic
+// ApplyBatch, DiscardPendingChanges drops them. A key rewritten many times
+// between syncs costs one write per sync. Keys are checked against the
+// engine's rules (e.g. no '/' for the file engine) when they are staged.
+//
+// A sync moves the staging into an in-flight layer and applies it without
+// holding the staging lock, so reads and writes go on meanwhile; reads see
+// staged, then in-flight, then engine values. Discard only drops what was
+// staged after the sync started.
+class StagedKeyValueBackend : public IKeyValueBackend {
+public:
+    explicit StagedKeyValueBackend(std::shared_ptr<IKeyValueBackend> inner)
+        : inner_(std::move(inner)) {}
+
+    ara::core::Result<void> SetValue(std::string_view key, std::string_view value) noexcept override;
+    ara::core::Result<std::string> GetValue(std::string_view key) const noexcept override;
+    ara::core::Result<std::vector<std::string>> GetAllKeys() const noexcept override;
+    ara::core::Result<bool> HasKey(std::string_view key) const noexcept override;
+    ara::core::Result<void> RemoveKey(std::string_view key) noexcept override;
+    ara::core::Result<void> SyncToStorage() const noexcept override;
+    ara::core::Result<void> DiscardPendingChanges() const noexcept override;
+    ara::core::Result<void> ApplyBatch(const std::vector<BatchOp>& ops) noexcept override;
+    ara::core::Result<size_t> ValueSize(std::string_view key) const noexcept override;
+    bool ValidKey(std::string_view key) const noexcept override { return inner_->ValidKey(key); }
+    ara::core::Result<MappedView> GetValueView(std::string_view key) const noexcept override;
+    // The engine's keys merged with the staged ones, still in order
+    ara::core::Result<void> VisitKeys(std::string_view prefix, std::string_view after,
+                                      const KeyVisitor& fn) const noexcept override;
+    size_t GetUsedSpace() const override;   // engine usage plus staged delta
+    size_t GetQuota() const override { return inner_->GetQuota(); }
+
+    size_t PendingChanges() const;
+
+private:
+    using Overlay = std::map<std::string, std::optional<std::string>, std::less<>>;   // nullopt: removed
+
+    ara::core::Result<void> StageNoLock_(std::string_view key, std::optional<std::string> value) noexcept;
+    // Staged or in-flight entry for key; null if the engine has the say
+    const std::optional<std::string>* FindNoLock_(std::string_view key) const noexcept;
+    // Both layers as one map; staged_ itself unless a sync is in flight
+    const Overlay& OverlayNoLock_(Overlay& scratch) const;
+    int64_t EngineUsedNoLock_() const;
+
+    std::shared_ptr<IKeyValueBackend> inner_;
+    // Sync/Discard are const in the ara::per API, yet they consume the staging
+    mutable std::mutex sync_mtx_;            // one sync in flight at a time
+    mutable std::mutex mtx_;
+    mutable Overlay staged_;
+    mutable int64_t delta_bytes_{0};         // staged size minus engine (+ in-flight) size
+    mutable Overlay in_flight_;              // being applied by SyncToStorage
+    mutable int64_t in_flight_delta_{0};
+    mutable size_t in_flight_base_{0};       // engine usage when the sync started
+};
+
+} // namespace persistency
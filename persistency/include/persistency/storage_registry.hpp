@@ -1,44 +1,110 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <optional>
 #include <unordered_map>
+#include <memory>
 #include <mutex>
 #include <atomic>
+#include <vector>
 #include <ara/core/result.hpp>
+#include <persistency/compression.hpp>
+#include <persistency/ikey_value_backend.hpp>
+#include <persistency/io_scheduler.hpp>
 
 namespace persistency {
 
 enum class StorageType { Kv, Files };
+enum class KvEngine { File, Log };
+enum class WriteMode { WriteThrough, WriteBack };
 
 struct StorageConfig {
     StorageType type;
     std::string base_path;
     size_t      quota_bytes;
     bool        recover_on_start{false};
+    // "kv" only: engine and log-engine tuning
+    KvEngine    engine{KvEngine::File};
+    size_t      segment_bytes{4u * 1024u * 1024u};
+    double      compaction_threshold{0.5};
+    Durability  durability{Durability::OnSync};
+    // "log" engine: "redundancy": "ab" keeps a B copy of every segment in
+    // mirror_path (default <base_path>/.mirror)
+    bool        redundant{false};
+    std::string mirror_path;
+    WriteMode   write_mode{WriteMode::WriteThrough};   // WriteBack: staged until SyncToStorage
+    ValueEncoding value_encoding{ValueEncoding::Binary};
+    // "files" only: batch fsyncs of concurrent writers (see GroupCommitter);
+    // enabled by a "group_commit": {"max_latency_ms": N} object
+    bool        group_commit{false};
+    uint32_t    group_commit_max_latency_ms{5};
+    // "files" only: "watch_external_changes": true keeps the file index
+    // current under out-of-band changes (inotify)
+    bool        watch_external{false};
+    // Write admission (see IoScheduler): "io": {"priority": "critical" |
+    // "normal" | "bulk", "bytes_per_sec", "burst_bytes", "deadline_ms"}.
+    // Applied on every InitFromFile, also to an open storage.
+    IoClassOptions io;
+    // "files" and the "file" kv engine: "compression": {"codec": "lz4" |
+    // "zstd" | "none", "min_bytes", "level"}; LZ4 for hot data, zstd for
+    // data written rarely
+    CompressionOptions compression;
     // optional: reset policy, reserved_headroom, etc.
 };
 
+// One storage of a published snapshot. Immutable once published, apart
+// from the open handle, which has its own mutex.
+struct StorageEntry {
+    std::string   instance;
+    StorageConfig config;
+    // The KeyValueStorage or FileStorage (per config.type) that every open
+    // of this spec shares while anyone holds it
+    mutable std::mutex           open_mtx;
+    mutable std::weak_ptr<void>  open_handle;
+};
+
 class StorageRegistry {
 public:
     static StorageRegistry& Instance();
 
-    // Load from JSON/YAML manifest on startup
+    // Load from JSON/YAML manifest on startup. Publishes a new snapshot;
+    // open storages keep their handle. kResourceBusy (and nothing applied)
+    // if the manifest changes or drops the config of an open storage.
     ara::core::Result<void> InitFromFile(const std::string& config_path) noexcept;
 
-    // Lookup by InstanceSpecifier string
+    // Lookup by InstanceSpecifier string. The result keeps its snapshot
+    // alive, so the entry stays valid after a re-init or Clear(); a
+    // snapshot is freed once no result refers to it.
+    std::shared_ptr<const StorageEntry> Find(std::string_view instance) const noexcept;
+
+    // Find with the entry's open_mtx held, for opening, resetting or
+    // recovering the storage. The entry is the current one, and a re-init
+    // carries over the open handle set under this lock.
+    struct LockedEntry {
+        std::shared_ptr<const StorageEntry> entry;   // null: not configured
+        std::unique_lock<std::mutex> lock;
+    };
+    LockedEntry FindLocked(std::string_view instance) const noexcept;
+
+    // Copying variant of Find
     std::optional<StorageConfig> Lookup(const std::string& instance) const;
 
-    bool IsInitialized() const noexcept { return inited_.load(std::memory_order_acquire); }
-    void Clear() noexcept;
+    bool IsInitialized() const noexcept;
+    // kResourceBusy (and nothing cleared) while any storage is open
+    ara::core::Result<void> Clear() noexcept;
 
 private:
+    struct Snapshot {
+        std::vector<std::unique_ptr<StorageEntry>> entries;
+        std::unordered_map<std::string_view, const StorageEntry*> by_instance;   // views into entries
+    };
+
     StorageRegistry() = default;
     StorageRegistry(const StorageRegistry&) = delete;
     StorageRegistry& operator=(const StorageRegistry&) = delete;
 
-    mutable std::mutex mtx_;
-    std::unordered_map<std::string, StorageConfig> map_;
-    std::atomic<bool> inited_{false};
+    mutable std::mutex mtx_;                               // writers only
+    std::shared_ptr<const Snapshot> snapshot_;             // current; null before init (std::atomic_load/store)
 };
 
 } // namespace persistency
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <ara/core/result.hpp>
+#include <ara/core/span.hpp>
+
+namespace persistency {
+
+// Undo journal of FileStorage's in-place writes (WriteRange, Append), kept
+// next to the file as "<name>.undo".
+//
+// Before the write touches the file, the bytes it is about to overwrite are
+// saved along with the file's size, its inode and a CRC of the new bytes,
+// and the journal is fsynced. The file is then written in place and synced.
+// There is no commit record: recovery tells a finished write from a torn
+// one by the CRC of the range, so a write costs two fsyncs and I/O in
+// proportion to the change. The journal stays behind until the next
+// in-place write of the file overwrites it.
+//
+// Whoever replaces or removes the file must remove its journal first; the
+// inode check only guards against a removal that did not reach the disk.
+inline constexpr const char* kUndoSuffix = ".undo";
+
+// Saves what writing `data` at `offset` into target_fd will overwrite;
+// durable on return. `created` reports a new journal file, whose directory
+// entry still needs an fsync.
+ara::core::Result<void> WriteUndoRecord(const std::string& journal, int target_fd, bool target_existed,
+                                        uint64_t offset, ara::core::Span<const uint8_t> data,
+                                        bool& created) noexcept;
+
+enum class UndoOutcome {
+    Discarded,    // the write finished, never started, or the file was replaced since
+    RolledBack    // the saved bytes and size were restored
+};
+
+// Settles the journal of `target` and removes it
+ara::core::Result<UndoOutcome> RecoverUndoJournal(const std::string& journal, const std::string& target) noexcept;
+
+} // namespace persistency
@@ -0,0 +1,484 @@
+#include <persistency/async_io.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include <fcntl.h>      // open, AT_FDCWD
+#include <unistd.h>     // write, fsync, close, unlink, syscall
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+  #include <linux/io_uring.h>
+  #define PERSISTENCY_HAVE_IO_URING 1
+#endif
+
+namespace fs = std::filesystem;
+using ara::core::ErrorCode;
+using ara::core::PersistencyErrc;
+
+namespace {
+
+// tmp → fsync → rename → fsync dir on the calling thread
+bool write_and_rename_sync(const std::string& tmp, const std::string& final,
+                           const std::vector<uint8_t>& data) {
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    const uint8_t* p = data.data();
+    size_t left = data.size();
+    bool ok = true;
+    while (ok && left > 0) {
+        ssize_t w = ::write(fd, p, left);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) { ok = false; break; }
+        p += w;
+        left -= static_cast<size_t>(w);
+    }
+    ok = ok && ::fsync(fd) == 0;
+    ::close(fd);
+    ok = ok && std::rename(tmp.c_str(), final.c_str()) == 0;
+    if (!ok) return false;
+    int dfd = ::open(fs::path(final).parent_path().c_str(), O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+    if (dfd >= 0) { ::fsync(dfd); ::close(dfd); }
+    return true;
+}
+
+unsigned pool_size() {
+    return std::clamp(std::thread::hardware_concurrency(), 2u, 4u);
+}
+
+} // namespace
+
+namespace persistency {
+
+#ifdef PERSISTENCY_HAVE_IO_URING
+
+// Raw io_uring_setup/enter; the rings are shared with the kernel, so the
+// indices are read and published with acquire/release. SQEs are only
+// written under submit_mtx, CQEs only consumed by the ring thread.
+struct AsyncIo::Ring {
+    int fd{-1};
+    bool single_mmap{false};
+    void* sq_ptr{MAP_FAILED};
+    size_t sq_len{0};
+    void* cq_ptr{MAP_FAILED};
+    size_t cq_len{0};
+    io_uring_sqe* sqes{nullptr};
+    size_t sqes_len{0};
+    unsigned* sq_head{nullptr};
+    unsigned* sq_tail{nullptr};
+    unsigned* sq_mask{nullptr};
+    unsigned* sq_array{nullptr};
+    unsigned sq_entries{0};
+    unsigned* cq_head{nullptr};
+    unsigned* cq_tail{nullptr};
+    unsigned* cq_mask{nullptr};
+    io_uring_cqe* cqes{nullptr};
+    std::mutex submit_mtx;
+
+    ~Ring() {
+        if (sqes) ::munmap(sqes, sqes_len);
+        if (!single_mmap && cq_ptr != MAP_FAILED) ::munmap(cq_ptr, cq_len);
+        if (sq_ptr != MAP_FAILED) ::munmap(sq_ptr, sq_len);
+        if (fd >= 0) ::close(fd);
+    }
+
+    static std::unique_ptr<Ring> Create(unsigned entries) {
+        io_uring_params p{};
+        const int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+        if (fd < 0) return nullptr;
+        auto r = std::make_unique<Ring>();
+        r->fd = fd;
+        if (!r->Probe_()) return nullptr;
+
+        r->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        r->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        r->single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (r->single_mmap) r->sq_len = r->cq_len = std::max(r->sq_len, r->cq_len);
+        r->sq_ptr = ::mmap(nullptr, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           fd, IORING_OFF_SQ_RING);
+        if (r->sq_ptr == MAP_FAILED) return nullptr;
+        r->cq_ptr = r->single_mmap
+            ? r->sq_ptr
+            : ::mmap(nullptr, r->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) return nullptr;
+        r->sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return nullptr;
+        r->sqes = static_cast<io_uring_sqe*>(sqes);
+
+        auto* sq = static_cast<char*>(r->sq_ptr);
+        auto* cq = static_cast<char*>(r->cq_ptr);
+        r->sq_head = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        r->sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        r->sq_mask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        r->sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        r->sq_entries = p.sq_entries;
+        r->cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        r->cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        r->cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        r->cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return r;
+    }
+
+    // The chain needs write, fsync and renameat (5.11+)
+    bool Probe_() {
+        constexpr unsigned kOps = 256;
+        const size_t len = sizeof(io_uring_probe) + kOps * sizeof(io_uring_probe_op);
+        std::unique_ptr<io_uring_probe, void (*)(void*)> probe(
+            static_cast<io_uring_probe*>(std::calloc(1, len)), std::free);
+        if (!probe) return false;
+        if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe.get(), kOps) < 0) {
+            return false;
+        }
+        for (unsigned op : {IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_RENAMEAT}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    int Enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                                          nullptr, 0));
+    }
+
+    // Caller holds submit_mtx and has checked for room
+    io_uring_sqe* Push(unsigned& tail) {
+        const unsigned idx = tail & *sq_mask;
+        io_uring_sqe* sqe = &sqes[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array[idx] = idx;
+        ++tail;
+        return sqe;
+    }
+};
+
+#else
+
+struct AsyncIo::Ring {
+    static std::unique_ptr<Ring> Create(unsigned) { return nullptr; }
+};
+
+#endif
+
+AsyncIo& AsyncIo::Instance() {
+    static AsyncIo io;
+    return io;
+}
+
+AsyncIo::AsyncIo() {
+    const char* env = std::getenv("ARA_PER_IO_URING");
+    if (env && std::strcmp(env, "0") == 0) return;
+    ring_ = Ring::Create(kRingEntries);
+#ifdef PERSISTENCY_HAVE_IO_URING
+    if (ring_) ring_thread_ = std::thread([this] { RingLoop_(); });
+#endif
+}
+
+AsyncIo::~AsyncIo() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : pool_) t.join();
+#ifdef PERSISTENCY_HAVE_IO_URING
+    if (ring_thread_.joinable()) {
+        // A NOP with user_data 0 wakes the ring thread so it sees stop_
+        {
+            std::lock_guard<std::mutex> lock(ring_->submit_mtx);
+            unsigned tail = *ring_->sq_tail;
+            io_uring_sqe* sqe = ring_->Push(tail);
+            sqe->opcode = IORING_OP_NOP;
+            __atomic_store_n(ring_->sq_tail, tail, __ATOMIC_RELEASE);
+            (void)ring_->Enter(1, 0, 0);
+        }
+        ring_thread_.join();
+    }
+#endif
+}
+
+std::future<ara::core::Result<void>>
+AsyncIo::WriteAndRename(std::string tmp_path, std::string final_path, std::vector<uint8_t> data,
+                        std::function<void(bool)> on_done) {
+    auto* w = new Write{std::move(tmp_path), std::move(final_path), std::move(data),
+                        std::move(on_done), {}};
+    auto fut = w->done.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto& queue = by_target_[w->final];
+        queue.push_back(w);
+        if (queue.size() > 1) return fut;   // started when the one ahead finishes
+    }
+    Start_(w);
+    return fut;
+}
+
+AsyncIo::Stats AsyncIo::GetStats() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return stats_;
+}
+
+void AsyncIo::Post_(std::function<void()> job, bool count_as_task) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (pool_.empty()) {
+            for (unsigned i = 0; i < pool_size(); ++i) pool_.emplace_back([this] { PoolLoop_(); });
+        }
+        jobs_.push_back(std::move(job));
+        if (count_as_task) ++stats_.pool_tasks;
+    }
+    cv_.notify_one();
+}
+
+void AsyncIo::PoolLoop_() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    for (;;) {
+        cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+        if (jobs_.empty()) return;   // stop_ and drained
+        auto job = std::move(jobs_.front());
+        jobs_.pop_front();
+        lock.unlock();
+        job();
+        lock.lock();
+    }
+}
+
+void AsyncIo::Start_(Write* w) {
+    if (ring_) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            // ring_failed_ is set under mtx_, so nothing lands in backlog_
+            // after AbandonRing_ has drained it
+            if (!ring_failed_ && chains_in_flight_ >= kMaxChains) {
+                backlog_.push_back(w);
+                return;
+            }
+            ++chains_in_flight_;
+        }
+        if (SubmitChain_(w)) return;   // refused once the ring is abandoned
+        std::lock_guard<std::mutex> lock(mtx_);
+        --chains_in_flight_;
+    }
+    WriteOnPool_(w);
+}
+
+void AsyncIo::WriteOnPool_(Write* w) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        ++stats_.pool_writes;
+    }
+    Post_([this, w] { Finish_(w, write_and_rename_sync(w->tmp, w->final, w->data)); }, false);
+}
+
+void AsyncIo::Finish_(Write* w, bool ok) {
+    if (!ok) ::unlink(w->tmp.c_str());
+    if (w->on_done) w->on_done(ok);
+    if (ok) w->done.set_value(ara::core::Result<void>());
+    else w->done.set_value(ErrorCode(PersistencyErrc::kUnknown));
+
+    Write* next = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = by_target_.find(w->final);
+        it->second.pop_front();
+        if (it->second.empty()) by_target_.erase(it);
+        else next = it->second.front();
+    }
+    delete w;
+    if (next) Start_(next);
+}
+
+#ifdef PERSISTENCY_HAVE_IO_URING
+
+// write → fsync → renameat → fsync(dir), linked: a step only runs if the
+// one before it succeeded (a short write counts as failure), the rest of
+// the chain then completes with -ECANCELED.
+bool AsyncIo::SubmitChain_(Write* w) {
+    if (ring_failed_ || w->data.size() > UINT32_MAX) return false;
+    w->fd = ::open(w->tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    w->dir_fd = ::open(fs::path(w->final).parent_path().c_str(), O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+    if (w->fd < 0 || w->dir_fd < 0) {
+        if (w->fd >= 0) ::close(w->fd);
+        if (w->dir_fd >= 0) ::close(w->dir_fd);
+        w->fd = w->dir_fd = -1;
+        return false;
+    }
+    w->seen = 0;
+    const auto tag = reinterpret_cast<uintptr_t>(w);   // heap pointers leave the low 2 bits free
+
+    std::lock_guard<std::mutex> lock(ring_->submit_mtx);
+    if (ring_failed_) {
+        ::close(w->fd);
+        ::close(w->dir_fd);
+        w->fd = w->dir_fd = -1;
+        return false;
+    }
+    const unsigned first = *ring_->sq_tail;
+    unsigned tail = first;
+
+    io_uring_sqe* sqe = ring_->Push(tail);
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = w->fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(w->data.data());
+    sqe->len = static_cast<uint32_t>(w->data.size());
+    sqe->off = 0;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = tag | 0;
+
+    sqe = ring_->Push(tail);
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = w->fd;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = tag | 1;
+
+    sqe = ring_->Push(tail);
+    sqe->opcode = IORING_OP_RENAMEAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<uintptr_t>(w->tmp.c_str());
+    sqe->len = static_cast<uint32_t>(AT_FDCWD);
+    sqe->addr2 = reinterpret_cast<uintptr_t>(w->final.c_str());
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = tag | 2;
+
+    sqe = ring_->Push(tail);
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = w->dir_fd;
+    sqe->user_data = tag | 3;
+
+    __atomic_store_n(ring_->sq_tail, tail, __ATOMIC_RELEASE);
+    int submitted = ring_->Enter(4, 0, 0);
+    if (submitted < 0 && errno == EINTR) submitted = ring_->Enter(4, 0, 0);
+    if (submitted <= 0) {
+        // Nothing consumed: take the SQEs back
+        __atomic_store_n(ring_->sq_tail, first, __ATOMIC_RELEASE);
+        ::close(w->fd);
+        ::close(w->dir_fd);
+        w->fd = w->dir_fd = -1;
+        return false;
+    }
+    if (submitted < 4) {
+        // The kernel rejected a step and failed the chain. Neutralize what
+        // it has not consumed yet so no step can run out of order; each
+        // still posts a completion, and the write is retried on the pool.
+        for (unsigned i = first + static_cast<unsigned>(submitted); i != tail; ++i) {
+            io_uring_sqe* s = &ring_->sqes[i & *ring_->sq_mask];
+            const uint64_t ud = s->user_data;
+            std::memset(s, 0, sizeof(*s));
+            s->opcode = IORING_OP_NOP;
+            s->user_data = ud;
+            w->res[ud & 3] = -ECANCELED;
+        }
+        for (unsigned i = static_cast<unsigned>(submitted); i < 4; ++i) w->nop_mask |= 1u << i;
+        unsigned left = 4 - static_cast<unsigned>(submitted);
+        while (left > 0) {
+            const int r = ring_->Enter(left, 0, 0);
+            if (r < 0 && errno != EINTR) break;
+            if (r > 0) left -= static_cast<unsigned>(r);
+        }
+    }
+    std::lock_guard<std::mutex> track(mtx_);
+    in_ring_.insert(w);
+    return true;
+}
+
+void AsyncIo::RingLoop_() {
+    for (;;) {
+        if (ring_->Enter(0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+            errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            AbandonRing_();
+            return;
+        }
+
+        std::vector<std::pair<Write*, io_uring_cqe>> ready;
+        unsigned head = *ring_->cq_head;
+        const unsigned tail = __atomic_load_n(ring_->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = ring_->cqes[head & *ring_->cq_mask];
+            if (cqe.user_data == 0) continue;   // wake-up NOP
+            ready.emplace_back(reinterpret_cast<Write*>(cqe.user_data & ~uintptr_t{3}), cqe);
+        }
+        __atomic_store_n(ring_->cq_head, head, __ATOMIC_RELEASE);
+        // A completion can arrive before its submitter has left
+        // SubmitChain_; passing through submit_mtx orders our reads of the
+        // Write after everything the submitter did
+        if (!ready.empty()) { std::lock_guard<std::mutex> sync(ring_->submit_mtx); }
+
+        for (auto& [w, cqe] : ready) {
+            const unsigned step = cqe.user_data & 3;
+            if (!(w->nop_mask & (1u << step))) w->res[step] = cqe.res;
+            if (++w->seen == 4) OnChainDone_(w);
+        }
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (stop_ && chains_in_flight_ == 0) return;
+    }
+}
+
+void AsyncIo::OnChainDone_(Write* w) {
+    ::close(w->fd);
+    ::close(w->dir_fd);
+    w->fd = w->dir_fd = -1;
+    const bool renamed = w->res[2] == 0;
+    const bool ok = renamed && w->res[0] == static_cast<int>(w->data.size()) &&
+                    w->res[1] == 0 && w->res[3] == 0;
+
+    Write* next = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        --chains_in_flight_;
+        in_ring_.erase(w);
+        if (renamed) ++stats_.ring_chains;
+        if (!backlog_.empty()) {
+            next = backlog_.front();
+            backlog_.pop_front();
+        }
+    }
+    // Not renamed: the target is untouched, so redo the whole write the
+    // blocking way (covers short writes, which break the chain)
+    if (renamed) Finish_(w, ok);
+    else WriteOnPool_(w);
+    if (next) Start_(next);
+}
+
+// io_uring_enter failed for good, so nothing the ring holds would ever be
+// reaped. Stop submitting to it and redo those chains, and the ones waiting
+// for room, on the pool so their futures resolve (~FileStorage waits for
+// them). The mapping stays until ~AsyncIo.
+void AsyncIo::AbandonRing_() {
+    std::cerr << "[per] io_uring failed (" << std::strerror(errno) << "), writes fall back to the worker pool\n";
+    std::vector<Write*> redo;
+    {
+        std::lock_guard<std::mutex> sub(ring_->submit_mtx);
+        std::lock_guard<std::mutex> lock(mtx_);
+        ring_failed_ = true;
+        redo.assign(in_ring_.begin(), in_ring_.end());
+        redo.insert(redo.end(), backlog_.begin(), backlog_.end());
+        chains_in_flight_ -= static_cast<unsigned>(in_ring_.size());   // Start_ may hold a slot
+        in_ring_.clear();
+        backlog_.clear();
+    }
+    for (Write* w : redo) {
+        if (w->fd >= 0) ::close(w->fd);
+        if (w->dir_fd >= 0) ::close(w->dir_fd);
+        w->fd = w->dir_fd = -1;
+        WriteOnPool_(w);
+    }
+}
+
+#else
+
+bool AsyncIo::SubmitChain_(Write*) { return false; }
+void AsyncIo::RingLoop_() {}
+void AsyncIo::AbandonRing_() {}
+void AsyncIo::OnChainDone_(Write*) {}
+
+#endif
+
+} // namespace persistency
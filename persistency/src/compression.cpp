@@ -0,0 +1,330 @@
+#include <persistency/compression.hpp>
+#include <persistency/crc32c.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>     // pread, pwrite
+
+#ifdef HAVE_LZ4
+  #include <lz4.h>
+#endif
+#ifdef HAVE_ZSTD
+  #include <zstd.h>
+#endif
+
+using ara::core::ErrorCode;
+using ara::core::PersistencyErrc;
+using persistency::Codec;
+
+namespace {
+
+constexpr uint32_t kMagic     = 0x315A4350;    // "PCZ1"
+constexpr uint32_t kRawBlock  = 0x80000000u;   // stored_len flag: bytes kept as they are
+constexpr size_t kBlockHeader = 8;             // raw_len, stored_len
+constexpr uint32_t kMaxBlock  = 16u << 20;
+
+uint32_t get32(const uint8_t* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+uint64_t get64(const uint8_t* p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+void put32(uint8_t* p, uint32_t v) { std::memcpy(p, &v, 4); }
+
+void write_header(uint8_t* h, Codec codec, uint64_t raw_size) {
+    std::memset(h, 0, persistency::kCompressedHeaderBytes);
+    put32(h, kMagic);
+    h[4] = static_cast<uint8_t>(codec);
+    put32(h + 8, static_cast<uint32_t>(persistency::kCompressionBlockBytes));
+    std::memcpy(h + 12, &raw_size, 8);
+    put32(h + 20, persistency::Crc32c(h, 20));
+}
+
+// Reads until n bytes or EOF; bytes read, or -1 on error
+ssize_t pread_upto(int fd, void* buf, size_t n, uint64_t off) {
+    char* p = static_cast<char*>(buf);
+    size_t done = 0;
+    while (done < n) {
+        ssize_t r = ::pread(fd, p + done, n - done, static_cast<off_t>(off + done));
+        if (r < 0) { if (errno == EINTR) continue; return -1; }
+        if (r == 0) break;
+        done += static_cast<size_t>(r);
+    }
+    return static_cast<ssize_t>(done);
+}
+
+bool pwrite_all(int fd, const void* buf, size_t n, uint64_t off) {
+    const char* p = static_cast<const char*>(buf);
+    while (n > 0) {
+        ssize_t w = ::pwrite(fd, p, n, static_cast<off_t>(off));
+        if (w < 0) { if (errno == EINTR) continue; return false; }
+        p += w; n -= static_cast<size_t>(w); off += static_cast<uint64_t>(w);
+    }
+    return true;
+}
+
+#ifdef HAVE_ZSTD
+// One pair per thread: creating them costs more than a small block
+struct ZstdContexts {
+    ZSTD_CCtx* c{ZSTD_createCCtx()};
+    ZSTD_DCtx* d{ZSTD_createDCtx()};
+    ~ZstdContexts() { ZSTD_freeCCtx(c); ZSTD_freeDCtx(d); }
+};
+ZstdContexts& zstd() {
+    thread_local ZstdContexts contexts;
+    return contexts;
+}
+#endif
+
+size_t bound(Codec codec, size_t n) {
+    switch (codec) {
+#ifdef HAVE_LZ4
+        case Codec::Lz4:  return std::max(n, static_cast<size_t>(LZ4_compressBound(static_cast<int>(n))));
+#endif
+#ifdef HAVE_ZSTD
+        case Codec::Zstd: return std::max(n, ZSTD_compressBound(n));
+#endif
+        default: return n;
+    }
+}
+
+// Bytes written to dst; 0 if the codec is unavailable or failed
+size_t compress_block(Codec codec, int level, const uint8_t* in, size_t n, uint8_t* dst, size_t cap) {
+    switch (codec) {
+#ifdef HAVE_LZ4
+        case Codec::Lz4: {
+            // level is the acceleration here: higher is faster and larger
+            const int r = LZ4_compress_fast(reinterpret_cast<const char*>(in), reinterpret_cast<char*>(dst),
+                                            static_cast<int>(n), static_cast<int>(cap), std::max(level, 1));
+            return r > 0 ? static_cast<size_t>(r) : 0;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case Codec::Zstd: {
+            const size_t r = ZSTD_compressCCtx(zstd().c, dst, cap, in, n, level);
+            return ZSTD_isError(r) ? 0 : r;
+        }
+#endif
+        default:
+            (void)level; (void)in; (void)n; (void)dst; (void)cap;
+            return 0;
+    }
+}
+
+PersistencyErrc decompress_block(Codec codec, const uint8_t* in, size_t n, uint8_t* out, size_t raw_len) {
+    switch (codec) {
+#ifdef HAVE_LZ4
+        case Codec::Lz4: {
+            const int r = LZ4_decompress_safe(reinterpret_cast<const char*>(in), reinterpret_cast<char*>(out),
+                                              static_cast<int>(n), static_cast<int>(raw_len));
+            return r >= 0 && static_cast<size_t>(r) == raw_len ? PersistencyErrc::kSuccess
+                                                                : PersistencyErrc::kCorruption;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case Codec::Zstd: {
+            const size_t r = ZSTD_decompressDCtx(zstd().d, out, raw_len, in, n);
+            return !ZSTD_isError(r) && r == raw_len ? PersistencyErrc::kSuccess : PersistencyErrc::kCorruption;
+        }
+#endif
+        case Codec::None:
+            return PersistencyErrc::kCorruption;   // a container without codec holds raw blocks only
+        default:
+            (void)in; (void)n; (void)out; (void)raw_len;
+            return PersistencyErrc::kUnknown;      // written by a build with the codec
+    }
+}
+
+// Appends one block (header and bytes) to out
+void append_block(Codec codec, int level, const uint8_t* in, size_t n, std::vector<uint8_t>& out) {
+    const size_t at = out.size();
+    const size_t cap = bound(codec, n);
+    out.resize(at + kBlockHeader + cap);
+    uint8_t* payload = out.data() + at + kBlockHeader;
+    size_t stored = compress_block(codec, level, in, n, payload, cap);
+    uint32_t flags = 0;
+    if (stored == 0 || stored >= n) {
+        std::memcpy(payload, in, n);
+        stored = n;
+        flags = kRawBlock;
+    }
+    put32(out.data() + at, static_cast<uint32_t>(n));
+    put32(out.data() + at + 4, static_cast<uint32_t>(stored) | flags);
+    out.resize(at + kBlockHeader + stored);
+}
+
+Codec effective(const persistency::CompressionOptions& opts) {
+    return persistency::CodecAvailable(opts.codec) ? opts.codec : Codec::None;
+}
+
+} // namespace
+
+namespace persistency {
+
+const char* CodecName(Codec codec) noexcept {
+    switch (codec) {
+        case Codec::Lz4:  return "lz4";
+        case Codec::Zstd: return "zstd";
+        case Codec::None: break;
+    }
+    return "none";
+}
+
+bool CodecAvailable(Codec codec) noexcept {
+    switch (codec) {
+#ifdef HAVE_LZ4
+        case Codec::Lz4:  return true;
+#endif
+#ifdef HAVE_ZSTD
+        case Codec::Zstd: return true;
+#endif
+        default: return false;
+    }
+}
+
+std::optional<uint64_t> CompressedRawSize(const uint8_t* head, size_t n) noexcept {
+    if (n < kCompressedHeaderBytes || get32(head) != kMagic) return std::nullopt;
+    if (get32(head + 20) != Crc32c(head, 20) || head[4] > static_cast<uint8_t>(Codec::Zstd)) return std::nullopt;
+    const uint32_t block = get32(head + 8);
+    if (block == 0 || block > kMaxBlock) return std::nullopt;
+    return get64(head + 12);
+}
+
+bool Compress(ara::core::Span<const uint8_t> data, const CompressionOptions& opts, std::vector<uint8_t>& out) {
+    const bool lookalike = CompressedRawSize(data.data(), data.size()).has_value();
+    const Codec codec = data.size() >= opts.min_bytes ? effective(opts) : Codec::None;
+    if (codec == Codec::None && !lookalike) return false;
+
+    out.clear();
+    out.reserve(kCompressedHeaderBytes + data.size() / 2);
+    out.resize(kCompressedHeaderBytes);
+    write_header(out.data(), codec, data.size());
+    for (size_t off = 0; off < data.size(); off += kCompressionBlockBytes) {
+        append_block(codec, opts.level, data.data() + off, std::min(kCompressionBlockBytes, data.size() - off), out);
+    }
+    return lookalike || out.size() < data.size();
+}
+
+ara::core::Result<void> Decompress(ara::core::Span<const uint8_t> stored, uint8_t* out, size_t raw_size) noexcept {
+    const auto raw = CompressedRawSize(stored.data(), stored.size());
+    if (!raw || *raw != raw_size) return ErrorCode(PersistencyErrc::kCorruption);
+    const auto codec = static_cast<Codec>(stored[4]);
+    const uint32_t block = get32(stored.data() + 8);
+
+    size_t in = kCompressedHeaderBytes;
+    for (uint64_t done = 0; done < raw_size;) {
+        if (in + kBlockHeader > stored.size()) return ErrorCode(PersistencyErrc::kCorruption);
+        const uint32_t raw_len = get32(stored.data() + in);
+        const uint32_t packed = get32(stored.data() + in + 4) & ~kRawBlock;
+        const bool is_raw = get32(stored.data() + in + 4) & kRawBlock;
+        in += kBlockHeader;
+        if (raw_len != std::min<uint64_t>(block, raw_size - done) || packed > stored.size() - in ||
+            (is_raw && packed != raw_len)) {
+            return ErrorCode(PersistencyErrc::kCorruption);
+        }
+        if (is_raw) {
+            std::memcpy(out + done, stored.data() + in, raw_len);
+        } else {
+            const auto e = decompress_block(codec, stored.data() + in, packed, out + done, raw_len);
+            if (e != PersistencyErrc::kSuccess) return ErrorCode(e);
+        }
+        in += packed;
+        done += raw_len;
+    }
+    return {};
+}
+
+ara::core::Result<uint64_t> CompressFile(int in_fd, uint64_t raw_size, int out_fd,
+                                         const CompressionOptions& opts) noexcept {
+    const Codec codec = effective(opts);
+    std::vector<uint8_t> raw(kCompressionBlockBytes);
+    std::vector<uint8_t> out(kCompressedHeaderBytes);
+    write_header(out.data(), codec, raw_size);
+    if (!pwrite_all(out_fd, out.data(), out.size(), 0)) return ErrorCode(PersistencyErrc::kUnknown);
+
+    uint64_t pos = kCompressedHeaderBytes;
+    for (uint64_t off = 0; off < raw_size; off += kCompressionBlockBytes) {
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(kCompressionBlockBytes, raw_size - off));
+        if (pread_upto(in_fd, raw.data(), n, off) != static_cast<ssize_t>(n)) {
+            return ErrorCode(PersistencyErrc::kUnknown);
+        }
+        out.clear();
+        append_block(codec, opts.level, raw.data(), n, out);
+        if (!pwrite_all(out_fd, out.data(), out.size(), pos)) return ErrorCode(PersistencyErrc::kUnknown);
+        pos += out.size();
+    }
+    return pos;
+}
+
+ara::core::Result<void> DecompressFile(int in_fd, int out_fd) noexcept {
+    auto reader = BlockReader::Open(in_fd);
+    if (!reader) return ErrorCode(PersistencyErrc::kCorruption);
+    std::vector<uint8_t> buf(kCompressionBlockBytes);
+    for (uint64_t off = 0; off < reader->RawSize();) {
+        const ssize_t r = reader->ReadAt(buf.data(), buf.size(), off);
+        if (r <= 0 || !pwrite_all(out_fd, buf.data(), static_cast<size_t>(r), off)) {
+            return ErrorCode(PersistencyErrc::kUnknown);
+        }
+        off += static_cast<uint64_t>(r);
+    }
+    return {};
+}
+
+// ---------- BlockReader ----------
+
+std::unique_ptr<BlockReader> BlockReader::Open(int fd) noexcept {
+    uint8_t head[kCompressedHeaderBytes];
+    if (pread_upto(fd, head, sizeof head, 0) != static_cast<ssize_t>(sizeof head)) return nullptr;
+    const auto raw = CompressedRawSize(head, sizeof head);
+    if (!raw) return nullptr;
+    return std::unique_ptr<BlockReader>(new BlockReader(fd, static_cast<Codec>(head[4]), get32(head + 8), *raw));
+}
+
+bool BlockReader::LoadBlock_(uint64_t index) noexcept {
+    if (loaded_ == index) return true;
+    uint8_t bh[kBlockHeader];
+    while (offsets_.size() <= index) {
+        if (pread_upto(fd_, bh, sizeof bh, offsets_.back()) != static_cast<ssize_t>(sizeof bh)) return false;
+        offsets_.push_back(offsets_.back() + kBlockHeader + (get32(bh + 4) & ~kRawBlock));
+    }
+    if (pread_upto(fd_, bh, sizeof bh, offsets_[index]) != static_cast<ssize_t>(sizeof bh)) return false;
+    const uint32_t raw_len = get32(bh);
+    const uint32_t packed = get32(bh + 4) & ~kRawBlock;
+    const bool is_raw = get32(bh + 4) & kRawBlock;
+    const uint64_t first = index * block_bytes_;
+    if (first >= raw_size_ || raw_len != std::min<uint64_t>(block_bytes_, raw_size_ - first) ||
+        packed > kMaxBlock + kMaxBlock / 2 || (is_raw && packed != raw_len)) {
+        return false;
+    }
+
+    loaded_ = UINT64_MAX;
+    raw_.resize(raw_len);
+    const uint64_t at = offsets_[index] + kBlockHeader;
+    if (is_raw) {
+        if (pread_upto(fd_, raw_.data(), raw_len, at) != static_cast<ssize_t>(raw_len)) return false;
+    } else {
+        packed_.resize(packed);
+        if (pread_upto(fd_, packed_.data(), packed, at) != static_cast<ssize_t>(packed) ||
+            decompress_block(codec_, packed_.data(), packed, raw_.data(), raw_len) != PersistencyErrc::kSuccess) {
+            return false;
+        }
+    }
+    loaded_ = index;
+    return true;
+}
+
+ssize_t BlockReader::ReadAt(void* buf, size_t n, uint64_t off) noexcept {
+    if (off >= raw_size_) return 0;
+    n = static_cast<size_t>(std::min<uint64_t>(n, raw_size_ - off));
+    auto* out = static_cast<uint8_t*>(buf);
+    size_t done = 0;
+    while (done < n) {
+        const uint64_t pos = off + done;
+        const uint64_t index = pos / block_bytes_;
+        if (!LoadBlock_(index)) return -1;
+        const size_t within = static_cast<size_t>(pos - index * block_bytes_);
+        const size_t take = std::min(n - done, raw_.size() - within);
+        std::memcpy(out + done, raw_.data() + within, take);
+        done += take;
+    }
+    return static_cast<ssize_t>(done);
+}
+
+} // namespace persistency
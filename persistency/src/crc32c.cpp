@@ -0,0 +1,93 @@
+#include <persistency/crc32c.hpp>
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  #include <nmmintrin.h>
+  #define PERSISTENCY_CRC32C_SSE42 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+  #include <arm_acle.h>
+  #define PERSISTENCY_CRC32C_ARM 1
+#endif
+
+namespace persistency {
+
+namespace {
+
+// Reflected polynomial 0x1EDC6F41
+constexpr uint32_t kPoly = 0x82F63B78u;
+
+constexpr std::array<uint32_t, 256> MakeTable() {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = (c & 1) ? (c >> 1) ^ kPoly : (c >> 1);
+        t[i] = c;
+    }
+    return t;
+}
+
+constexpr std::array<uint32_t, 256> kTable = MakeTable();
+
+// Both take and return the inverted register
+uint32_t crc_table(const uint8_t* p, size_t len, uint32_t crc) noexcept {
+    while (len--) crc = kTable[(crc ^ *p++) & 0xFFu] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(PERSISTENCY_CRC32C_SSE42)
+__attribute__((target("sse4.2")))
+uint32_t crc_hw(const uint8_t* p, size_t len, uint32_t crc) noexcept {
+    uint64_t c = crc;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+    }
+    uint32_t c32 = static_cast<uint32_t>(c);
+    while (len--) c32 = _mm_crc32_u8(c32, *p++);
+    return c32;
+}
+#elif defined(PERSISTENCY_CRC32C_ARM)
+uint32_t crc_hw(const uint8_t* p, size_t len, uint32_t crc) noexcept {
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        crc = __crc32cd(crc, v);
+    }
+    while (len--) crc = __crc32cb(crc, *p++);
+    return crc;
+}
+#endif
+
+using CrcFn = uint32_t (*)(const uint8_t*, size_t, uint32_t) noexcept;
+
+CrcFn pick() noexcept {
+#if defined(PERSISTENCY_CRC32C_SSE42)
+    if (__builtin_cpu_supports("sse4.2")) return crc_hw;
+#elif defined(PERSISTENCY_CRC32C_ARM)
+    return crc_hw;
+#endif
+    return crc_table;
+}
+
+CrcFn impl() noexcept {
+    static const CrcFn fn = pick();
+    return fn;
+}
+
+} // namespace
+
+uint32_t Crc32c(const void* data, size_t len, uint32_t crc) noexcept {
+    return ~impl()(static_cast<const uint8_t*>(data), len, ~crc);
+}
+
+uint32_t Crc32cSoftware(const void* data, size_t len, uint32_t crc) noexcept {
+    return ~crc_table(static_cast<const uint8_t*>(data), len, ~crc);
+}
+
+bool Crc32cIsHardwareAccelerated() noexcept {
+    return impl() != crc_table;
+}
+
+} // namespace persistency
@@ -0,0 +1,215 @@
+#include "ara/per/file_accessor.hpp"
+#include "ara/per/file_storage.hpp"
+#include <algorithm>
+#include <cerrno>
+
+#include <unistd.h>     // pread, pwrite, ftruncate, fsync, close
+#include <sys/stat.h>
+
+using ara::core::ErrorCode;
+using ara::core::PersistencyErrc;
+
+namespace {
+
+// Reads until n bytes or EOF; bytes read, or -1 on error
+ssize_t pread_upto(int fd, void* buf, size_t n, uint64_t off) {
+    char* p = static_cast<char*>(buf);
+    size_t done = 0;
+    while (done < n) {
+        ssize_t r = ::pread(fd, p + done, n - done, static_cast<off_t>(off + done));
+        if (r < 0) { if (errno == EINTR) continue; return -1; }
+        if (r == 0) break;
+        done += static_cast<size_t>(r);
+    }
+    return static_cast<ssize_t>(done);
+}
+
+bool pwrite_all(int fd, const void* buf, size_t n, uint64_t off) {
+    const char* p = static_cast<const char*>(buf);
+    while (n > 0) {
+        ssize_t w = ::pwrite(fd, p, n, static_cast<off_t>(off));
+        if (w < 0) { if (errno == EINTR) continue; return false; }
+        p += w; n -= static_cast<size_t>(w); off += static_cast<uint64_t>(w);
+    }
+    return true;
+}
+
+constexpr size_t kLineChunk = 256;   // ReadLine scans ahead this much per pread
+
+} // namespace
+
+namespace ara::per {
+
+// ---------- ReadAccessor ----------
+
+ReadAccessor::~ReadAccessor() noexcept {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+ssize_t ReadAccessor::ReadAt_(void* buf, size_t n, uint64_t off) const noexcept {
+    return blocks_ ? blocks_->ReadAt(buf, n, off) : pread_upto(fd_, buf, n, off);
+}
+
+uint64_t ReadAccessor::GetSize() const noexcept {
+    if (blocks_) return blocks_->RawSize();
+    struct stat st{};
+    return ::fstat(fd_, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+}
+
+ara::core::Result<char> ReadAccessor::PeekChar() const noexcept {
+    char c = 0;
+    const ssize_t r = ReadAt_(&c, 1, pos_);
+    if (r < 0) return ErrorCode(PersistencyErrc::kUnknown);
+    if (r == 0) return ErrorCode(PersistencyErrc::kIsEof);
+    return c;
+}
+
+ara::core::Result<char> ReadAccessor::GetChar() noexcept {
+    auto r = PeekChar();
+    if (r.HasValue()) ++pos_;
+    return r;
+}
+
+ara::core::Result<std::string> ReadAccessor::ReadText() noexcept {
+    const uint64_t size = GetSize();
+    if (pos_ >= size) return std::string();
+    return ReadText(size - pos_);
+}
+
+ara::core::Result<std::string> ReadAccessor::ReadText(uint64_t n) noexcept {
+    const uint64_t size = GetSize();
+    if (n == 0) return std::string();
+    if (pos_ >= size) return ErrorCode(PersistencyErrc::kIsEof);
+    std::string out(static_cast<size_t>(std::min(n, size - pos_)), '\0');
+    const ssize_t r = ReadAt_(out.data(), out.size(), pos_);
+    if (r < 0) return ErrorCode(PersistencyErrc::kUnknown);
+    out.resize(static_cast<size_t>(r));
+    pos_ += static_cast<uint64_t>(r);
+    return out;
+}
+
+ara::core::Result<std::string> ReadAccessor::ReadLine(char delimiter) noexcept {
+    std::string line;
+    char chunk[kLineChunk];
+    for (;;) {
+        const ssize_t r = ReadAt_(chunk, sizeof(chunk), pos_);
+        if (r < 0) return ErrorCode(PersistencyErrc::kUnknown);
+        if (r == 0) {
+            if (line.empty()) return ErrorCode(PersistencyErrc::kIsEof);
+            return line;   // last line without delimiter
+        }
+        const char* begin = chunk;
+        const char* end = chunk + r;
+        const char* hit = std::find(begin, end, delimiter);
+        line.append(begin, hit);
+        if (hit != end) {
+            pos_ += static_cast<uint64_t>(hit - chunk) + 1;
+            return line;
+        }
+        pos_ += static_cast<uint64_t>(r);
+    }
+}
+
+ara::core::Result<std::vector<uint8_t>> ReadAccessor::ReadBinary(uint64_t n) noexcept {
+    const uint64_t size = GetSize();
+    if (n == 0) return std::vector<uint8_t>();
+    if (pos_ >= size) return ErrorCode(PersistencyErrc::kIsEof);
+    std::vector<uint8_t> out(static_cast<size_t>(std::min(n, size - pos_)));
+    auto r = ReadBinary(ara::core::Span<uint8_t>(out));
+    if (!r.HasValue()) return r.Error();
+    out.resize(r.Value().size());
+    return out;
+}
+
+ara::core::Result<ara::core::Span<uint8_t>>
+ReadAccessor::ReadBinary(ara::core::Span<uint8_t> buf) noexcept {
+    if (buf.empty()) return buf;
+    const ssize_t r = ReadAt_(buf.data(), buf.size(), pos_);
+    if (r < 0) return ErrorCode(PersistencyErrc::kUnknown);
+    if (r == 0) return ErrorCode(PersistencyErrc::kIsEof);
+    pos_ += static_cast<uint64_t>(r);
+    return ara::core::Span<uint8_t>(buf.data(), static_cast<size_t>(r));
+}
+
+ara::core::Result<void> ReadAccessor::SetPosition(uint64_t pos) noexcept {
+    if (pos > GetSize()) return ErrorCode(PersistencyErrc::kInvalidPosition);
+    pos_ = pos;
+    return {};
+}
+
+ara::core::Result<int64_t> ReadAccessor::MovePosition(Origin origin, int64_t offset) noexcept {
+    const int64_t size = static_cast<int64_t>(GetSize());
+    int64_t base = 0;
+    switch (origin) {
+        case Origin::kBeginning: base = 0; break;
+        case Origin::kCurrent:   base = static_cast<int64_t>(pos_); break;
+        case Origin::kEnd:       base = size; break;
+    }
+    const int64_t target = base + offset;
+    if (target < 0 || target > size) return ErrorCode(PersistencyErrc::kInvalidPosition);
+    pos_ = static_cast<uint64_t>(target);
+    return target;
+}
+
+// ---------- ReadWriteAccessor ----------
+
+ReadWriteAccessor::~ReadWriteAccessor() noexcept {
+    (void)Close();
+}
+
+ara::core::Result<void> ReadWriteAccessor::WriteBinary(ara::core::Span<const uint8_t> data) noexcept {
+    if (closed_) return ErrorCode(PersistencyErrc::kUnknown);
+    if (std::max(GetSize(), pos_ + data.size()) > max_size_) {
+        return ErrorCode(PersistencyErrc::kQuotaExceeded);
+    }
+    ::persistency::IoScheduler::Instance().Admit(storage_.io_, data.size());
+    if (!pwrite_all(fd_, data.data(), data.size(), pos_)) {
+        failed_ = true;
+        return ErrorCode(PersistencyErrc::kUnknown);
+    }
+    pos_ += data.size();
+    return {};
+}
+
+ara::core::Result<void> ReadWriteAccessor::WriteText(std::string_view text) noexcept {
+    return WriteBinary(ara::core::Span<const uint8_t>(
+        reinterpret_cast<const uint8_t*>(text.data()), text.size()));
+}
+
+ReadWriteAccessor& ReadWriteAccessor::operator<<(std::string_view text) noexcept {
+    if (!WriteText(text).HasValue()) failed_ = true;   // no way to report here; Close() will
+    return *this;
+}
+
+ara::core::Result<void> ReadWriteAccessor::SetFileSize(uint64_t size) noexcept {
+    if (closed_) return ErrorCode(PersistencyErrc::kUnknown);
+    if (size > max_size_) return ErrorCode(PersistencyErrc::kQuotaExceeded);
+    if (::ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+        failed_ = true;
+        return ErrorCode(PersistencyErrc::kUnknown);
+    }
+    pos_ = std::min(pos_, size);
+    return {};
+}
+
+ara::core::Result<void> ReadWriteAccessor::SyncToFile() noexcept {
+    if (closed_) return ErrorCode(PersistencyErrc::kUnknown);
+    if (::fsync(fd_) != 0) return ErrorCode(PersistencyErrc::kUnknown);
+    return {};
+}
+
+ara::core::Result<void> ReadWriteAccessor::Close() noexcept {
+    if (closed_) return {};
+    closed_ = true;
+    // Flush before taking any storage lock
+    const bool ok = !failed_ && ::fsync(fd_) == 0;
+    ::close(fd_);
+    fd_ = -1;
+    if (!ok) {
+        ::unlink(tmp_.c_str());
+        return ErrorCode(PersistencyErrc::kUnknown);
+    }
+    return storage_.CommitWorkingCopy_(rel_, tmp_);
+}
+
+} // namespace ara::per
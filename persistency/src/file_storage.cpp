@@ -1,8 +1,16 @@
 #include "ara/per/file_storage.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <filesystem>
 #include <fstream>
+#include <iostream>
+#include <set>
 #include <system_error>
+#include <persistency/async_io.hpp>
 #include <persistency/storage_registry.hpp>
+#include <persistency/mapped_file.hpp>
+#include <persistency/undo_journal.hpp>
 
 
 #if defined(__unix__) || defined(__APPLE__)
@@ -10,20 +18,75 @@
   #include <fcntl.h>    // open
   #include <sys/stat.h>
 #endif
+#ifdef __linux__
+  #include <sys/inotify.h>
+#endif
 
+using persistency::AsyncIo;
+using persistency::MappingCache;
 using persistency::StorageRegistry;
 using persistency::StorageType;
 
 namespace fs = std::filesystem;
 
 namespace {
-// Reject traversal / absolute paths inside the storage
+// "<name>.tmp" (WriteFile) or "<name>.tmp<N>" (accessors, async writes)
+inline bool is_working_copy(const std::string& name) {
+    const auto pos = name.rfind(".tmp");
+    if (pos == std::string::npos || pos == 0) return false;
+    return std::all_of(name.begin() + static_cast<std::ptrdiff_t>(pos + 4), name.end(),
+                       [](char c) { return c >= '0' && c <= '9'; });
+}
+
+inline bool is_undo_journal(const std::string& name) {
+    const size_t n = std::char_traits<char>::length(persistency::kUndoSuffix);
+    return name.size() > n && name.compare(name.size() - n, n, persistency::kUndoSuffix) == 0;
+}
+
+// Reject traversal / absolute paths inside the storage, and the names of
+// its own working copies and undo journals, which recovery and rescans
+// treat as bookkeeping
 inline bool rel_path_is_safe(std::string_view p) {
     if (p.empty()) return false;
     std::string s(p);
+    const std::string name = fs::path(s).filename().string();
     return s.find("..") == std::string::npos &&
            s.find(':') == std::string::npos &&
-           !fs::path(s).is_absolute();
+           !fs::path(s).is_absolute() &&
+           !is_working_copy(name) && !is_undo_journal(name);
+}
+
+// Replacing or removing a file retires its journal first (see undo_journal.hpp)
+inline void drop_undo_journal(const fs::path& file) {
+    ::unlink((file.string() + persistency::kUndoSuffix).c_str());
+}
+
+bool pwrite_all(int fd, const void* buf, size_t n, uint64_t off) {
+    const char* p = static_cast<const char*>(buf);
+    while (n > 0) {
+        ssize_t w = ::pwrite(fd, p, n, static_cast<off_t>(off));
+        if (w < 0) { if (errno == EINTR) continue; return false; }
+        p += w; n -= static_cast<size_t>(w); off += static_cast<uint64_t>(w);
+    }
+    return true;
+}
+
+// Key of a file in the index, independent of how the caller spelled the
+// path. Paths, path locks and working-copy names are all built from it.
+inline std::string index_key(std::string_view rel) {
+    return fs::path(std::string(rel)).lexically_normal().generic_string();
+}
+
+// Working copies and async writes need a name no other writer uses
+inline std::string unique_tmp_name(const fs::path& file) {
+    static std::atomic<uint64_t> next_tmp{0};
+    return file.string() + ".tmp" + std::to_string(++next_tmp);
+}
+
+std::future<ara::core::Result<void>> ready_future(ara::core::Result<void> r) {
+    std::promise<ara::core::Result<void>> p;
+    p.set_value(std::move(r));
+    return p.get_future();
 }
 
 inline void fsync_file_by_path(const std::string& path) {
@@ -48,38 +111,296 @@ inline void fsync_dir_by_path(const std::string& dir) {
 #endif
 }
 
+// Writes never modify a file in place, so the only crash debris is working
+// copies that were not renamed yet; they would count against the quota.
+ara::core::Result<void> remove_working_copies(const std::string& base_path) {
+    std::error_code ec;
+    std::set<std::string> dirs;
+    std::vector<fs::path> stale;
+    for (const auto& entry : fs::recursive_directory_iterator(base_path, ec)) {
+        if (ec) break;
+        if (entry.is_regular_file() && is_working_copy(entry.path().filename().string())) {
+            stale.push_back(entry.path());
+        }
+    }
+    for (const auto& p : stale) {
+        fs::remove(p, ec);
+        dirs.insert(p.parent_path().string());
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    for (const auto& d : dirs) fsync_dir_by_path(d);
+#endif
+    return {};
+}
+
+// Copies file to tmp with a compressed file's content decoded
+bool copy_decoded(const std::string& file, const std::string& tmp) {
+    int in = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+    int out = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = out >= 0;
+    if (ok) {
+        if (::persistency::BlockReader::Open(in)) {
+            ok = ::persistency::DecompressFile(in, out).HasValue();
+        } else {
+            std::error_code ec;
+            fs::copy_file(file, tmp, fs::copy_options::overwrite_existing, ec);
+            ok = !ec;
+        }
+        ::close(out);
+    }
+    ::close(in);
+    return ok;
+}
+
+// The file to commit in place of the working copy `tmp`: tmp itself, or
+// `packed` holding its compressed form if the options call for that and it
+// saves space (or tmp would pass for a container). The other is removed.
+std::string pack_working_copy(const std::string& tmp, const std::string& packed,
+                              const ::persistency::CompressionOptions& opts) {
+    int in = ::open(tmp.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return tmp;   // the commit reports it
+    struct stat st{};
+    uint8_t head[::persistency::kCompressedHeaderBytes];
+    const bool lookalike = ::pread(in, head, sizeof head, 0) == static_cast<ssize_t>(sizeof head) &&
+                           ::persistency::CompressedRawSize(head, sizeof head).has_value();
+    if (::fstat(in, &st) != 0 ||
+        (!lookalike && (!::persistency::CodecAvailable(opts.codec) || opts.codec == ::persistency::Codec::None ||
+                        static_cast<uint64_t>(st.st_size) < opts.min_bytes))) {
+        ::close(in);
+        return tmp;
+    }
+    const auto raw_size = static_cast<uint64_t>(st.st_size);
+    int out = ::open(packed.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool keep = false;
+    if (out >= 0) {
+        auto size = ::persistency::CompressFile(in, raw_size, out, opts);
+        keep = size.HasValue() && (lookalike || size.Value() < raw_size) && ::fsync(out) == 0;
+        ::close(out);
+    }
+    ::close(in);
+    std::error_code ec;
+    fs::remove(keep ? tmp : packed, ec);
+    return keep ? packed : tmp;
+}
+
 } // namespace
 
 namespace ara::per {
 
-FileStorage::FileStorage(const std::string& base_path, size_t quota)
-    : base_path_(base_path), quota_(quota) {
+FileStorage::FileStorage(const std::string& base_path, size_t quota,
+                         ::persistency::GroupCommitOptions group_commit, bool watch_external,
+                         ::persistency::IoScheduler::QueueHandle io,
+                         ::persistency::CompressionOptions compression)
+    : base_path_(base_path), quota_(quota), group_commit_(group_commit), io_(std::move(io)),
+      compression_(compression) {
     fs::create_directories(base_path_);
+#ifdef __linux__
+    if (watch_external) {
+        inotify_fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd_ < 0) {
+            std::cerr << "[per] inotify unavailable, external changes to " << base_path_ << " go unnoticed\n";
+        }
+    }
+#else
+    (void)watch_external;
+#endif
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<std::string> journals;
+    RescanNoLock_(&journals);
+    bool rolled_back = false;
+    for (const auto& j : journals) {
+        const std::string target = j.substr(0, j.size() - std::char_traits<char>::length(::persistency::kUndoSuffix));
+        auto r = ::persistency::RecoverUndoJournal(j, target);
+        if (r.HasValue() && r.Value() == ::persistency::UndoOutcome::RolledBack) {
+            std::cerr << "[per] rolled back an interrupted in-place write of " << target << "\n";
+            rolled_back = true;
+        }
+    }
+    if (rolled_back) RescanNoLock_();
+}
+
+FileStorage::~FileStorage() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    async_cv_.wait(lock, [this] { return async_pending_ == 0; });
+#ifdef __linux__
+    if (inotify_fd_ >= 0) ::close(inotify_fd_);
+#endif
+}
+
+// The one full walk: at construction, and after inotify lost track. With
+// inotify, every directory is (re)watched on the way. Undo journals found
+// are reported, not indexed.
+void FileStorage::RescanNoLock_(std::vector<std::string>* journals) const {
+    index_.clear();
+    used_ = 0;
+    WatchDirNoLock_("");
+    std::error_code ec;
+    for (const auto& entry : fs::recursive_directory_iterator(base_path_, ec)) {
+        if (ec) break;
+        std::error_code se;
+        const std::string rel = entry.path().lexically_relative(base_path_).generic_string();
+        const std::string name = entry.path().filename().string();
+        if (entry.is_directory(se)) {
+            WatchDirNoLock_(rel);
+        } else if (entry.is_regular_file(se) && is_undo_journal(name)) {
+            if (journals) journals->push_back(entry.path().string());
+        } else if (entry.is_regular_file(se) && !is_working_copy(name)) {
+            const auto size = static_cast<uint64_t>(entry.file_size(se));
+            if (se) continue;
+            index_[rel] = size;
+            used_ += size;
+        }
+    }
+}
+
+void FileStorage::WatchDirNoLock_(const std::string& rel_dir) const {
+#ifdef __linux__
+    if (inotify_fd_ < 0) return;
+    const std::string dir = rel_dir.empty() ? base_path_ : (fs::path(base_path_) / rel_dir).string();
+    const int wd = ::inotify_add_watch(inotify_fd_, dir.c_str(),
+                                       IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE |
+                                       IN_MODIFY | IN_DELETE_SELF | IN_MOVE_SELF);
+    if (wd >= 0) watch_dirs_[wd] = rel_dir;   // a second watch on a directory reuses its wd
+#else
+    (void)rel_dir;
+#endif
+}
+
+// Folds in whatever the kernel reported since the last call. Named files are
+// re-stat'ed rather than trusted, so the storage's own writes, which are
+// reported too, change nothing. Directory changes move whole subtrees and
+// fall back to a rescan. Mappings of whatever changed are dropped from the
+// cache, as the storage's own writes do.
+void FileStorage::RevalidateNoLock_() const {
+#ifdef __linux__
+    if (inotify_fd_ < 0) return;
+    alignas(struct inotify_event) char buf[4096];
+    bool rescan = false;
+    for (;;) {
+        const ssize_t n = ::read(inotify_fd_, buf, sizeof buf);
+        if (n <= 0) break;   // EAGAIN: drained
+        for (ssize_t off = 0; off < n;) {
+            const auto* ev = reinterpret_cast<const struct inotify_event*>(buf + off);
+            off += static_cast<ssize_t>(sizeof(struct inotify_event) + ev->len);
+            if (ev->mask & IN_Q_OVERFLOW) { rescan = true; continue; }
+            if (ev->mask & IN_IGNORED) { watch_dirs_.erase(ev->wd); continue; }
+            auto dir = watch_dirs_.find(ev->wd);
+            if (dir == watch_dirs_.end()) continue;
+            if (ev->mask & (IN_ISDIR | IN_DELETE_SELF | IN_MOVE_SELF)) { rescan = true; continue; }
+            if (ev->len == 0 || is_working_copy(ev->name) || is_undo_journal(ev->name)) continue;
+
+            const std::string key = dir->second.empty() ? std::string(ev->name) : dir->second + "/" + ev->name;
+            const std::string full = (fs::path(base_path_) / key).string();
+            auto it = index_.find(key);
+            const uint64_t old = it == index_.end() ? 0 : it->second;
+            MappingCache::Instance().Invalidate(full);
+            struct stat st{};
+            if (::stat(full.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+                used_ = used_ - old + static_cast<uint64_t>(st.st_size);
+                index_[key] = static_cast<uint64_t>(st.st_size);
+            } else if (it != index_.end()) {
+                used_ -= old;
+                index_.erase(it);
+            }
+        }
+    }
+    if (rescan) {
+        MappingCache::Instance().InvalidatePrefix(base_path_);
+        RescanNoLock_();
+    }
+#endif
+}
+
+uint64_t FileStorage::IndexedSizeNoLock_(const std::string& key) const {
+    auto it = index_.find(key);
+    return it == index_.end() ? 0 : it->second;
+}
+
+// After the rename; async writes to one path commit in order, so the last
+// call carries the size on disk
+void FileStorage::Committed_(const std::string& key, uint64_t size) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto& slot = index_[key];
+    used_ = used_ - slot + size;
+    slot = size;
+}
+
+void FileStorage::Removed_(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = index_.find(key);
+    if (it == index_.end()) return;
+    used_ -= it->second;
+    index_.erase(it);
 }
 
 ara::core::Result<void>
 FileStorage::WriteFile(std::string_view rel, const std::vector<uint8_t>& data) noexcept {
-    std::lock_guard<std::mutex> lock(mtx_);
+    return WriteFile_(rel, data, true);
+}
 
+// admit false: the caller was admitted already
+ara::core::Result<void>
+FileStorage::WriteFile_(std::string_view rel, const std::vector<uint8_t>& data, bool admit) noexcept {
     if (!rel_path_is_safe(rel)) {
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kPermissionDenied);
     }
 
-    fs::path file = fs::path(base_path_) / std::string(rel);
+    const std::string key = index_key(rel);
+    const fs::path file = fs::path(base_path_) / key;
     std::error_code ec;
     fs::create_directories(file.parent_path(), ec); // best effort
 
-    // --- Quota enforcement ---
-    size_t current = GetUsedSpace();                // O(n); OK for minimal impl
-    size_t old_size = 0;
-    if (fs::exists(file)) {
-        std::error_code se;
-        old_size = static_cast<size_t>(fs::file_size(file, se));
+    // Compressed before taking any lock; quota and admission go by the
+    // stored size
+    std::vector<uint8_t> packed;
+    const bool compressed = ::persistency::Compress(data, compression_, packed);
+
+    {
+        // Same-path writers queue here; the file's old size is stable under it
+        std::lock_guard<std::mutex> path_lock(write_locks_.For(key));
+        auto r = ReplaceLocked_(file.string(), key, compressed ? packed : data, admit);
+        if (!r.HasValue() || group_commit_.enabled) return r;
     }
-    size_t new_size = current - old_size + data.size();
-    if (new_size > quota_) {
-        return ara::core::ErrorCode(ara::core::PersistencyErrc::kQuotaExceeded);
+
+#if defined(__unix__) || defined(__APPLE__)
+    fsync_dir_by_path(file.parent_path().string());
+#endif
+
+    return {};
+}
+
+// Replaces the file with `data` as stored; the path lock is held. The
+// directory fsync is left to the caller unless group commit does it.
+ara::core::Result<void>
+FileStorage::ReplaceLocked_(const std::string& target, const std::string& key,
+                            const std::vector<uint8_t>& data, bool admit) noexcept {
+    const fs::path file = target;
+    std::error_code ec;
+
+    // --- Quota enforcement ---
+    // Growth of writes in flight is reserved, so two writers can't both
+    // squeeze into the last free bytes.
+    size_t growth = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        RevalidateNoLock_();
+        const size_t old_size = IndexedSizeNoLock_(key);
+        size_t new_size = used_ + reserved_ - old_size + data.size();
+        if (new_size > quota_) {
+            return ara::core::ErrorCode(ara::core::PersistencyErrc::kQuotaExceeded);
+        }
+        growth = data.size() > old_size ? data.size() - old_size : 0;
+        reserved_ += growth;
     }
+    auto release = [&](bool ok) -> ara::core::Result<void> {
+        std::lock_guard<std::mutex> lock(mtx_);
+        reserved_ -= growth;
+        if (!ok) return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+        return {};
+    };
+
+    if (admit) ::persistency::IoScheduler::Instance().Admit(io_, data.size());
 
     // --- Atomic write: tmp → fsync → rename → fsync dir ---
     fs::path tmp = file;
@@ -87,53 +408,272 @@ FileStorage::WriteFile(std::string_view rel, const std::vector<uint8_t>& data) n
 
     {
         std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
-        if (!ofs) return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+        if (!ofs) return release(false);
         ofs.write(reinterpret_cast<const char*>(data.data()),
                   static_cast<std::streamsize>(data.size()));
-        if (!ofs) return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
         ofs.flush();
         ofs.close();
-        fsync_file_by_path(tmp.string());
+        if (!ofs) { std::error_code ec2; fs::remove(tmp, ec2); return release(false); }
+    }
+
+    drop_undo_journal(file);
+    if (group_commit_.enabled) {
+        // fsync, rename and the directory fsync happen on the commit
+        // thread, shared with whoever else commits in the same window
+        auto done = ::persistency::GroupCommitter::Instance()
+                        .Submit(tmp.string(), file.string(), group_commit_.max_latency);
+        const bool ok = done.get().HasValue();
+        if (ok) {
+            MappingCache::Instance().Invalidate(file.string());
+            Committed_(key, data.size());
+        }
+        return release(ok);
     }
 
+    fsync_file_by_path(tmp.string());
     fs::rename(tmp, file, ec);
     if (ec) {
         std::error_code ec2; fs::remove(tmp, ec2);
-        return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+        return release(false);
     }
+    MappingCache::Instance().Invalidate(file.string());
+    Committed_(key, data.size());
+    return release(true);
+}
 
-#if defined(__unix__) || defined(__APPLE__)
-    fsync_dir_by_path(file.parent_path().string());
-#endif
+std::future<ara::core::Result<void>>
+FileStorage::WriteFileAsync(std::string_view rel, std::vector<uint8_t> data) noexcept {
+    if (!rel_path_is_safe(rel)) {
+        return ready_future(ara::core::ErrorCode(ara::core::PersistencyErrc::kPermissionDenied));
+    }
+    const std::string key = index_key(rel);
+    const fs::path file = fs::path(base_path_) / key;
+    std::error_code ec;
+    fs::create_directories(file.parent_path(), ec); // best effort
 
-    return {};
+    if (group_commit_.enabled) {
+        // Group commit already batches the syncs; just take the wait off
+        // the caller's thread
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            ++async_pending_;
+        }
+        auto done = std::make_shared<std::promise<ara::core::Result<void>>>();
+        auto fut = done->get_future();
+        const size_t size = data.size();
+        auto write = [this, done, rel = std::string(rel), data = std::make_shared<std::vector<uint8_t>>(std::move(data))] {
+            (void)AsyncIo::Instance().Run([this, done, rel, data] {
+                done->set_value(WriteFile_(rel, *data, false));
+                std::lock_guard<std::mutex> lock(mtx_);
+                --async_pending_;
+                async_cv_.notify_all();
+            });
+        };
+        ::persistency::IoScheduler::Instance().AdmitAsync(io_, size, std::move(write));
+        return fut;
+    }
+
+    std::vector<uint8_t> packed;
+    if (::persistency::Compress(data, compression_, packed)) data = std::move(packed);
+
+    // Same check as WriteFile; the reservation is held until the commit
+    size_t growth = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        RevalidateNoLock_();
+        const size_t old_size = IndexedSizeNoLock_(key);
+        if (used_ + reserved_ - old_size + data.size() > quota_) {
+            return ready_future(ara::core::ErrorCode(ara::core::PersistencyErrc::kQuotaExceeded));
+        }
+        growth = data.size() > old_size ? data.size() - old_size : 0;
+        reserved_ += growth;
+        ++async_pending_;
+    }
+    // Admission keeps the call order of one storage, so WriteAndRename
+    // still sees the writes to a path in order
+    auto done = std::make_shared<std::promise<ara::core::Result<void>>>();
+    auto fut = done->get_future();
+    const size_t size = data.size();
+    auto write = [this, done, growth, key, file, data = std::make_shared<std::vector<uint8_t>>(std::move(data))] {
+        drop_undo_journal(file);
+        // Runs on an AsyncIo thread
+        auto on_done = [this, done, growth, key, size = data->size(), target = file.string()](bool ok) {
+            if (ok) {
+                MappingCache::Instance().Invalidate(target);
+                Committed_(key, size);
+            }
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                reserved_ -= growth;
+            }
+            if (ok) done->set_value(ara::core::Result<void>());
+            else done->set_value(ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown));
+            std::lock_guard<std::mutex> lock(mtx_);
+            --async_pending_;
+            async_cv_.notify_all();
+        };
+        (void)AsyncIo::Instance().WriteAndRename(unique_tmp_name(file), file.string(),
+                                                 std::move(*data), std::move(on_done));
+    };
+    ::persistency::IoScheduler::Instance().AdmitAsync(io_, size, std::move(write));
+    return fut;
 }
 
 ara::core::Result<std::vector<uint8_t>>
 FileStorage::ReadFile(std::string_view rel) const noexcept {
-    std::lock_guard<std::mutex> lock(mtx_);
     if (!rel_path_is_safe(rel)) {
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kPermissionDenied);
     }
-    fs::path file = fs::path(base_path_) / std::string(rel);
-    std::ifstream ifs(file, std::ios::binary);
-    if (!ifs) return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
-    std::vector<uint8_t> data((std::istreambuf_iterator<char>(ifs)),
-                               std::istreambuf_iterator<char>());
-    return data;
+    // Sized up front and read in one go
+    auto acc = OpenFileReadOnly(rel);
+    if (!acc.HasValue()) return acc.Error();
+    const uint64_t size = acc.Value()->GetSize();
+    if (size == 0) return std::vector<uint8_t>();
+    return acc.Value()->ReadBinary(size);
+}
+
+ara::core::Result<::persistency::MappedView>
+FileStorage::ReadFileMapped(std::string_view rel) const noexcept {
+    if (!rel_path_is_safe(rel)) {
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kPermissionDenied);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        RevalidateNoLock_();   // drops mappings of files replaced externally
+    }
+    auto view = MappingCache::Instance().Get((fs::path(base_path_) / index_key(rel)).string());
+    if (!view.HasValue()) return view;
+    const auto& v = view.Value();
+    const auto raw_size = ::persistency::CompressedRawSize(v.data(), v.size());
+    if (!raw_size) return view;
+    std::string raw(static_cast<size_t>(*raw_size), '\0');
+    auto r = ::persistency::Decompress(ara::core::Span<const uint8_t>(v.data(), v.size()),
+                                       reinterpret_cast<uint8_t*>(raw.data()), raw.size());
+    if (!r.HasValue()) return r.Error();
+    return ::persistency::MappedView::FromString(std::move(raw));
+}
+
+ara::core::Result<UniqueHandle<ReadAccessor>>
+FileStorage::OpenFileReadOnly(std::string_view rel) const noexcept {
+    if (!rel_path_is_safe(rel)) {
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kPermissionDenied);
+    }
+    const std::string file = (fs::path(base_path_) / index_key(rel)).string();
+    int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return ara::core::ErrorCode(errno == ENOENT ? ara::core::PersistencyErrc::kNotFound
+                                                    : ara::core::PersistencyErrc::kPermissionDenied);
+    }
+    auto* acc = new ReadAccessor(fd);
+    acc->blocks_ = ::persistency::BlockReader::Open(fd);
+    return UniqueHandle<ReadAccessor>(acc);
+}
+
+ara::core::Result<UniqueHandle<ReadWriteAccessor>>
+FileStorage::OpenFileReadWrite(std::string_view rel) noexcept {
+    return OpenForWrite_(rel, true);
+}
+
+ara::core::Result<UniqueHandle<ReadWriteAccessor>>
+FileStorage::OpenFileWriteOnly(std::string_view rel) noexcept {
+    return OpenForWrite_(rel, false);
+}
+
+// The working copy lives next to the target (same filesystem, so the final
+// rename is atomic) under a per-accessor name.
+ara::core::Result<UniqueHandle<ReadWriteAccessor>>
+FileStorage::OpenForWrite_(std::string_view rel, bool keep) noexcept {
+    if (!rel_path_is_safe(rel)) {
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kPermissionDenied);
+    }
+    const std::string key = index_key(rel);
+    const fs::path file = fs::path(base_path_) / key;
+    const std::string tmp = unique_tmp_name(file);
+    std::error_code ec;
+    fs::create_directories(file.parent_path(), ec); // best effort
+
+    // Headroom: quota minus everything else; re-checked on commit. What a
+    // compressed file will take is only known then.
+    uint64_t max_size = UINT64_MAX;
+    if (quota_ != SIZE_MAX && compression_.codec == ::persistency::Codec::None) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        RevalidateNoLock_();
+        const size_t others = used_ + reserved_ - IndexedSizeNoLock_(key);
+        max_size = others < quota_ ? quota_ - others : 0;
+    }
+
+    if (keep && fs::exists(file, ec)) {
+        // The working copy holds the raw content
+        if (!copy_decoded(file.string(), tmp)) {
+            std::error_code ec2; fs::remove(tmp, ec2);
+            return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+        }
+    }
+    int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | (keep ? 0 : O_TRUNC), 0644);
+    if (fd < 0) {
+        std::error_code ec2; fs::remove(tmp, ec2);
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+    }
+    return UniqueHandle<ReadWriteAccessor>(
+        new ReadWriteAccessor(fd, *this, key, tmp, max_size));
+}
+
+// Called by ReadWriteAccessor::Close() once the working copy is synced
+ara::core::Result<void>
+FileStorage::CommitWorkingCopy_(const std::string& rel, const std::string& raw_tmp) noexcept {
+    const std::string key = index_key(rel);
+    const fs::path file = fs::path(base_path_) / key;
+    std::error_code ec;
+    // Packed before taking the path lock
+    const std::string tmp = pack_working_copy(raw_tmp, unique_tmp_name(file), compression_);
+    {
+        std::lock_guard<std::mutex> path_lock(write_locks_.For(key));
+        const auto size = static_cast<uint64_t>(fs::file_size(tmp, ec));
+        if (ec) {
+            std::error_code ec2; fs::remove(tmp, ec2);
+            return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            RevalidateNoLock_();
+            if (used_ + reserved_ - IndexedSizeNoLock_(key) + size > quota_) {
+                std::error_code ec2; fs::remove(tmp, ec2);
+                return ara::core::ErrorCode(ara::core::PersistencyErrc::kQuotaExceeded);
+            }
+        }
+        drop_undo_journal(file);
+        fs::rename(tmp, file, ec);
+        if (ec) {
+            std::error_code ec2; fs::remove(tmp, ec2);
+            return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+        }
+        MappingCache::Instance().Invalidate(file.string());
+        Committed_(key, size);
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    fsync_dir_by_path(file.parent_path().string());
+#endif
+    return {};
 }
 
 ara::core::Result<void>
 FileStorage::RemoveFile(std::string_view rel) noexcept {
-    std::lock_guard<std::mutex> lock(mtx_);
     if (!rel_path_is_safe(rel)) {
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kPermissionDenied);
     }
-    fs::path file = fs::path(base_path_) / std::string(rel);
-    std::error_code ec;
-    bool ok = fs::remove(file, ec);
-    if (!ok || ec) {
-        return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
+    const std::string key = index_key(rel);
+    const fs::path file = fs::path(base_path_) / key;
+    {
+        std::lock_guard<std::mutex> path_lock(write_locks_.For(key));
+        drop_undo_journal(file);
+        std::error_code ec;
+        bool ok = fs::remove(file, ec);
+        if (!ok || ec) {
+            if (!ok && !ec) Removed_(key);   // gone behind our back
+            return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
+        }
+        MappingCache::Instance().Invalidate(file.string());
+        Removed_(key);
     }
 #if defined(__unix__) || defined(__APPLE__)
     fsync_dir_by_path(file.parent_path().string());
@@ -141,32 +681,124 @@ FileStorage::RemoveFile(std::string_view rel) noexcept {
     return {};
 }
 
+ara::core::Result<void>
+FileStorage::WriteRange(std::string_view rel, uint64_t offset, ara::core::Span<const uint8_t> data) noexcept {
+    if (offset == UINT64_MAX) return ara::core::ErrorCode(ara::core::PersistencyErrc::kInvalidPosition);
+    return WriteInPlace_(rel, offset, data);
+}
+
+ara::core::Result<void>
+FileStorage::Append(std::string_view rel, ara::core::Span<const uint8_t> data) noexcept {
+    return WriteInPlace_(rel, UINT64_MAX, data);
+}
+
+// offset UINT64_MAX: at the end, as seen under the path lock. A compressed
+// file has no stable byte offsets to patch, so it is decoded, changed and
+// replaced whole.
+ara::core::Result<void>
+FileStorage::WriteInPlace_(std::string_view rel, uint64_t offset, ara::core::Span<const uint8_t> data) noexcept {
+    if (!rel_path_is_safe(rel)) {
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kPermissionDenied);
+    }
+    const std::string key = index_key(rel);
+    const fs::path file = fs::path(base_path_) / key;
+    std::error_code ec;
+    fs::create_directories(file.parent_path(), ec); // best effort
+
+    std::lock_guard<std::mutex> path_lock(write_locks_.For(key));
+    bool existed = true;
+    int fd = ::open(file.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0 && errno == ENOENT) {
+        existed = false;
+        fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    }
+    if (fd < 0) return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+    if (auto blocks = ::persistency::BlockReader::Open(fd)) {
+        std::vector<uint8_t> content(static_cast<size_t>(blocks->RawSize()));
+        const ssize_t r = blocks->ReadAt(content.data(), content.size(), 0);
+        ::close(fd);
+        if (r != static_cast<ssize_t>(content.size())) {
+            return ara::core::ErrorCode(ara::core::PersistencyErrc::kCorruption);
+        }
+        if (offset == UINT64_MAX) offset = content.size();
+        if (offset > content.size()) return ara::core::ErrorCode(ara::core::PersistencyErrc::kInvalidPosition);
+        content.resize(std::max<size_t>(content.size(), static_cast<size_t>(offset) + data.size()));
+        std::copy(data.begin(), data.end(), content.begin() + static_cast<std::ptrdiff_t>(offset));
+        std::vector<uint8_t> packed;
+        const bool compressed = ::persistency::Compress(content, compression_, packed);
+        auto replaced = ReplaceLocked_(file.string(), key, compressed ? packed : content, true);
+#if defined(__unix__) || defined(__APPLE__)
+        if (replaced.HasValue() && !group_commit_.enabled) fsync_dir_by_path(file.parent_path().string());
+#endif
+        return replaced;
+    }
+    auto fail = [&](ara::core::PersistencyErrc e) -> ara::core::Result<void> {
+        ::close(fd);
+        if (!existed) ::unlink(file.c_str());
+        return ara::core::ErrorCode(e);
+    };
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) return fail(ara::core::PersistencyErrc::kUnknown);
+    const auto old_size = static_cast<uint64_t>(st.st_size);
+    if (offset == UINT64_MAX) offset = old_size;
+    if (offset > old_size) return fail(ara::core::PersistencyErrc::kInvalidPosition);
+    const uint64_t new_size = std::max<uint64_t>(old_size, offset + data.size());
+
+    const size_t growth = static_cast<size_t>(new_size - old_size);
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        RevalidateNoLock_();
+        if (used_ + reserved_ - IndexedSizeNoLock_(key) + new_size > quota_) {
+            return fail(ara::core::PersistencyErrc::kQuotaExceeded);
+        }
+        reserved_ += growth;
+    }
+    auto release = [&](bool ok) -> ara::core::Result<void> {
+        std::lock_guard<std::mutex> lock(mtx_);
+        reserved_ -= growth;
+        if (!ok) return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+        return {};
+    };
+    ::persistency::IoScheduler::Instance().Admit(io_, data.size());
+
+    const std::string journal = file.string() + ::persistency::kUndoSuffix;
+    bool journal_created = false;
+    if (!::persistency::WriteUndoRecord(journal, fd, existed, offset, data, journal_created).HasValue()) {
+        (void)fail(ara::core::PersistencyErrc::kUnknown);
+        return release(false);
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    // Both names must outlive a crash before the file changes
+    if (!existed || journal_created) fsync_dir_by_path(file.parent_path().string());
+#endif
+
+    const bool ok = pwrite_all(fd, data.data(), data.size(), offset) && ::fsync(fd) == 0;
+    ::close(fd);
+    MappingCache::Instance().Invalidate(file.string());
+    if (!ok) {
+        // Undo now rather than at the next open
+        (void)::persistency::RecoverUndoJournal(journal, file.string());
+        return release(false);
+    }
+    Committed_(key, new_size);
+    return release(true);
+}
+
 ara::core::Result<std::vector<std::string>>
 FileStorage::ListFiles() const noexcept {
     std::lock_guard<std::mutex> lock(mtx_);
+    RevalidateNoLock_();
     std::vector<std::string> files;
-    std::error_code ec;
-    for (const auto& entry : fs::recursive_directory_iterator(base_path_, ec)) {
-        if (ec) break;
-        if (entry.is_regular_file()) {
-            files.push_back(entry.path().lexically_relative(base_path_).string());
-        }
-    }
+    files.reserve(index_.size());
+    for (const auto& [name, size] : index_) files.push_back(name);
     return files;
 }
 
 size_t FileStorage::GetUsedSpace() const {
-    // Caller must hold lock if consistency vs concurrent writes matters
-    size_t total = 0;
-    std::error_code ec;
-    for (const auto& entry : fs::recursive_directory_iterator(base_path_, ec)) {
-        if (ec) break;
-        if (entry.is_regular_file()) {
-            total += static_cast<size_t>(entry.file_size(ec));
-            if (ec) { ec.clear(); }
-        }
-    }
-    return total;
+    std::lock_guard<std::mutex> lock(mtx_);
+    RevalidateNoLock_();
+    return used_;
 }
 
 ara::core::Result<void> FileStorage::SyncToStorage() const noexcept {
@@ -193,26 +825,64 @@ OpenFileStorage(ara::core::InstanceSpecifier fs_spec, size_t quota_bytes) noexce
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
     }
 
-    auto cfg = StorageRegistry::Instance().Lookup(fs_spec.ToString());
-    if (!cfg || cfg->type != StorageType::Files) {
+    const auto [spec, lock] = StorageRegistry::Instance().FindLocked(fs_spec.ToString());
+    if (!spec || spec->config.type != StorageType::Files) {
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
     }
+    const auto& cfg = spec->config;
+
+    // Re-opens share the open storage and touch no files
+    if (auto open = spec->open_handle.lock()) return std::static_pointer_cast<FileStorage>(open);
 
-    return std::make_shared<FileStorage>(cfg->base_path, cfg->quota_bytes);
+    // Not open, so no write of this process is in flight
+    if (cfg.recover_on_start) {
+        auto r = remove_working_copies(cfg.base_path);
+        if (!r.HasValue()) return r.Error();
+    }
+
+    ::persistency::GroupCommitOptions gc;
+    gc.enabled = cfg.group_commit;
+    gc.max_latency = std::chrono::milliseconds(cfg.group_commit_max_latency_ms);
+    if (!::persistency::CodecAvailable(cfg.compression.codec)) {
+        std::cerr << "[per] " << spec->instance << ": " << ::persistency::CodecName(cfg.compression.codec)
+                  << " not built in, storing uncompressed\n";
+    }
+    auto handle = std::make_shared<FileStorage>(cfg.base_path, cfg.quota_bytes, gc, cfg.watch_external,
+                                                ::persistency::IoScheduler::Instance().Register(spec->instance, cfg.io),
+                                                cfg.compression);
+    spec->open_handle = handle;
+    return handle;
 }
 
-ara::core::Result<void> RecoverFileStorage(ara::core::InstanceSpecifier) noexcept {
-    // Minimal: no-op
-    return {};
+ara::core::Result<void> RecoverFileStorage(ara::core::InstanceSpecifier fs_spec) noexcept {
+    if (!StorageRegistry::Instance().IsInitialized())
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+    const auto [spec, lock] = StorageRegistry::Instance().FindLocked(fs_spec.ToString());
+    if (!spec || spec->config.type != StorageType::Files)
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
+
+    // An open storage may be writing one of them right now
+    if (!spec->open_handle.expired())
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kResourceBusy);
+    return remove_working_copies(spec->config.base_path);
 }
 
 ara::core::Result<void> ResetFileStorage(ara::core::InstanceSpecifier fs_spec) noexcept {
     if (!StorageRegistry::Instance().IsInitialized())
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
-    auto cfg = StorageRegistry::Instance().Lookup(fs_spec.ToString());
-    if (!cfg || cfg->type != StorageType::Files)
+    const auto [spec, lock] = StorageRegistry::Instance().FindLocked(fs_spec.ToString());
+    if (!spec || spec->config.type != StorageType::Files)
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
-    fs::path base = cfg->base_path;
+    fs::path base = spec->config.base_path;
+
+    // Deleting files under an open storage would leave its index stale
+    if (auto open = spec->open_handle.lock()) {
+        auto storage = std::static_pointer_cast<FileStorage>(open);
+        auto files = storage->ListFiles();
+        if (!files.HasValue()) return files.Error();
+        for (const auto& f : files.Value()) (void)storage->RemoveFile(f);
+        return {};
+    }
 
     std::error_code ec;
     if (!fs::exists(base, ec)) return {};
@@ -220,6 +890,7 @@ ara::core::Result<void> ResetFileStorage(ara::core::InstanceSpecifier fs_spec) n
         if (ec) break;
         if (entry.is_regular_file()) fs::remove(entry.path(), ec);
     }
+    MappingCache::Instance().InvalidatePrefix(base.string());
 #if defined(__unix__) || defined(__APPLE__)
     fsync_dir_by_path(base.string());
 #endif
@@ -0,0 +1,119 @@
+#include <persistency/group_commit.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <set>
+
+#include <fcntl.h>      // open
+#include <unistd.h>     // fsync, close, unlink
+
+namespace fs = std::filesystem;
+using ara::core::ErrorCode;
+using ara::core::PersistencyErrc;
+
+namespace {
+
+bool fsync_path(const std::string& path, int extra_flags) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | extra_flags);
+    if (fd < 0) return false;
+    const bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+} // namespace
+
+namespace persistency {
+
+GroupCommitter& GroupCommitter::Instance() {
+    static GroupCommitter committer;
+    return committer;
+}
+
+GroupCommitter::~GroupCommitter() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+std::future<ara::core::Result<void>>
+GroupCommitter::Submit(std::string tmp_path, std::string final_path, std::chrono::milliseconds max_latency) {
+    Pending p{std::move(tmp_path), std::move(final_path),
+              std::chrono::steady_clock::now() + max_latency, {}};
+    auto fut = p.done.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!thread_.joinable()) thread_ = std::thread([this] { Loop_(); });
+        queue_.push_back(std::move(p));
+    }
+    cv_.notify_all();
+    return fut;
+}
+
+GroupCommitter::Stats GroupCommitter::GetStats() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return stats_;
+}
+
+void GroupCommitter::Loop_() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    for (;;) {
+        cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) return;   // stop_ and drained
+
+        // Wait for company until the most urgent request is due
+        auto earliest = [this] {
+            return std::min_element(queue_.begin(), queue_.end(), [](const Pending& a, const Pending& b) {
+                return a.deadline < b.deadline;
+            })->deadline;
+        };
+        while (!stop_ && queue_.size() < kMaxBatch &&
+               cv_.wait_until(lock, earliest()) == std::cv_status::no_timeout) {
+        }
+
+        std::vector<Pending> batch;
+        batch.swap(queue_);
+        lock.unlock();
+        CommitBatch_(batch);
+        lock.lock();
+        ++stats_.batches;
+        stats_.files += batch.size();
+    }
+}
+
+void GroupCommitter::CommitBatch_(std::vector<Pending>& batch) {
+    std::vector<bool> ok(batch.size(), false);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        ok[i] = fsync_path(batch[i].tmp, 0);
+    }
+    // Submission order, so the last of several writes to one path wins
+    std::set<std::string> dirs;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (ok[i] && std::rename(batch[i].tmp.c_str(), batch[i].final.c_str()) == 0) {
+            dirs.insert(fs::path(batch[i].final).parent_path().string());
+        } else {
+            ok[i] = false;
+            ::unlink(batch[i].tmp.c_str());
+        }
+    }
+    for (const auto& d : dirs) {
+#ifdef O_DIRECTORY
+        (void)fsync_path(d, O_DIRECTORY);
+#else
+        (void)fsync_path(d, 0);
+#endif
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stats_.dir_syncs += dirs.size();
+    }
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (ok[i]) batch[i].done.set_value(ara::core::Result<void>());
+        else batch[i].done.set_value(ErrorCode(PersistencyErrc::kUnknown));
+    }
+}
+
+} // namespace persistency
@@ -0,0 +1,251 @@
+#include <persistency/io_scheduler.hpp>
+#include <algorithm>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double burst_of(uint64_t rate, uint64_t burst) {
+    if (burst) return static_cast<double>(burst);
+    return std::max(static_cast<double>(rate) / 10.0, 4096.0);   // 100 ms worth
+}
+
+std::chrono::milliseconds deadline_of(const persistency::IoClassOptions& o) {
+    using persistency::IoPriority;
+    if (o.deadline.count() > 0) return o.deadline;
+    switch (o.priority) {
+        case IoPriority::Critical: return std::chrono::milliseconds(10);
+        case IoPriority::Normal:   return std::chrono::milliseconds(100);
+        case IoPriority::Bulk:     break;
+    }
+    return std::chrono::milliseconds(1000);
+}
+
+// A bucket starts full
+void refill(double& tokens, Clock::time_point& at, Clock::time_point now, uint64_t rate, double burst) {
+    if (at == Clock::time_point{}) {
+        tokens = burst;
+    } else {
+        tokens = std::min(burst, tokens + static_cast<double>(rate) * std::chrono::duration<double>(now - at).count());
+    }
+    at = now;
+}
+
+Clock::duration time_for(double deficit, uint64_t rate) {
+    return std::chrono::duration_cast<Clock::duration>(
+               std::chrono::duration<double>(deficit / static_cast<double>(rate))) +
+           std::chrono::microseconds(1);
+}
+
+} // namespace
+
+namespace persistency {
+
+struct IoScheduler::Queue {
+    std::string name;
+    IoClassOptions opts;
+    double tokens{0};
+    Clock::time_point refilled{};
+    uint64_t blocked_pass{0};   // an earlier request of this storage waits
+    QueueStats stats;
+};
+
+struct IoScheduler::Waiter {
+    Queue* queue;
+    uint64_t bytes;
+    Clock::time_point arrived;
+    Clock::time_point deadline;
+    bool granted{false};
+    std::function<void()> go;   // AdmitAsync; the waiter is then owned by waiting_
+};
+
+IoScheduler& IoScheduler::Instance() {
+    static IoScheduler scheduler;
+    return scheduler;
+}
+
+IoScheduler::~IoScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    thread_cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+
+    // Shutting down: whatever still waits goes now
+    std::unique_lock<std::mutex> lock(mtx_);
+    for (auto& [key, w] : waiting_) {
+        if (w->go) {
+            ready_.push_back(std::move(w->go));
+            delete w;
+        } else {
+            w->granted = true;
+        }
+    }
+    waiting_.clear();
+    granted_cv_.notify_all();
+    auto jobs = std::move(ready_);
+    lock.unlock();
+    for (auto& job : jobs) job();
+}
+
+void IoScheduler::Configure(const Options& opts) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    opts_ = opts;
+    device_refilled_ = {};   // refill to the new burst
+    Dispatch_(Clock::now());
+    if (!ready_.empty() && !running_ready_) Wake_();
+}
+
+IoScheduler::QueueHandle IoScheduler::Register(const std::string& storage, const IoClassOptions& opts) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = queues_.find(storage);
+    if (it == queues_.end()) {
+        auto q = std::make_shared<Queue>();
+        q->name = storage;
+        it = queues_.emplace(storage, std::move(q)).first;
+    }
+    it->second->opts = opts;
+    return it->second;
+}
+
+void IoScheduler::Enqueue_(Waiter* w) {
+    const int prio = static_cast<int>(w->queue->opts.priority);
+    waiting_.emplace(WaitKey{w->deadline, prio, ++arrivals_}, w);
+    ++w->queue->stats.queued;
+}
+
+void IoScheduler::Admit(const QueueHandle& queue, uint64_t bytes) {
+    if (!queue) return;
+    std::unique_lock<std::mutex> lock(mtx_);
+    const auto now = Clock::now();
+    Waiter w{queue.get(), bytes, now, now + deadline_of(queue->opts), false, {}};
+    Enqueue_(&w);
+    Dispatch_(now);
+    if (!ready_.empty() && !running_ready_) Wake_();
+    granted_cv_.wait(lock, [&w] { return w.granted; });
+}
+
+void IoScheduler::AdmitAsync(const QueueHandle& queue, uint64_t bytes, std::function<void()> go) {
+    if (!queue) {
+        go();
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mtx_);
+    const auto now = Clock::now();
+    Enqueue_(new Waiter{queue.get(), bytes, now, now + deadline_of(queue->opts), false, std::move(go)});
+    Dispatch_(now);
+    // Whoever drains ready_ runs it in admission order
+    if (!running_ready_) DrainReady_(lock);
+}
+
+std::optional<IoScheduler::QueueStats> IoScheduler::GetStats(std::string_view storage) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = queues_.find(storage);
+    if (it == queues_.end()) return std::nullopt;
+    return it->second->stats;
+}
+
+// Admits, in deadline order, every waiter whose buckets allow it and sets
+// retry_at_ to when the first of the others may go
+void IoScheduler::Dispatch_(Clock::time_point now) {
+    retry_at_ = Clock::time_point::max();
+    if (waiting_.empty()) return;
+
+    const uint64_t pass = ++pass_;
+    const uint64_t dev_rate = opts_.device_bytes_per_sec;
+    const double dev_burst = burst_of(dev_rate, opts_.device_burst_bytes);
+    if (dev_rate) refill(device_tokens_, device_refilled_, now, dev_rate, dev_burst);
+    bool device_blocked = false;   // the device's tokens are promised to an earlier deadline
+    bool woke = false;
+
+    for (auto it = waiting_.begin(); it != waiting_.end();) {
+        Waiter* w = it->second;
+        Queue& q = *w->queue;
+        const IoPriority prio = q.opts.priority;
+        if (q.blocked_pass == pass || (device_blocked && prio != IoPriority::Critical)) {
+            q.blocked_pass = pass;
+            ++it;
+            continue;
+        }
+
+        Clock::time_point ready = now;
+        if (q.opts.bytes_per_sec) {
+            // A request larger than the burst waits for a full bucket and
+            // leaves it in debt
+            const double burst = burst_of(q.opts.bytes_per_sec, q.opts.burst_bytes);
+            refill(q.tokens, q.refilled, now, q.opts.bytes_per_sec, burst);
+            const double need = std::min(static_cast<double>(w->bytes), burst);
+            if (q.tokens < need) ready = now + time_for(need - q.tokens, q.opts.bytes_per_sec);
+        }
+        if (dev_rate && prio != IoPriority::Critical) {
+            const double reserve = prio == IoPriority::Bulk ? dev_burst / 4 : 0;
+            const double need = std::min(static_cast<double>(w->bytes), dev_burst - reserve);
+            if (device_tokens_ < need) device_blocked = true;
+            if (device_tokens_ < need + reserve) {
+                ready = std::max(ready, now + time_for(need + reserve - device_tokens_, dev_rate));
+            }
+        }
+        if (ready > now) {
+            q.blocked_pass = pass;
+            retry_at_ = std::min(retry_at_, ready);
+            ++it;
+            continue;
+        }
+
+        if (q.opts.bytes_per_sec) q.tokens -= static_cast<double>(w->bytes);
+        if (dev_rate) device_tokens_ -= static_cast<double>(w->bytes);
+        QueueStats& s = q.stats;
+        const auto delay = std::chrono::duration_cast<std::chrono::microseconds>(now - w->arrived);
+        ++s.requests;
+        s.bytes += w->bytes;
+        --s.queued;
+        if (now > w->arrived) ++s.delayed;
+        if (now > w->deadline) ++s.deadline_misses;
+        s.total_delay += delay;
+        s.max_delay = std::max(s.max_delay, delay);
+
+        it = waiting_.erase(it);
+        if (w->go) {
+            ready_.push_back(std::move(w->go));
+            delete w;
+        } else {
+            w->granted = true;
+            woke = true;
+        }
+    }
+    if (woke) granted_cv_.notify_all();
+    if (retry_at_ != Clock::time_point::max()) Wake_();
+}
+
+void IoScheduler::DrainReady_(std::unique_lock<std::mutex>& lock) {
+    running_ready_ = true;
+    while (!ready_.empty()) {
+        auto jobs = std::move(ready_);
+        ready_.clear();
+        lock.unlock();
+        for (auto& job : jobs) job();
+        lock.lock();
+    }
+    running_ready_ = false;
+}
+
+void IoScheduler::Wake_() {
+    if (!thread_.joinable()) thread_ = std::thread([this] { Loop_(); });
+    thread_cv_.notify_one();
+}
+
+void IoScheduler::Loop_() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!stop_) {
+        if (!ready_.empty() && !running_ready_) {
+            DrainReady_(lock);
+        } else if (retry_at_ == Clock::time_point::max()) {
+            thread_cv_.wait(lock);
+        } else if (thread_cv_.wait_until(lock, retry_at_) == std::cv_status::timeout) {
+            Dispatch_(Clock::now());
+        }
+    }
+}
+
+} // namespace persistency
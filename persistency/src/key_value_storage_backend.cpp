@@ -1,6 +1,9 @@
 #include <persistency/key_value_storage_backend.hpp>
+#include <persistency/crc32c.hpp>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <map>
 #include <system_error>
 #include <iostream>
 
@@ -41,100 +44,379 @@ inline void fsync_dir_by_path(const std::string& dir) {
 }
 
 // Minimal guard against path traversal in keys. Adjust as needed.
-inline bool key_is_safe(const std::string& key) {
+inline bool key_is_safe(std::string_view key) {
     return !key.empty()
         && key.find('/') == std::string::npos
         && key.find('\\') == std::string::npos
-        && key.find("..") == std::string::npos;
+        && key.find("..") == std::string::npos
+        && key != ".batch";   // reserved for ApplyBatch staging
+}
+
+// Batches are staged in <base>/.batch: one file per new value under
+// values/ (so no key can collide with the journal) plus a CRC-protected
+// journal naming every op. The journal reaching disk is the commit point;
+// after that the batch is redone from it, even after a crash.
+constexpr const char* kBatchDir = ".batch";
+constexpr const char* kStaged   = "values";
+constexpr const char* kJournal  = "journal";
+constexpr char kJournalMagic[4] = {'K', 'V', 'J', '1'};
+
+std::string encode_journal(const std::map<std::string, const persistency::BatchOp*>& ops) {
+    std::string j(kJournalMagic, sizeof(kJournalMagic));
+    const uint32_t n = static_cast<uint32_t>(ops.size());
+    j.append(reinterpret_cast<const char*>(&n), sizeof(n));
+    for (const auto& [key, op] : ops) {
+        j.push_back(op->value ? 1 : 2);
+        const uint16_t klen = static_cast<uint16_t>(key.size());
+        j.append(reinterpret_cast<const char*>(&klen), sizeof(klen));
+        j += key;
+    }
+    const uint32_t crc = persistency::Crc32c(j.data(), j.size());
+    j.append(reinterpret_cast<const char*>(&crc), sizeof(crc));
+    return j;
+}
+
+// (is_set, key) pairs; false if the journal is torn or absent
+bool decode_journal(const std::string& j, std::vector<std::pair<bool, std::string>>& out) {
+    if (j.size() < 12 || std::memcmp(j.data(), kJournalMagic, 4) != 0) return false;
+    uint32_t crc = 0;
+    std::memcpy(&crc, j.data() + j.size() - 4, 4);
+    if (crc != persistency::Crc32c(j.data(), j.size() - 4)) return false;
+    uint32_t n = 0;
+    std::memcpy(&n, j.data() + 4, 4);
+    size_t p = 8;
+    for (uint32_t i = 0; i < n; ++i) {
+        if (p + 3 > j.size() - 4) return false;
+        const bool is_set = j[p] == 1;
+        uint16_t klen = 0;
+        std::memcpy(&klen, j.data() + p + 1, 2);
+        p += 3;
+        if (p + klen > j.size() - 4) return false;
+        out.emplace_back(is_set, j.substr(p, klen));
+        p += klen;
+    }
+    return true;
+}
+
+// The bytes to store for value: value itself, or its container in packed
+std::string_view encode_value(std::string_view value, const persistency::CompressionOptions& opts,
+                              std::vector<uint8_t>& packed) {
+    const auto* p = reinterpret_cast<const uint8_t*>(value.data());
+    if (!persistency::Compress(ara::core::Span<const uint8_t>(p, value.size()), opts, packed)) return value;
+    return std::string_view(reinterpret_cast<const char*>(packed.data()), packed.size());
+}
+
+// A stored value back to what was set
+ara::core::Result<std::string> decode_value(std::string stored) {
+    const auto* p = reinterpret_cast<const uint8_t*>(stored.data());
+    const auto raw_size = persistency::CompressedRawSize(p, stored.size());
+    if (!raw_size) return stored;
+    std::string value(static_cast<size_t>(*raw_size), '\0');
+    auto r = persistency::Decompress(ara::core::Span<const uint8_t>(p, stored.size()),
+                                     reinterpret_cast<uint8_t*>(value.data()), value.size());
+    if (!r.HasValue()) return r.Error();
+    return value;
 }
 
 } // namespace
 
 namespace persistency {
 
-KeyValueStorageBackend::KeyValueStorageBackend(const std::string& base_path, size_t quota)
-: base_path_(base_path), quota_(quota) {
+KeyValueStorageBackend::KeyValueStorageBackend(const std::string& base_path, size_t quota,
+                                               IoScheduler::QueueHandle io, CompressionOptions compression)
+: base_path_(base_path), quota_(quota), io_(std::move(io)), compression_(compression) {
     fs::create_directories(base_path_);
+    std::unique_lock<RwLock> lock(mtx_);
+    (void)FinishBatch(base_path_);   // if not, retried at the next open
+    LoadIndexNoLock_();
+}
+
+// Redo a committed batch (journal intact) or drop an uncommitted one.
+bool KeyValueStorageBackend::FinishBatch(const std::string& base_path) noexcept {
+    const fs::path dir = fs::path(base_path) / kBatchDir;
+    std::error_code ec;
+    if (!fs::exists(dir, ec)) return true;
+
+    std::ifstream ifs(dir / kJournal, std::ios::binary);
+    std::string j((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    std::vector<std::pair<bool, std::string>> ops;
+    if (ifs.is_open() && decode_journal(j, ops)) {
+        for (const auto& [is_set, key] : ops) {
+            const fs::path final = fs::path(base_path) / key;
+            if (is_set) {
+                const fs::path staged = dir / kStaged / key;
+                if (fs::exists(staged, ec)) fs::rename(staged, final, ec);
+            } else {
+                fs::remove(final, ec);
+            }
+            MappingCache::Instance().Invalidate(final.string());
+            if (ec) {
+                // Committed: dropping the batch now would lose its values
+                std::cerr << "[per] cannot finish the batch in " << dir.string() << " (" << key << ": "
+                          << ec.message() << "); kept for the next open\n";
+                fsync_dir_by_path(base_path);
+                return false;
+            }
+        }
+        fsync_dir_by_path(base_path);
+    }
+    fs::remove_all(dir, ec);
+    return true;
 }
 
 ara::core::Result<void>
-KeyValueStorageBackend::SetValue(const std::string& key, const std::string& value) noexcept {
-    std::lock_guard<std::mutex> lock(mtx_);
+KeyValueStorageBackend::ApplyBatch(const std::vector<BatchOp>& ops) noexcept {
+    // Last op per key wins; keeps redo idempotent
+    std::map<std::string, const BatchOp*> last;
+    for (const auto& op : ops) {
+        if (!key_is_safe(op.key)) {
+            return ara::core::ErrorCode(ara::core::PersistencyErrc::kPermissionDenied);
+        }
+        last[op.key] = &op;
+    }
+    if (last.empty()) return {};
+
+    // Stored form of every value set, encoded before taking the stripes
+    std::map<std::string_view, std::string_view> stored;
+    std::vector<std::vector<uint8_t>> packed(last.size());
+    size_t n = 0;
+    for (const auto& [key, op] : last) {
+        if (op->value) stored[key] = encode_value(*op->value, compression_, packed[n++]);
+    }
 
+    // With every write stripe held nobody else mutates the index, so it can
+    // be read without mtx_; readers are only blocked while publishing.
+    std::lock_guard<LockStripes<>> writers(write_locks_);
+
+    size_t new_used = used_bytes_;
+    for (const auto& [key, op] : last) {
+        auto it = index_.find(key);
+        if (it != index_.end()) new_used -= it->second;
+        if (op->value) new_used += stored[key].size();
+    }
+    if (new_used > quota_) {
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kQuotaExceeded);
+    }
+    uint64_t bytes = 0;
+    for (const auto& [key, value] : stored) bytes += value.size();
+    IoScheduler::Instance().Admit(io_, bytes);
+
+    const fs::path dir = fs::path(base_path_) / kBatchDir;
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir / kStaged, ec);
+    if (ec) return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+    auto abort = [&] {
+        std::error_code ec2;
+        fs::remove_all(dir, ec2);
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+    };
+
+    for (const auto& [key, value] : stored) {
+        const fs::path staged = dir / kStaged / key;
+        std::ofstream ofs(staged, std::ios::binary | std::ios::trunc);
+        ofs.write(value.data(), static_cast<std::streamsize>(value.size()));
+        ofs.close();
+        if (!ofs) return abort();
+        fsync_file_by_path(staged.string());
+    }
+    fsync_dir_by_path((dir / kStaged).string());
+    {
+        const std::string j = encode_journal(last);
+        std::ofstream ofs(dir / kJournal, std::ios::binary | std::ios::trunc);
+        ofs.write(j.data(), static_cast<std::streamsize>(j.size()));
+        ofs.close();
+        if (!ofs) return abort();
+        fsync_file_by_path((dir / kJournal).string());
+        fsync_dir_by_path(dir.string());   // commit point
+    }
+
+    if (!FinishBatch(base_path_)) {
+        // Partly applied; index what is on disk now
+        std::unique_lock<RwLock> lock(mtx_);
+        LoadIndexNoLock_();
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+    }
+
+    std::unique_lock<RwLock> lock(mtx_);
+    for (const auto& [key, op] : last) {
+        if (op->value) index_[key] = stored[key].size();
+        else index_.erase(key);
+    }
+    used_bytes_ = new_used;
+    return {};
+}
+
+bool KeyValueStorageBackend::ValidKey(std::string_view key) const noexcept {
+    return key_is_safe(key);
+}
+
+ara::core::Result<size_t> KeyValueStorageBackend::ValueSize(std::string_view key) const noexcept {
+    std::shared_lock<RwLock> lock(mtx_);
+    auto it = index_.find(key);
+    if (it == index_.end()) return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
+    return it->second;
+}
+
+void KeyValueStorageBackend::LoadIndexNoLock_() noexcept {
+    index_.clear();
+    used_bytes_ = 0;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(base_path_, ec)) {
+        if (ec) break;
+        if (!entry.is_regular_file(ec)) continue;
+        const size_t sz = static_cast<size_t>(entry.file_size(ec));
+        if (ec) { ec.clear(); continue; }
+        index_.emplace(entry.path().filename().string(), sz);
+        used_bytes_ += sz;
+    }
+}
+
+ara::core::Result<void>
+KeyValueStorageBackend::SetValue(std::string_view key, std::string_view value) noexcept {
     // Key safety check like in GetValue
     if (!key_is_safe(key)) {
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kPermissionDenied);
     }
+    std::vector<uint8_t> packed;
+    const std::string_view stored = encode_value(value, compression_, packed);
+    std::lock_guard<std::mutex> key_lock(write_locks_.For(key));
 
-    fs::create_directories(base_path_);
+    // Reserve any growth up front so concurrent writers of other keys can't
+    // overshoot the quota together; the key's own size is stable under key_lock
+    size_t old_size = 0;
+    {
+        std::unique_lock<RwLock> lock(mtx_);
+        auto it = index_.find(key);
+        old_size = it != index_.end() ? it->second : 0;
+        if (used_bytes_ - old_size + stored.size() > quota_) {
+            return ara::core::ErrorCode(ara::core::PersistencyErrc::kQuotaExceeded);
+        }
+        if (stored.size() > old_size) used_bytes_ += stored.size() - old_size;
+    }
+    auto unreserve = [&] {
+        std::unique_lock<RwLock> lock(mtx_);
+        if (stored.size() > old_size) used_bytes_ -= stored.size() - old_size;
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+    };
+    IoScheduler::Instance().Admit(io_, stored.size());
 
     fs::path final = fs::path(base_path_) / key;
     fs::path tmp   = final; tmp += ".tmp";
 
-    // Quota check WITHOUT re-locking
     std::error_code ec;
-    size_t current  = GetUsedSpaceNoLock_();
-    size_t old_size = fs::exists(final, ec) ? static_cast<size_t>(fs::file_size(final, ec)) : 0;
-    size_t new_size = current - old_size + value.size();
-    if (new_size > quota_) {
-        return ara::core::ErrorCode(ara::core::PersistencyErrc::kQuotaExceeded);
-    }
-
     std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
-    if (!ofs) return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
-    ofs.write(value.data(), static_cast<std::streamsize>(value.size()));
-    if (!ofs) return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+    if (!ofs) return unreserve();
+    ofs.write(stored.data(), static_cast<std::streamsize>(stored.size()));
     ofs.close();
+    if (!ofs) { std::error_code ec2; fs::remove(tmp, ec2); return unreserve(); }
 
     fs::rename(tmp, final, ec);
-    if (ec) { std::error_code ec2; fs::remove(tmp, ec2); return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown); }
+    if (ec) { std::error_code ec2; fs::remove(tmp, ec2); return unreserve(); }
+    MappingCache::Instance().Invalidate(final.string());
+
+    std::unique_lock<RwLock> lock(mtx_);
+    index_[std::string(key)] = stored.size();
+    if (stored.size() < old_size) used_bytes_ -= old_size - stored.size();
     return {};
 }
 
-ara::core::Result<std::string> KeyValueStorageBackend::GetValue(const std::string& key) const noexcept {
-    std::lock_guard<std::mutex> lock(mtx_);
+ara::core::Result<std::string> KeyValueStorageBackend::GetValue(std::string_view key) const noexcept {
     if (!key_is_safe(key)) {
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kPermissionDenied);
     }
+    {
+        std::shared_lock<RwLock> lock(mtx_);
+        if (index_.find(key) == index_.end()) {
+            return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
+        }
+    }
+    // No lock needed: writers replace the file by rename
     fs::path file = fs::path(base_path_) / key;
-    std::ifstream ifs(file, std::ios::binary);
+    std::ifstream ifs(file, std::ios::binary | std::ios::ate);
     if (!ifs) return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
-    std::string value((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
-    return value;
+    std::string value(static_cast<size_t>(ifs.tellg()), '\0');
+    ifs.seekg(0);
+    ifs.read(value.data(), static_cast<std::streamsize>(value.size()));
+    if (!ifs) return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+    return decode_value(std::move(value));
 }
 
-ara::core::Result<std::vector<std::string>> KeyValueStorageBackend::GetAllKeys() const noexcept {
-    std::lock_guard<std::mutex> lock(mtx_);
-    std::vector<std::string> keys;
-    std::error_code ec;
-    for (const auto& entry : fs::directory_iterator(base_path_, ec)) {
-        if (ec) break; // minimal handling
-        if (entry.is_regular_file()) {
-            keys.push_back(entry.path().filename().string());
+// Hot values are served from the shared mapping cache: no syscall, no copy.
+// Compressed ones are decoded into a private buffer.
+ara::core::Result<MappedView> KeyValueStorageBackend::GetValueView(std::string_view key) const noexcept {
+    if (!key_is_safe(key)) {
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kPermissionDenied);
+    }
+    {
+        std::shared_lock<RwLock> lock(mtx_);
+        if (index_.find(key) == index_.end()) {
+            return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
         }
     }
+    auto view = MappingCache::Instance().Get((fs::path(base_path_) / key).string());
+    if (!view.HasValue()) return view;
+    const auto& v = view.Value();
+    if (!CompressedRawSize(v.data(), v.size())) return view;
+    auto value = decode_value(std::string(reinterpret_cast<const char*>(v.data()), v.size()));
+    if (!value.HasValue()) return value.Error();
+    return MappedView::FromString(std::move(value).Value());
+}
+
+ara::core::Result<std::vector<std::string>> KeyValueStorageBackend::GetAllKeys() const noexcept {
+    std::shared_lock<RwLock> lock(mtx_);
+    std::vector<std::string> keys;
+    keys.reserve(index_.size());
+    for (const auto& kv : index_) keys.push_back(kv.first);
     return keys;
 }
 
-ara::core::Result<bool> KeyValueStorageBackend::HasKey(const std::string& key) const noexcept {
-    std::lock_guard<std::mutex> lock(mtx_);
+ara::core::Result<void> KeyValueStorageBackend::VisitKeys(std::string_view prefix, std::string_view after,
+                                                   const KeyVisitor& fn) const noexcept {
+    std::shared_lock<RwLock> lock(mtx_);
+    VisitOrderedKeys(index_, prefix, after, fn);
+    return {};
+}
+
+ara::core::Result<size_t> KeyValueStorageBackend::CountKeys(std::string_view prefix) const noexcept {
+    std::shared_lock<RwLock> lock(mtx_);
+    if (prefix.empty()) return index_.size();
+    size_t n = 0;
+    VisitOrderedKeys(index_, prefix, {}, [&n](std::string_view) { ++n; return true; });
+    return n;
+}
+
+ara::core::Result<bool> KeyValueStorageBackend::HasKey(std::string_view key) const noexcept {
     if (!key_is_safe(key)) {
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kPermissionDenied);
     }
-    fs::path file = fs::path(base_path_) / key;
-    return fs::exists(file);
+    std::shared_lock<RwLock> lock(mtx_);
+    return index_.count(key) != 0;
 }
 
-ara::core::Result<void> KeyValueStorageBackend::RemoveKey(const std::string& key) noexcept {
-    std::lock_guard<std::mutex> lock(mtx_);
+ara::core::Result<void> KeyValueStorageBackend::RemoveKey(std::string_view key) noexcept {
     if (!key_is_safe(key)) {
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kPermissionDenied);
     }
-    fs::path file = fs::path(base_path_) / key;
-    std::error_code ec;
-    bool ok = fs::remove(file, ec);
-    if (!ok || ec) {
-        return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
+    {
+        std::lock_guard<std::mutex> key_lock(write_locks_.For(key));
+        {
+            std::shared_lock<RwLock> lock(mtx_);
+            if (index_.find(key) == index_.end()) {
+                return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
+            }
+        }
+        fs::path file = fs::path(base_path_) / key;
+        std::error_code ec;
+        fs::remove(file, ec);
+        if (ec) {
+            return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+        }
+        MappingCache::Instance().Invalidate(file.string());
+        std::unique_lock<RwLock> lock(mtx_);
+        auto it = index_.find(key);
+        used_bytes_ -= it->second;
+        index_.erase(it);
     }
 #if defined(__unix__) || defined(__APPLE__)
     fsync_dir_by_path(fs::path(base_path_).string());
@@ -153,20 +435,11 @@ ara::core::Result<void> KeyValueStorageBackend::DiscardPendingChanges() const no
 }
 
 size_t KeyValueStorageBackend::GetUsedSpaceNoLock_() const noexcept {
-    size_t total = 0;
-    std::error_code ec;
-    for (const auto& entry : fs::directory_iterator(base_path_, ec)) {
-        if (ec) break;
-        if (entry.is_regular_file(ec)) {
-            total += static_cast<size_t>(entry.file_size(ec));
-            if (ec) ec.clear();
-        }
-    }
-    return total;
+    return used_bytes_;
 }
 
 size_t KeyValueStorageBackend::GetUsedSpace() const {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::shared_lock<RwLock> lock(mtx_);
     return GetUsedSpaceNoLock_();
 }
 
@@ -1,10 +1,37 @@
 #include <ara/per/key_value_storage.hpp>
 #include <persistency/key_value_storage_backend.hpp>
+#include <persistency/log_structured_backend.hpp>
+#include <persistency/staged_backend.hpp>
 #include <persistency/storage_registry.hpp>
 #include <memory>
 #include <filesystem>
 #include <iostream>
 
+namespace {
+
+// The engine alone, without the write-back layer. `scrub` makes a log
+// engine compare its A/B copies while opening.
+std::shared_ptr<::persistency::IKeyValueBackend>
+open_engine(const std::string& instance, const ::persistency::StorageConfig& cfg, bool scrub) {
+    auto io = ::persistency::IoScheduler::Instance().Register(instance, cfg.io);
+    if (cfg.engine == ::persistency::KvEngine::Log) {
+        ::persistency::LogStructuredBackend::Options opts;
+        opts.segment_bytes        = cfg.segment_bytes;
+        opts.compaction_threshold = cfg.compaction_threshold;
+        opts.durability           = cfg.durability;
+        opts.mirror               = cfg.redundant;
+        opts.mirror_path          = cfg.mirror_path;
+        opts.scrub_on_open        = scrub;
+        opts.io                   = std::move(io);
+        return std::make_shared<::persistency::LogStructuredBackend>(cfg.base_path, cfg.quota_bytes, opts);
+    }
+    // Finishes or drops an interrupted batch and rebuilds the index on open
+    return std::make_shared<::persistency::KeyValueStorageBackend>(cfg.base_path, cfg.quota_bytes, std::move(io),
+                                                                   cfg.compression);
+}
+
+} // namespace
+
 namespace ara::per {
 
 ara::core::Result<SharedHandle>
@@ -15,15 +42,43 @@ OpenKeyValueStorage(ara::core::InstanceSpecifier kvs) noexcept {
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
     }
 
-    auto cfg = reg.Lookup(kvs.ToString());
-    if (!cfg || cfg->type != ::persistency::StorageType::Kv) {
+    const auto [spec, lock] = reg.FindLocked(kvs.ToString());
+    if (!spec || spec->config.type != ::persistency::StorageType::Kv) {
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
     }
+    const auto& cfg = spec->config;
 
-    auto backend = std::make_shared<::persistency::KeyValueStorageBackend>(
-        cfg->base_path, cfg->quota_bytes
-    );
-    return std::make_shared<KeyValueStorage>(backend);
+    // Re-opens share the open storage and its index
+    if (auto open = spec->open_handle.lock()) return std::static_pointer_cast<KeyValueStorage>(open);
+
+    // A fresh open replays and repairs; recover_on_start also scrubs the copies
+    std::shared_ptr<::persistency::IKeyValueBackend> backend = open_engine(spec->instance, cfg, cfg.recover_on_start);
+    if (cfg.write_mode == ::persistency::WriteMode::WriteBack) {
+        backend = std::make_shared<::persistency::StagedKeyValueBackend>(std::move(backend));
+    }
+    auto handle = std::make_shared<KeyValueStorage>(backend, cfg.value_encoding);
+    spec->open_handle = handle;
+    return handle;
+}
+
+// Runs the full open-time recovery, including the A/B scrub, then closes
+// the storage again. A second engine on an open storage would corrupt it.
+ara::core::Result<void>
+RecoverKeyValueStorage(ara::core::InstanceSpecifier kvs) noexcept {
+    auto& reg = ::persistency::StorageRegistry::Instance();
+    if (!reg.IsInitialized()) {
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
+    }
+    const auto [spec, lock] = reg.FindLocked(kvs.ToString());
+    if (!spec || spec->config.type != ::persistency::StorageType::Kv) {
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
+    }
+    if (!spec->open_handle.expired()) {
+        return ara::core::ErrorCode(ara::core::PersistencyErrc::kResourceBusy);
+    }
+    auto engine = open_engine(spec->instance, spec->config, true);
+    // Fails if the engine could not open what it found
+    return engine->SyncToStorage();
 }
 
 ara::core::Result<void>
@@ -34,18 +89,38 @@ ResetKeyValueStorage(ara::core::InstanceSpecifier kvs) noexcept {
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kUnknown);
     }
 
-    auto cfg = reg.Lookup(kvs.ToString());
-    if (!cfg || cfg->type != ::persistency::StorageType::Kv) {
+    const auto [spec, lock] = reg.FindLocked(kvs.ToString());
+    if (!spec || spec->config.type != ::persistency::StorageType::Kv) {
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
     }
+    const auto& cfg = spec->config;
+
+    // Deleting files under an open engine would leave its index stale
+    if (auto open = spec->open_handle.lock()) {
+        auto kv = std::static_pointer_cast<KeyValueStorage>(open);
+        (void)kv->DiscardPendingChanges();
+        auto r = kv->RemoveAllKeys();
+        if (!r.HasValue()) return r;
+        return kv->SyncToStorage();
+    }
 
     std::error_code ec;
-    fs::path base = cfg->base_path;
+    fs::path base = cfg.base_path;
     if (!fs::exists(base, ec)) return {};
     for (const auto& entry : fs::directory_iterator(base, ec)) {
         if (ec) break;
         if (entry.is_regular_file()) fs::remove(entry, ec);
     }
+    // A batch journal left by a crash would redo its values on the next open
+    fs::remove_all(base / ".batch", ec);
+    // The B copies too, or the next open would restore from them
+    if (!cfg.mirror_path.empty() && fs::exists(cfg.mirror_path, ec)) {
+        for (const auto& entry : fs::directory_iterator(cfg.mirror_path, ec)) {
+            if (ec) break;
+            if (entry.is_regular_file()) fs::remove(entry, ec);
+        }
+    }
+    ::persistency::MappingCache::Instance().InvalidatePrefix(base.string());
     return {};
 }
 
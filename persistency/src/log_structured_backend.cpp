@@ -0,0 +1,1097 @@
+#include <persistency/log_structured_backend.hpp>
+#include <persistency/compression.hpp>
+#include <persistency/crc32c.hpp>
+#include <persistency/key_value_storage_backend.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <iostream>
+#include <unordered_map>
+
+#include <unistd.h>     // pread, write, fdatasync, ftruncate, close
+#include <fcntl.h>      // open
+#include <sys/mman.h>   // mmap for the recovery scan
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+using ara::core::ErrorCode;
+using ara::core::PersistencyErrc;
+
+namespace {
+
+constexpr char     kMagic[4]     = {'K', 'V', 'L', 'G'};
+constexpr uint16_t kVersion      = 1;
+constexpr size_t   kRecHdr       = 20;   // crc seq value_len key_len type pad
+constexpr uint8_t  kPut          = 1;
+constexpr uint8_t  kDelete       = 2;
+constexpr uint8_t  kBatch        = 3;   // no key; value is a run of put/delete frames
+constexpr size_t   kMaxKey       = 0xFFFF;
+constexpr size_t   kMaxValue     = 0xFFFFFFFFu - kRecHdr - kMaxKey;
+// Present while files of the "file" engine are being imported; ".." can't
+// occur in a key of that engine
+constexpr const char* kImportMarker = "..import";
+
+template <typename T>
+inline void put_le(std::string& out, T v) {
+    char b[sizeof(T)];
+    std::memcpy(b, &v, sizeof(T));       // host order is little-endian on our targets
+    out.append(b, sizeof(T));
+}
+
+template <typename T>
+inline T get_le(const char* p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+inline uint64_t file_size(int fd) {
+    struct stat st{};
+    return ::fstat(fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+}
+
+inline void fsync_dir_by_path(const std::string& dir) {
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) { ::fsync(fd); ::close(fd); }
+}
+
+// fdatasync + close of a dup'ed fd, called without mtx_ held
+inline bool sync_and_close(int fd) {
+    const bool ok = ::fdatasync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+inline bool write_all(int fd, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0) { if (errno == EINTR) continue; return false; }
+        p += w; n -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+inline bool pread_all(int fd, char* p, size_t n, uint64_t off) {
+    while (n > 0) {
+        ssize_t r = ::pread(fd, p, n, static_cast<off_t>(off));
+        if (r < 0) { if (errno == EINTR) continue; return false; }
+        if (r == 0) return false;
+        p += r; n -= static_cast<size_t>(r); off += static_cast<uint64_t>(r);
+    }
+    return true;
+}
+
+std::string make_header(uint32_t id, const std::vector<uint32_t>& replaced) {
+    std::string h(kMagic, sizeof(kMagic));
+    put_le<uint16_t>(h, kVersion);
+    put_le<uint16_t>(h, 0);
+    put_le<uint32_t>(h, id);
+    put_le<uint32_t>(h, static_cast<uint32_t>(replaced.size()));
+    for (uint32_t r : replaced) put_le<uint32_t>(h, r);
+    put_le<uint32_t>(h, persistency::Crc32c(h.data(), h.size()));
+    return h;
+}
+
+// Parses a segment header from `fd`; returns its length or 0 if invalid.
+size_t read_header(int fd, uint32_t& id, std::vector<uint32_t>& replaced) {
+    char fixed[16];
+    if (!pread_all(fd, fixed, sizeof(fixed), 0)) return 0;
+    if (std::memcmp(fixed, kMagic, sizeof(kMagic)) != 0) return 0;
+    if (get_le<uint16_t>(fixed + 4) != kVersion) return 0;
+    id = get_le<uint32_t>(fixed + 8);
+    const uint32_t n = get_le<uint32_t>(fixed + 12);
+    if (n > 1u << 20) return 0;
+    std::string h(fixed, sizeof(fixed));
+    h.resize(sizeof(fixed) + n * 4u + 4u);
+    if (!pread_all(fd, &h[sizeof(fixed)], n * 4u + 4u, sizeof(fixed))) return 0;
+    const size_t body = h.size() - 4;
+    if (get_le<uint32_t>(&h[body]) != persistency::Crc32c(h.data(), body)) return 0;
+    replaced.clear();
+    for (uint32_t i = 0; i < n; ++i) replaced.push_back(get_le<uint32_t>(&h[sizeof(fixed) + i * 4u]));
+    return h.size();
+}
+
+std::string make_record(uint8_t type, uint64_t seq, std::string_view key, std::string_view value) {
+    std::string r;
+    r.reserve(kRecHdr + key.size() + value.size());
+    put_le<uint32_t>(r, 0);   // crc, patched below
+    put_le<uint64_t>(r, seq);
+    put_le<uint32_t>(r, static_cast<uint32_t>(value.size()));
+    put_le<uint16_t>(r, static_cast<uint16_t>(key.size()));
+    r.push_back(static_cast<char>(type));
+    r.push_back('\0');
+    r += key;
+    r += value;
+    const uint32_t crc = persistency::Crc32c(r.data() + 4, r.size() - 4);
+    std::memcpy(&r[0], &crc, sizeof(crc));
+    return r;
+}
+
+struct RecordView {
+    uint64_t seq;
+    uint8_t  type;
+    std::string key;
+    uint32_t value_len;
+    uint32_t rec_len;
+};
+
+// Fills rv from a record header; false if it can't start a valid frame.
+// Returns the stored crc and the key length through the out parameters.
+bool decode_header(const char* hdr, RecordView& rv, uint32_t& crc, uint16_t& klen) {
+    crc          = get_le<uint32_t>(hdr);
+    rv.seq       = get_le<uint64_t>(hdr + 4);
+    rv.value_len = get_le<uint32_t>(hdr + 12);
+    klen         = get_le<uint16_t>(hdr + 16);
+    rv.type      = static_cast<uint8_t>(hdr[18]);
+    return rv.type == kBatch ? klen == 0 : ((rv.type == kPut || rv.type == kDelete) && klen != 0);
+}
+
+// Reads and verifies one record at `off`; false at EOF or on a bad frame.
+bool read_record(int fd, uint64_t off, uint64_t file_size, RecordView& rv, std::string* value = nullptr) {
+    if (off + kRecHdr > file_size) return false;
+    char hdr[kRecHdr];
+    if (!pread_all(fd, hdr, kRecHdr, off)) return false;
+    uint32_t crc = 0;
+    uint16_t klen = 0;
+    if (!decode_header(hdr, rv, crc, klen)) return false;
+    const uint64_t len = kRecHdr + uint64_t{klen} + rv.value_len;
+    if (off + len > file_size) return false;
+    std::string body(static_cast<size_t>(len - kRecHdr), '\0');
+    if (!body.empty() && !pread_all(fd, &body[0], body.size(), off + kRecHdr)) return false;
+    uint32_t c = persistency::Crc32c(hdr + 4, kRecHdr - 4);
+    c = persistency::Crc32c(body.data(), body.size(), c);
+    if (c != crc) return false;
+    rv.key.assign(body.data(), klen);
+    rv.rec_len = static_cast<uint32_t>(len);
+    if (value) value->assign(body.data() + klen, rv.value_len);
+    return true;
+}
+
+// read_record over a mapped segment, for the recovery scan
+bool parse_record(const char* data, uint64_t off, uint64_t end, RecordView& rv) {
+    if (off + kRecHdr > end) return false;
+    const char* hdr = data + off;
+    uint32_t crc = 0;
+    uint16_t klen = 0;
+    if (!decode_header(hdr, rv, crc, klen)) return false;
+    const uint64_t len = kRecHdr + uint64_t{klen} + rv.value_len;
+    if (off + len > end) return false;
+    if (persistency::Crc32c(hdr + 4, static_cast<size_t>(len - 4)) != crc) return false;
+    rv.key.assign(hdr + kRecHdr, klen);
+    rv.rec_len = static_cast<uint32_t>(len);
+    return true;
+}
+
+// Read-only mapping of a whole segment, read front to back once
+class FileMap {
+public:
+    FileMap(int fd, uint64_t size) : size_(static_cast<size_t>(size)) {
+        if (size_ == 0) return;
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) { failed_ = true; return; }
+        ::madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(p);
+    }
+    ~FileMap() {
+        if (data_) ::munmap(const_cast<char*>(data_), size_);
+    }
+    FileMap(const FileMap&) = delete;
+    FileMap& operator=(const FileMap&) = delete;
+
+    bool ok() const { return !failed_; }
+    const char* data() const { return data_; }
+
+private:
+    const char* data_{nullptr};
+    size_t size_{0};
+    bool failed_{false};
+};
+
+uint64_t first_mismatch(const char* a, const char* b, uint64_t n) {
+    constexpr uint64_t kBlock = 4096;
+    uint64_t i = 0;
+    for (; i < n; i += kBlock) {
+        if (std::memcmp(a + i, b + i, static_cast<size_t>(std::min(kBlock, n - i))) != 0) break;
+    }
+    while (i < n && a[i] == b[i]) ++i;
+    return std::min(i, n);
+}
+
+// Makes `to` hold from[0, end) given that it already holds from[0, off):
+// drops everything in `to` past off, then appends the rest (O_APPEND fds)
+bool copy_range(int from, int to, uint64_t off, uint64_t end) {
+    if (::ftruncate(to, static_cast<off_t>(off)) != 0) return false;
+    std::string buf;
+    while (off < end) {
+        buf.resize(static_cast<size_t>(std::min<uint64_t>(end - off, 1u << 20)));
+        if (!pread_all(from, &buf[0], buf.size(), off) || !write_all(to, buf.data(), buf.size())) {
+            return false;
+        }
+        off += buf.size();
+    }
+    return ::fdatasync(to) == 0;
+}
+
+// "seg-00000042.log" -> 42
+bool parse_segment_name(const std::string& name, uint32_t& id) {
+    if (name.size() != 16 || name.compare(0, 4, "seg-") != 0 || name.compare(12, 4, ".log") != 0)
+        return false;
+    id = 0;
+    for (size_t i = 4; i < 12; ++i) {
+        if (name[i] < '0' || name[i] > '9') return false;
+        id = id * 10 + static_cast<uint32_t>(name[i] - '0');
+    }
+    return true;
+}
+
+} // namespace
+
+namespace persistency {
+
+LogStructuredBackend::LogStructuredBackend(const std::string& base_path, size_t quota, Options opts)
+: base_path_(base_path), quota_(quota), opts_(std::move(opts)) {
+    std::error_code ec;
+    fs::create_directories(base_path_, ec);
+    if (opts_.mirror) {
+        mirror_dir_ = opts_.mirror_path.empty() ? (fs::path(base_path_) / ".mirror").string()
+                                                : opts_.mirror_path;
+        fs::create_directories(mirror_dir_, ec);
+    }
+    {
+        std::unique_lock<RwLock> lock(mtx_);
+        ok_ = OpenNoLock_();
+        if (!ok_) std::cerr << "[per] log engine: failed to open " << base_path_ << "\n";
+    }
+    compactor_ = std::thread([this] { CompactorLoop_(); });
+}
+
+LogStructuredBackend::~LogStructuredBackend() {
+    {
+        std::unique_lock<RwLock> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (compactor_.joinable()) compactor_.join();
+    for (auto& [id, seg] : segments_) {
+        (void)id;
+        CloseSegment_(seg);
+    }
+}
+
+std::string LogStructuredBackend::SegmentPath_(uint32_t id) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "seg-%08u.log", id);
+    return (fs::path(base_path_) / name).string();
+}
+
+std::string LogStructuredBackend::MirrorPath_(uint32_t id) const {
+    return (fs::path(mirror_dir_) / fs::path(SegmentPath_(id)).filename()).string();
+}
+
+void LogStructuredBackend::CloseSegment_(Segment& seg) noexcept {
+    if (seg.fd >= 0) ::close(seg.fd);
+    if (seg.mirror_fd >= 0) ::close(seg.mirror_fd);
+    seg.fd = seg.mirror_fd = -1;
+}
+
+bool LogStructuredBackend::OpenNoLock_() noexcept {
+    const auto t0 = std::chrono::steady_clock::now();
+    recovery_ = RecoveryStats{};
+    std::error_code ec;
+    // The file engine's last batch, if it left one, before its files are imported
+    if (!KeyValueStorageBackend::FinishBatch(base_path_)) return false;
+    std::vector<uint32_t> ids;
+    std::vector<std::string> legacy;
+    auto list = [&](const std::string& dir, bool is_mirror) {
+        for (const auto& entry : fs::directory_iterator(dir, ec)) {
+            if (ec) return false;
+            if (!entry.is_regular_file(ec)) continue;
+            const std::string name = entry.path().filename().string();
+            uint32_t id = 0;
+            if (parse_segment_name(name, id)) ids.push_back(id);
+            else if (name.size() == 20 && parse_segment_name(name.substr(0, 16), id) &&
+                     name.compare(16, 4, ".tmp") == 0) {
+                std::error_code ec2;
+                fs::remove(entry.path(), ec2);   // unfinished rollover/compaction
+            } else if (!is_mirror && name != kImportMarker) legacy.push_back(name);
+        }
+        return true;
+    };
+    if (!list(base_path_, false)) return false;
+    if (!mirror_dir_.empty() && !list(mirror_dir_, true)) return false;
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    // Headers first: a compacted segment supersedes the ones it lists
+    std::vector<uint32_t> superseded;
+    std::map<uint32_t, uint64_t> data_start;
+    for (uint32_t id : ids) {
+        size_t hlen = 0;
+        std::vector<uint32_t> replaced;
+        if (!OpenSegmentNoLock_(id, hlen, replaced)) continue;
+        superseded.insert(superseded.end(), replaced.begin(), replaced.end());
+        data_start[id] = hlen;
+        next_id_ = std::max(next_id_, id + 1);
+    }
+    for (uint32_t id : superseded) {
+        auto it = segments_.find(id);
+        if (it == segments_.end()) continue;
+        CloseSegment_(it->second);
+        segments_.erase(it);
+        data_start.erase(id);
+        std::error_code ec2;
+        fs::remove(SegmentPath_(id), ec2);
+        if (!mirror_dir_.empty()) fs::remove(MirrorPath_(id), ec2);
+    }
+
+    // Replay: highest seq per key wins; tombstones delete
+    struct Latest { Location loc; bool live; };
+    std::unordered_map<std::string, Latest> latest;
+    uint32_t cur = 0;
+    Segment* cur_seg = nullptr;
+    auto apply = [&](const RecordView& rv, uint64_t at) {
+        next_seq_ = std::max(next_seq_, rv.seq + 1);
+        cur_seg->min_seq = std::min(cur_seg->min_seq, rv.seq);
+        Location loc{cur, at, rv.rec_len, rv.value_len, rv.seq};
+        auto it = latest.find(rv.key);
+        if (it == latest.end()) {
+            latest.emplace(rv.key, Latest{loc, rv.type == kPut});
+        } else if (rv.seq >= it->second.loc.seq) {
+            it->second = Latest{loc, rv.type == kPut};
+        }
+    };
+    auto scan = [&](const char* data, uint64_t off, uint64_t end) {
+        RecordView rv;
+        while (parse_record(data, off, end, rv)) {
+            if (rv.type == kBatch) {
+                // The outer CRC already vouched for the whole batch
+                next_seq_ = std::max(next_seq_, rv.seq + 1);
+                const uint64_t batch_end = off + rv.rec_len;
+                RecordView sub;
+                for (uint64_t in = off + kRecHdr; in < batch_end && parse_record(data, in, batch_end, sub) &&
+                                                  sub.type != kBatch; in += sub.rec_len) {
+                    apply(sub, in);
+                    ++recovery_.records;
+                }
+            } else {
+                apply(rv, off);
+                ++recovery_.records;
+            }
+            off += rv.rec_len;
+        }
+        return off;
+    };
+    for (auto& [id, seg] : segments_) {
+        cur = id;
+        cur_seg = &seg;
+        if (!ReplaySegmentNoLock_(id, seg, data_start[id], scan)) return false;
+        seg.dead = seg.size - data_start[id];   // live records subtracted below
+        disk_bytes_ += seg.size;
+    }
+    for (auto& [key, l] : latest) {
+        if (!l.live) {
+            tombstones_.emplace(key, l.loc);
+            continue;
+        }
+        index_.emplace(key, l.loc);
+        segments_[l.loc.seg].dead -= l.loc.rec_len;
+        used_bytes_ += l.loc.value_len;
+    }
+    for (auto& [id, seg] : segments_) { (void)id; dead_bytes_ += seg.dead; }
+    recovery_.segments = static_cast<uint32_t>(segments_.size());
+    recovery_.duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t0);
+    if (recovery_.truncated_bytes != 0 || recovery_.repaired_bytes != 0) {
+        std::cerr << "[per] log engine: recovered " << base_path_ << " (" << recovery_.records
+                  << " records, " << recovery_.bytes_scanned << " bytes) in "
+                  << recovery_.duration.count() << " us; truncated " << recovery_.truncated_bytes
+                  << " bytes, repaired " << recovery_.repaired_bytes << " bytes from the other copy\n";
+    }
+
+    // Files of the "file" engine are imported into the first segment. The
+    // marker goes down before that segment, so an import cut short is
+    // finished at the next open instead of leaving the rest unseen.
+    const fs::path marker = fs::path(base_path_) / kImportMarker;
+    const bool import = !legacy.empty() && (ids.empty() || fs::exists(marker, ec));
+    if (import && !fs::exists(marker, ec)) {
+        std::ofstream(marker).close();
+        if (!fs::exists(marker, ec)) return false;
+        fsync_dir_by_path(base_path_);
+    } else if (legacy.empty()) {
+        fs::remove(marker, ec);   // the import was done but for this
+    }
+
+    // Appends go to a fresh segment. The newest one may be a compaction's
+    // output, holding records older than segments below it; left sealed,
+    // the next compaction rewrites it together with them. An empty newest
+    // segment holds nothing and is reused.
+    if (!segments_.empty() && segments_.rbegin()->second.min_seq == UINT64_MAX) {
+        active_id_ = segments_.rbegin()->first;
+    } else if (!RollNoLock_()) {
+        return false;
+    }
+
+    if (import) return ImportLegacyFilesNoLock_(legacy);
+    return true;
+}
+
+// Opens the copies of segment `id` and checks their headers. With a mirror,
+// a copy that is missing or has a bad header is rebuilt from the other one.
+// False (segment skipped) if no copy has a valid header.
+bool LogStructuredBackend::OpenSegmentNoLock_(uint32_t id, size_t& hlen,
+                                              std::vector<uint32_t>& replaced) noexcept {
+    constexpr int kFlags = O_RDWR | O_APPEND | O_CLOEXEC;
+    Segment seg;
+    uint32_t hdr_id = 0;
+    seg.fd = ::open(SegmentPath_(id).c_str(), kFlags);
+    hlen = seg.fd >= 0 ? read_header(seg.fd, hdr_id, replaced) : 0;
+    bool a_ok = hlen != 0 && hdr_id == id;
+
+    if (!mirror_dir_.empty()) {
+        seg.mirror_fd = ::open(MirrorPath_(id).c_str(), kFlags);
+        std::vector<uint32_t> b_replaced;
+        uint32_t b_id = 0;
+        const size_t b_hlen = seg.mirror_fd >= 0 ? read_header(seg.mirror_fd, b_id, b_replaced) : 0;
+        const bool b_ok = b_hlen != 0 && b_id == id;
+        if (!a_ok && b_ok) {
+            std::cerr << "[per] log engine: restoring " << SegmentPath_(id) << " from its mirror\n";
+            if (seg.fd < 0) seg.fd = ::open(SegmentPath_(id).c_str(), kFlags | O_CREAT, 0644);
+            const uint64_t size = file_size(seg.mirror_fd);
+            if (seg.fd < 0 || !copy_range(seg.mirror_fd, seg.fd, 0, size)) {
+                CloseSegment_(seg);
+                return false;
+            }
+            recovery_.repaired_bytes += size;
+            hlen = b_hlen;
+            replaced = std::move(b_replaced);
+            a_ok = true;
+        } else if (a_ok && !b_ok) {
+            // Also how existing segments get their copy when mirroring is switched on
+            if (seg.mirror_fd < 0) seg.mirror_fd = ::open(MirrorPath_(id).c_str(), kFlags | O_CREAT, 0644);
+            const uint64_t size = file_size(seg.fd);
+            if (seg.mirror_fd < 0 || !copy_range(seg.fd, seg.mirror_fd, 0, size)) {
+                CloseSegment_(seg);
+                return false;
+            }
+            recovery_.repaired_bytes += size;
+        }
+    }
+    if (!a_ok) {
+        std::cerr << "[per] log engine: ignoring segment with bad header " << SegmentPath_(id) << "\n";
+        CloseSegment_(seg);
+        return false;
+    }
+    seg.size = file_size(seg.fd);
+    segments_[id] = seg;
+    return true;
+}
+
+// Replays one segment. With a mirror, picks up from the B copy where the A
+// copy stops, patches A from it, and leaves both copies byte-identical.
+bool LogStructuredBackend::ReplaySegmentNoLock_(
+    uint32_t id, Segment& seg, uint64_t start,
+    const std::function<uint64_t(const char*, uint64_t, uint64_t)>& scan) noexcept {
+    uint64_t end = 0;
+    {
+        FileMap a(seg.fd, seg.size);
+        if (!a.ok()) return false;
+        end = scan(a.data(), start, seg.size);
+        recovery_.bytes_scanned += seg.size;
+    }
+    if (seg.mirror_fd >= 0) {
+        const uint64_t b_size = file_size(seg.mirror_fd);
+        if (end < b_size) {
+            uint64_t b_end = end;
+            {
+                FileMap b(seg.mirror_fd, b_size);
+                if (!b.ok()) return false;
+                b_end = scan(b.data(), end, b_size);
+                recovery_.bytes_scanned += b_size - end;
+            }
+            if (b_end > end) {
+                if (!copy_range(seg.mirror_fd, seg.fd, end, b_end)) return false;
+                recovery_.repaired_bytes += b_end - end;
+                end = b_end;
+                seg.size = end;
+            }
+        }
+    }
+    if (end < seg.size) {
+        std::cerr << "[per] log engine: truncating " << (seg.size - end)
+                  << " torn/corrupt bytes in " << SegmentPath_(id) << "\n";
+        if (::ftruncate(seg.fd, static_cast<off_t>(end)) != 0) return false;
+        recovery_.truncated_bytes += seg.size - end;
+        seg.size = end;
+    }
+    if (seg.mirror_fd >= 0) {
+        // Only a crash leaves the sizes apart; a scrub compares regardless
+        const uint64_t b_size = file_size(seg.mirror_fd);
+        if (b_size != end || opts_.scrub_on_open) {
+            uint64_t same = 0;
+            {
+                FileMap a(seg.fd, end);
+                FileMap b(seg.mirror_fd, b_size);
+                if (!a.ok() || !b.ok()) return false;
+                same = first_mismatch(a.data(), b.data(), std::min(end, b_size));
+            }
+            if (same < end || b_size != end) {
+                if (!copy_range(seg.fd, seg.mirror_fd, same, end)) return false;
+                recovery_.repaired_bytes += end - same;
+            }
+        }
+    }
+    return true;
+}
+
+// A storage switched from the "file" engine keeps its values: each per-key
+// file becomes a put record, and the files go once the segment is durable,
+// then the import marker. Redoing it rewrites the same values.
+// Values the file engine stored compressed are imported decoded.
+bool LogStructuredBackend::ImportLegacyFilesNoLock_(const std::vector<std::string>& files) noexcept {
+    for (const auto& name : files) {
+        std::ifstream ifs(fs::path(base_path_) / name, std::ios::binary);
+        if (!ifs) return false;
+        std::string value((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        const auto* stored = reinterpret_cast<const uint8_t*>(value.data());
+        if (const auto raw_size = CompressedRawSize(stored, value.size())) {
+            std::string raw(static_cast<size_t>(*raw_size), '\0');
+            if (!Decompress(ara::core::Span<const uint8_t>(stored, value.size()),
+                            reinterpret_cast<uint8_t*>(raw.data()), raw.size()).HasValue()) {
+                std::cerr << "[per] log engine: cannot decode " << name << " for import\n";
+                return false;
+            }
+            value = std::move(raw);
+        }
+        Location loc{};
+        if (!AppendNoLock_(kPut, name, value, loc).HasValue()) return false;
+        index_[name] = loc;
+        used_bytes_ += value.size();
+    }
+    const Segment& active = segments_[active_id_];
+    if (::fdatasync(active.fd) != 0 || (active.mirror_fd >= 0 && ::fdatasync(active.mirror_fd) != 0)) {
+        return false;
+    }
+    std::error_code ec;
+    for (const auto& name : files) fs::remove(fs::path(base_path_) / name, ec);
+    fsync_dir_by_path(base_path_);
+    fs::remove(fs::path(base_path_) / kImportMarker, ec);
+    fsync_dir_by_path(base_path_);
+    return true;
+}
+
+// Start a new active segment. The file only appears under its final name
+// once its header is complete, so a crash never leaves a headerless segment.
+bool LogStructuredBackend::RollNoLock_() noexcept {
+    const bool sync = opts_.durability != Durability::None;
+    if (sync && active_id_ != 0) {
+        auto it = segments_.find(active_id_);
+        // Sealed unsynced, its tail would never be synced again
+        if (it != segments_.end() &&
+            (::fdatasync(it->second.fd) != 0 ||
+             (it->second.mirror_fd >= 0 && ::fdatasync(it->second.mirror_fd) != 0))) {
+            return false;
+        }
+    }
+    const uint32_t id = next_id_++;
+    const std::string hdr = make_header(id, {});
+    // Same steps for the A copy and, if mirrored, the B copy
+    auto create = [&](const std::string& final_path, const std::string& dir) {
+        const std::string tmp_path = final_path + ".tmp";
+        int fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) return -1;
+        if (!write_all(fd, hdr.data(), hdr.size()) || (sync && ::fdatasync(fd) != 0) ||
+            ::rename(tmp_path.c_str(), final_path.c_str()) != 0) {
+            ::close(fd);
+            ::unlink(tmp_path.c_str());
+            return -1;
+        }
+        if (sync) fsync_dir_by_path(dir);
+        return fd;
+    };
+    Segment seg{-1, hdr.size(), 0, -1};
+    seg.fd = create(SegmentPath_(id), base_path_);
+    if (seg.fd < 0) return false;
+    if (!mirror_dir_.empty()) {
+        seg.mirror_fd = create(MirrorPath_(id), mirror_dir_);
+        if (seg.mirror_fd < 0) {
+            CloseSegment_(seg);
+            ::unlink(SegmentPath_(id).c_str());
+            return false;
+        }
+    }
+    segments_[id] = seg;
+    disk_bytes_ += hdr.size();
+    active_id_ = id;
+    return true;
+}
+
+// One write() of one complete frame; `off` receives where it landed.
+ara::core::Result<void>
+LogStructuredBackend::WriteFrameNoLock_(const std::string& rec, uint64_t min_seq, uint64_t& off) noexcept {
+    auto* seg = &segments_[active_id_];
+    if (seg->size >= opts_.segment_bytes) {
+        if (!RollNoLock_()) return ErrorCode(PersistencyErrc::kUnknown);
+        seg = &segments_[active_id_];
+    }
+    if (!write_all(seg->fd, rec.data(), rec.size()) ||
+        (seg->mirror_fd >= 0 && !write_all(seg->mirror_fd, rec.data(), rec.size()))) {
+        // Drop the partial frame from both copies
+        if (::ftruncate(seg->fd, static_cast<off_t>(seg->size)) != 0) ok_ = false;
+        if (seg->mirror_fd >= 0 && ::ftruncate(seg->mirror_fd, static_cast<off_t>(seg->size)) != 0) ok_ = false;
+        return ErrorCode(PersistencyErrc::kUnknown);
+    }
+    off = seg->size;
+    seg->size += rec.size();
+    seg->min_seq = std::min(seg->min_seq, min_seq);
+    disk_bytes_ += rec.size();
+    return {};
+}
+
+ara::core::Result<void>
+LogStructuredBackend::AppendNoLock_(uint8_t type, std::string_view key,
+                                    std::string_view value, Location& loc) noexcept {
+    const uint64_t seq = next_seq_++;
+    const std::string rec = make_record(type, seq, key, value);
+    uint64_t off = 0;
+    auto r = WriteFrameNoLock_(rec, seq, off);
+    if (!r.HasValue()) return r;
+    loc = Location{active_id_, off, static_cast<uint32_t>(rec.size()),
+                   static_cast<uint32_t>(value.size()), seq};
+    return {};
+}
+
+// The whole batch is one outer frame, so it is either replayed completely or
+// (torn) not at all. Index entries point at the inner frames directly.
+ara::core::Result<void> LogStructuredBackend::ApplyBatch(const std::vector<BatchOp>& ops) noexcept {
+    uint64_t bytes = 0;
+    for (const auto& op : ops) bytes += op.key.size() + (op.value ? op.value->size() : 0);
+    IoScheduler::Instance().Admit(opts_.io, bytes);   // before mtx_, which readers need
+
+    std::unique_lock<RwLock> lock(mtx_);
+    if (!ok_) return ErrorCode(PersistencyErrc::kUnknown);
+
+    std::map<std::string, const BatchOp*> last;   // last op per key wins
+    for (const auto& op : ops) {
+        if (!ValidKey(op.key) || (op.value && op.value->size() > kMaxValue)) {
+            return ErrorCode(PersistencyErrc::kPermissionDenied);
+        }
+        last[op.key] = &op;
+    }
+    uint64_t new_used = used_bytes_;
+    for (auto it = last.begin(); it != last.end();) {
+        auto cur = index_.find(it->first);
+        if (!it->second->value && cur == index_.end()) { it = last.erase(it); continue; }
+        if (cur != index_.end()) new_used -= cur->second.value_len;
+        if (it->second->value) new_used += it->second->value->size();
+        ++it;
+    }
+    if (last.empty()) return {};
+    if (new_used > quota_) return ErrorCode(PersistencyErrc::kQuotaExceeded);
+
+    std::string body;
+    std::vector<Location> locs;
+    const uint64_t first_seq = next_seq_;
+    for (const auto& [key, op] : last) {
+        const uint64_t seq = next_seq_++;
+        const std::string rec = make_record(op->value ? kPut : kDelete, seq, key, op->value ? std::string_view(*op->value) : std::string_view());
+        locs.push_back(Location{0, kRecHdr + body.size(), static_cast<uint32_t>(rec.size()),
+                                static_cast<uint32_t>(op->value ? op->value->size() : 0), seq});
+        body += rec;
+    }
+    uint64_t off = 0;
+    auto r = WriteFrameNoLock_(make_record(kBatch, next_seq_++, {}, body), first_seq, off);
+    if (!r.HasValue()) return r;
+
+    Segment& seg = segments_[active_id_];
+    seg.dead += kRecHdr;                      // the outer header is never referenced
+    dead_bytes_ += kRecHdr;
+    size_t i = 0;
+    for (const auto& [key, op] : last) {
+        Location loc = locs[i++];
+        loc.seg = active_id_;
+        loc.off += off;
+        auto cur = index_.find(key);
+        if (cur != index_.end()) {
+            segments_[cur->second.seg].dead += cur->second.rec_len;
+            dead_bytes_ += cur->second.rec_len;
+        }
+        if (op->value) {
+            index_[key] = loc;
+            tombstones_.erase(key);
+        } else {
+            index_.erase(key);
+            tombstones_[key] = loc;
+            seg.dead += loc.rec_len;
+            dead_bytes_ += loc.rec_len;
+        }
+    }
+    used_bytes_ = new_used;
+    MaybeRequestCompactionNoLock_();
+    const FdPair sync_fds = DupActiveFdsNoLock_(opts_.durability == Durability::EveryWrite);
+    lock.unlock();
+    if (!SyncAndClose_(sync_fds)) return ErrorCode(PersistencyErrc::kUnknown);
+    return {};
+}
+
+bool LogStructuredBackend::ValidKey(std::string_view key) const noexcept {
+    return !key.empty() && key.size() <= kMaxKey;
+}
+
+ara::core::Result<size_t> LogStructuredBackend::ValueSize(std::string_view key) const noexcept {
+    std::shared_lock<RwLock> lock(mtx_);
+    auto it = index_.find(key);
+    if (it == index_.end()) return ErrorCode(PersistencyErrc::kNotFound);
+    return static_cast<size_t>(it->second.value_len);
+}
+
+ara::core::Result<void>
+LogStructuredBackend::SetValue(std::string_view key, std::string_view value) noexcept {
+    IoScheduler::Instance().Admit(opts_.io, key.size() + value.size());
+    std::unique_lock<RwLock> lock(mtx_);
+    if (!ok_) return ErrorCode(PersistencyErrc::kUnknown);
+    if (!ValidKey(key) || value.size() > kMaxValue) {
+        return ErrorCode(PersistencyErrc::kPermissionDenied);
+    }
+
+    auto it = index_.find(key);
+    const uint64_t old_size = it != index_.end() ? it->second.value_len : 0;
+    const uint64_t new_used = used_bytes_ - old_size + value.size();
+    if (new_used > quota_) return ErrorCode(PersistencyErrc::kQuotaExceeded);
+
+    Location loc{};
+    auto r = AppendNoLock_(kPut, key, value, loc);
+    if (!r.HasValue()) return r;
+
+    if (it != index_.end()) {
+        segments_[it->second.seg].dead += it->second.rec_len;
+        dead_bytes_ += it->second.rec_len;
+        it->second = loc;
+    } else {
+        index_.emplace(std::string(key), loc);
+        auto tomb = tombstones_.find(key);
+        if (tomb != tombstones_.end()) tombstones_.erase(tomb);
+    }
+    used_bytes_ = new_used;
+    MaybeRequestCompactionNoLock_();
+    const FdPair sync_fds = DupActiveFdsNoLock_(opts_.durability == Durability::EveryWrite);
+    lock.unlock();
+    if (!SyncAndClose_(sync_fds)) return ErrorCode(PersistencyErrc::kUnknown);
+    return {};
+}
+
+ara::core::Result<std::string> LogStructuredBackend::GetValue(std::string_view key) const noexcept {
+    std::shared_lock<RwLock> lock(mtx_);
+    auto it = index_.find(key);
+    if (it == index_.end()) return ErrorCode(PersistencyErrc::kNotFound);
+    const Location& loc = it->second;
+    const Segment& seg = segments_.at(loc.seg);
+    RecordView rv;
+    std::string value;
+    if (!read_record(seg.fd, loc.off, seg.size, rv, &value) || rv.seq != loc.seq) {
+        // A copy damaged since open; the B copy may still be good
+        if (seg.mirror_fd < 0 || !read_record(seg.mirror_fd, loc.off, seg.size, rv, &value) ||
+            rv.seq != loc.seq) {
+            return ErrorCode(PersistencyErrc::kCorruption);
+        }
+    }
+    return value;
+}
+
+ara::core::Result<std::vector<std::string>> LogStructuredBackend::GetAllKeys() const noexcept {
+    std::shared_lock<RwLock> lock(mtx_);
+    std::vector<std::string> keys;
+    keys.reserve(index_.size());
+    for (const auto& kv : index_) keys.push_back(kv.first);
+    return keys;
+}
+
+ara::core::Result<void> LogStructuredBackend::VisitKeys(std::string_view prefix, std::string_view after,
+                                                   const KeyVisitor& fn) const noexcept {
+    std::shared_lock<RwLock> lock(mtx_);
+    VisitOrderedKeys(index_, prefix, after, fn);
+    return {};
+}
+
+ara::core::Result<size_t> LogStructuredBackend::CountKeys(std::string_view prefix) const noexcept {
+    std::shared_lock<RwLock> lock(mtx_);
+    if (prefix.empty()) return index_.size();
+    size_t n = 0;
+    VisitOrderedKeys(index_, prefix, {}, [&n](std::string_view) { ++n; return true; });
+    return n;
+}
+
+ara::core::Result<bool> LogStructuredBackend::HasKey(std::string_view key) const noexcept {
+    std::shared_lock<RwLock> lock(mtx_);
+    return index_.count(key) != 0;
+}
+
+ara::core::Result<void> LogStructuredBackend::RemoveKey(std::string_view key) noexcept {
+    std::unique_lock<RwLock> lock(mtx_);
+    if (!ok_) return ErrorCode(PersistencyErrc::kUnknown);
+    auto it = index_.find(key);
+    if (it == index_.end()) return ErrorCode(PersistencyErrc::kNotFound);
+
+    Location tomb{};
+    auto r = AppendNoLock_(kDelete, key, {}, tomb);
+    if (!r.HasValue()) return r;
+
+    // Both the old put and the tombstone itself are garbage for compaction
+    segments_[it->second.seg].dead += it->second.rec_len;
+    segments_[tomb.seg].dead += tomb.rec_len;
+    dead_bytes_ += it->second.rec_len + tomb.rec_len;
+    used_bytes_ -= it->second.value_len;
+    index_.erase(it);
+    tombstones_[std::string(key)] = tomb;
+    MaybeRequestCompactionNoLock_();
+    const FdPair sync_fds = DupActiveFdsNoLock_(opts_.durability == Durability::EveryWrite);
+    lock.unlock();
+    if (!SyncAndClose_(sync_fds)) return ErrorCode(PersistencyErrc::kUnknown);
+    return {};
+}
+
+ara::core::Result<void> LogStructuredBackend::SyncToStorage() const noexcept {
+    FdPair sync_fds;
+    {
+        std::shared_lock<RwLock> lock(mtx_);
+        if (!ok_) return ErrorCode(PersistencyErrc::kUnknown);
+        // Sealed segments were synced on rollover; only the active one can be dirty
+        sync_fds = DupActiveFdsNoLock_(opts_.durability != Durability::None);
+    }
+    if (!SyncAndClose_(sync_fds)) return ErrorCode(PersistencyErrc::kUnknown);
+    return {};
+}
+
+// The dup keeps the file open even if compaction closes the segment while
+// the caller is flushing.
+LogStructuredBackend::FdPair LogStructuredBackend::DupActiveFdsNoLock_(bool want) const noexcept {
+    FdPair fds;
+    if (!want) return fds;
+    auto it = segments_.find(active_id_);
+    if (it == segments_.end()) return fds;
+    fds.a = ::fcntl(it->second.fd, F_DUPFD_CLOEXEC, 0);
+    if (it->second.mirror_fd >= 0) fds.b = ::fcntl(it->second.mirror_fd, F_DUPFD_CLOEXEC, 0);
+    return fds;
+}
+
+bool LogStructuredBackend::SyncAndClose_(FdPair fds) noexcept {
+    bool ok = true;
+    if (fds.a >= 0) ok = sync_and_close(fds.a) && ok;
+    if (fds.b >= 0) ok = sync_and_close(fds.b) && ok;
+    return ok;
+}
+
+ara::core::Result<void> LogStructuredBackend::DiscardPendingChanges() const noexcept {
+    // Writes go straight to the log; nothing staged.
+    return {};
+}
+
+size_t LogStructuredBackend::GetUsedSpace() const {
+    std::shared_lock<RwLock> lock(mtx_);
+    return static_cast<size_t>(used_bytes_);
+}
+
+LogStructuredBackend::Stats LogStructuredBackend::GetStats() const {
+    std::shared_lock<RwLock> lock(mtx_);
+    return Stats{segments_.size(), disk_bytes_, dead_bytes_, compactions_};
+}
+
+LogStructuredBackend::RecoveryStats LogStructuredBackend::GetRecoveryStats() const {
+    std::shared_lock<RwLock> lock(mtx_);
+    return recovery_;
+}
+
+void LogStructuredBackend::MaybeRequestCompactionNoLock_() noexcept {
+    if (compacting_ || compact_requested_) return;
+    const Segment& active = segments_.at(active_id_);
+    const uint64_t sealed_total = disk_bytes_ - active.size;
+    const uint64_t sealed_dead  = dead_bytes_ - active.dead;
+    if (sealed_total == 0) return;
+    if (static_cast<double>(sealed_dead) >= opts_.compaction_threshold * static_cast<double>(sealed_total)) {
+        compact_requested_ = true;
+        cv_.notify_all();   // Compact() callers may be waiting on cv_ too
+    }
+}
+
+void LogStructuredBackend::CompactorLoop_() {
+    std::unique_lock<RwLock> lock(mtx_);
+    for (;;) {
+        cv_.wait(lock, [this] { return stop_ || compact_requested_; });
+        if (stop_) return;
+        lock.unlock();
+        auto r = Compact();
+        if (!r.HasValue()) std::cerr << "[per] log engine: compaction failed in " << base_path_ << "\n";
+        lock.lock();
+        compact_requested_ = false;
+    }
+}
+
+// Copies live records of all sealed segments into one new segment, then
+// swaps the index over and deletes the old files. Sealed segments are
+// immutable, so the copy runs without mtx_; writers only touch the active one.
+ara::core::Result<void> LogStructuredBackend::Compact() noexcept {
+    struct Live { std::string key; Location from; uint64_t new_off; bool tomb; };
+    std::vector<uint32_t> victims;
+    std::vector<Live> live;
+    std::map<uint32_t, FdPair> fds;
+    uint32_t out_id = 0;
+    {
+        // An explicit call waits for a background pass instead of skipping
+        std::unique_lock<RwLock> lock(mtx_);
+        cv_.wait(lock, [this] { return !compacting_ || stop_; });
+        if (!ok_ || compacting_) return {};
+        for (const auto& [id, seg] : segments_) {
+            if (id == active_id_) continue;
+            victims.push_back(id);
+            fds[id] = FdPair{seg.fd, seg.mirror_fd};
+        }
+        if (victims.empty()) return {};
+        for (const auto& [key, loc] : index_)
+            if (loc.seg != active_id_) live.push_back(Live{key, loc, 0, false});
+        // A tombstone goes only if no segment left alone (the active one)
+        // has records older than it, which could include a put of its key
+        const uint64_t oldest_kept = segments_.at(active_id_).min_seq;
+        for (const auto& [key, loc] : tombstones_)
+            if (loc.seg != active_id_ && loc.seq > oldest_kept) live.push_back(Live{key, loc, 0, true});
+        out_id = next_id_++;
+        compacting_ = true;
+    }
+    auto done = [this](ara::core::Result<void> r) {
+        {
+            std::unique_lock<RwLock> lock(mtx_);
+            compacting_ = false;
+        }
+        cv_.notify_all();
+        return r;
+    };
+
+    // Keep the copy in file order for sequential reads
+    std::sort(live.begin(), live.end(), [](const Live& a, const Live& b) {
+        return a.from.seg != b.from.seg ? a.from.seg < b.from.seg : a.from.off < b.from.off;
+    });
+
+    const std::string final_path = SegmentPath_(out_id);
+    const std::string tmp_path = final_path + ".tmp";
+    const bool mirrored = !mirror_dir_.empty();
+    const std::string mirror_final = mirrored ? MirrorPath_(out_id) : std::string();
+    const std::string mirror_tmp = mirror_final + ".tmp";
+    constexpr int kCreate = O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC;
+    int fd = ::open(tmp_path.c_str(), kCreate, 0644);
+    int mfd = mirrored ? ::open(mirror_tmp.c_str(), kCreate, 0644) : -1;
+    auto fail = [&] {
+        if (fd >= 0) ::close(fd);
+        if (mfd >= 0) ::close(mfd);
+        ::unlink(tmp_path.c_str());
+        if (mirrored) ::unlink(mirror_tmp.c_str());
+        return done(ErrorCode(PersistencyErrc::kUnknown));
+    };
+    if (fd < 0 || (mirrored && mfd < 0)) return fail();
+    auto emit = [&](const std::string& bytes) {
+        IoScheduler::Instance().Admit(opts_.io, bytes.size());
+        return write_all(fd, bytes.data(), bytes.size()) &&
+               (!mirrored || write_all(mfd, bytes.data(), bytes.size()));
+    };
+
+    std::string out = make_header(out_id, victims);
+    const size_t hdr_len = out.size();
+    uint64_t size = 0;
+    uint64_t min_seq = UINT64_MAX;
+    std::string rec;
+    for (auto& l : live) {
+        rec.resize(l.from.rec_len);
+        const FdPair& src = fds[l.from.seg];
+        // 1 good, 0 bad CRC, -1 I/O error (aborts rather than drop a record)
+        auto read_from = [&](int from) {
+            if (!pread_all(from, &rec[0], rec.size(), l.from.off)) return -1;
+            return get_le<uint32_t>(rec.data()) == Crc32c(rec.data() + 4, rec.size() - 4) ? 1 : 0;
+        };
+        int got = read_from(src.a);
+        if (got != 1 && src.b >= 0) {
+            const int from_b = read_from(src.b);
+            got = from_b == 1 ? 1 : std::min(got, from_b);
+        }
+        if (got < 0) return fail();
+        if (got == 0) {
+            std::cerr << "[per] log engine: dropping corrupt record '" << l.key << "' during compaction\n";
+            l.new_off = UINT64_MAX;
+            continue;
+        }
+        l.new_off = size + out.size();
+        min_seq = std::min(min_seq, l.from.seq);
+        out += rec;                       // records keep their seq, so replay order is unaffected
+        if (out.size() >= (1u << 20)) {
+            if (!emit(out)) return fail();
+            size += out.size();
+            out.clear();
+        }
+    }
+    if (!emit(out)) return fail();
+    size += out.size();
+    // Always durable before the old segments go, whatever the policy. Either
+    // copy alone lists the victims, so a crash between the renames is fine.
+    if (::fdatasync(fd) != 0 || (mirrored && ::fdatasync(mfd) != 0) ||
+        ::rename(tmp_path.c_str(), final_path.c_str()) != 0) {
+        return fail();
+    }
+    if (mirrored && ::rename(mirror_tmp.c_str(), mirror_final.c_str()) != 0) {
+        ::unlink(final_path.c_str());
+        return fail();
+    }
+    fsync_dir_by_path(base_path_);
+    if (mirrored) fsync_dir_by_path(mirror_dir_);
+
+    std::unique_lock<RwLock> lock(mtx_);
+    Segment seg{fd, size, size - hdr_len, mfd, min_seq};   // live records subtracted below
+    for (const auto& l : live) {
+        if (l.tomb) {
+            // Kept tombstones stay dead bytes
+            auto it = tombstones_.find(l.key);
+            if (l.new_off != UINT64_MAX && it != tombstones_.end() &&
+                it->second.seg == l.from.seg && it->second.off == l.from.off) {
+                it->second.seg = out_id;
+                it->second.off = l.new_off;
+            }
+            continue;
+        }
+        auto it = index_.find(l.key);
+        if (l.new_off == UINT64_MAX) {
+            if (it != index_.end() && it->second.seg == l.from.seg && it->second.off == l.from.off) {
+                used_bytes_ -= it->second.value_len;
+                index_.erase(it);
+            }
+            continue;
+        }
+        if (it != index_.end() && it->second.seg == l.from.seg && it->second.off == l.from.off) {
+            it->second.seg = out_id;
+            it->second.off = l.new_off;
+            seg.dead -= l.from.rec_len;
+        }
+        // else: overwritten/removed meanwhile; the copy is dead on arrival
+    }
+    for (auto it = tombstones_.begin(); it != tombstones_.end();) {
+        if (std::binary_search(victims.begin(), victims.end(), it->second.seg)) it = tombstones_.erase(it);
+        else ++it;
+    }
+    for (uint32_t id : victims) {
+        auto it = segments_.find(id);
+        disk_bytes_ -= it->second.size;
+        dead_bytes_ -= it->second.dead;
+        CloseSegment_(it->second);
+        segments_.erase(it);
+        ::unlink(SegmentPath_(id).c_str());
+        if (mirrored) ::unlink(MirrorPath_(id).c_str());
+    }
+    segments_[out_id] = seg;
+    disk_bytes_ += seg.size;
+    dead_bytes_ += seg.dead;
+    ++compactions_;
+    compacting_ = false;
+    lock.unlock();
+    cv_.notify_all();
+    return {};
+}
+
+} // namespace persistency
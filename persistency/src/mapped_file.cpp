@@ -0,0 +1,132 @@
+#include <persistency/mapped_file.hpp>
+#include <cerrno>
+
+#include <fcntl.h>      // open
+#include <sys/mman.h>   // mmap, munmap
+#include <sys/stat.h>
+#include <unistd.h>     // close
+
+using ara::core::ErrorCode;
+using ara::core::PersistencyErrc;
+
+namespace persistency {
+
+struct MappingCache::Mapping {
+    void*  addr{nullptr};
+    size_t size{0};
+    ~Mapping() {
+        if (addr) ::munmap(addr, size);
+    }
+};
+
+MappedView MappedView::FromString(std::string value) {
+    auto owner = std::make_shared<const std::string>(std::move(value));
+    return MappedView(owner, reinterpret_cast<const uint8_t*>(owner->data()), owner->size());
+}
+
+MappingCache& MappingCache::Instance() {
+    static MappingCache cache;
+    return cache;
+}
+
+ara::core::Result<MappedView> MappingCache::Get(const std::string& path) noexcept {
+    uint64_t gen = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = entries_.find(path);
+        if (it != entries_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            ++stats_.hits;
+            const auto& m = it->second.map;
+            return MappedView(m, static_cast<const uint8_t*>(m->addr), m->size);
+        }
+        ++stats_.misses;
+        gen = generation_;
+    }
+
+    // Open and map without the lock; the mapping pins this version of the file
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return ErrorCode(errno == ENOENT ? PersistencyErrc::kNotFound : PersistencyErrc::kPermissionDenied);
+    }
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return ErrorCode(PersistencyErrc::kUnknown);
+    }
+    auto m = std::make_shared<Mapping>();
+    m->size = static_cast<size_t>(st.st_size);
+    if (m->size > 0) {
+        void* p = ::mmap(nullptr, m->size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            return ErrorCode(PersistencyErrc::kUnknown);
+        }
+        m->addr = p;
+    }
+    ::close(fd);
+    MappedView view(m, static_cast<const uint8_t*>(m->addr), m->size);
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (gen == generation_ && m->size <= max_bytes_ && entries_.find(path) == entries_.end()) {
+        lru_.push_front(path);
+        entries_.emplace(path, Entry{m, lru_.begin()});
+        bytes_ += m->size;
+        EvictNoLock_();
+    }
+    return view;
+}
+
+void MappingCache::Invalidate(const std::string& path) noexcept {
+    std::lock_guard<std::mutex> lock(mtx_);
+    ++generation_;
+    auto it = entries_.find(path);
+    if (it == entries_.end()) return;
+    ++stats_.invalidations;
+    EraseNoLock_(it);
+}
+
+void MappingCache::InvalidatePrefix(const std::string& dir) noexcept {
+    std::string prefix = dir;
+    if (!prefix.empty() && prefix.back() != '/') prefix += '/';
+    std::lock_guard<std::mutex> lock(mtx_);
+    ++generation_;
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        auto next = std::next(it);
+        if (it->first.compare(0, prefix.size(), prefix) == 0) {
+            ++stats_.invalidations;
+            EraseNoLock_(it);
+        }
+        it = next;
+    }
+}
+
+void MappingCache::SetLimits(size_t max_entries, size_t max_bytes) noexcept {
+    std::lock_guard<std::mutex> lock(mtx_);
+    max_entries_ = max_entries;
+    max_bytes_ = max_bytes;
+    EvictNoLock_();
+}
+
+MappingCache::Stats MappingCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    Stats s = stats_;
+    s.entries = entries_.size();
+    s.bytes = bytes_;
+    return s;
+}
+
+// Views handed out earlier keep their mapping alive; this only drops ours
+void MappingCache::EraseNoLock_(std::unordered_map<std::string, Entry>::iterator it) noexcept {
+    bytes_ -= it->second.map->size;
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+}
+
+void MappingCache::EvictNoLock_() noexcept {
+    while (!lru_.empty() && (entries_.size() > max_entries_ || bytes_ > max_bytes_)) {
+        EraseNoLock_(entries_.find(lru_.back()));
+    }
+}
+
+} // namespace persistency
@@ -0,0 +1,227 @@
+#include <persistency/staged_backend.hpp>
+
+using ara::core::ErrorCode;
+using ara::core::PersistencyErrc;
+
+namespace persistency {
+
+const std::optional<std::string>* StagedKeyValueBackend::FindNoLock_(std::string_view key) const noexcept {
+    auto it = staged_.find(key);
+    if (it != staged_.end()) return &it->second;
+    it = in_flight_.find(key);
+    if (it != in_flight_.end()) return &it->second;
+    return nullptr;
+}
+
+const StagedKeyValueBackend::Overlay& StagedKeyValueBackend::OverlayNoLock_(Overlay& scratch) const {
+    if (in_flight_.empty()) return staged_;
+    scratch = in_flight_;
+    for (const auto& [k, v] : staged_) scratch.insert_or_assign(k, v);
+    return scratch;
+}
+
+// While a sync is in flight the engine is half way through it; count it
+// as it was, plus the in-flight changes
+int64_t StagedKeyValueBackend::EngineUsedNoLock_() const {
+    if (in_flight_.empty()) return static_cast<int64_t>(inner_->GetUsedSpace());
+    return static_cast<int64_t>(in_flight_base_) + in_flight_delta_;
+}
+
+ara::core::Result<void>
+StagedKeyValueBackend::StageNoLock_(std::string_view key, std::optional<std::string> value) noexcept {
+    // A key the engine refuses would fail every sync from now on
+    if (!inner_->ValidKey(key)) return ErrorCode(PersistencyErrc::kPermissionDenied);
+
+    auto it = staged_.find(key);
+    const auto* layered = FindNoLock_(key);
+    bool exists;
+    size_t old_eff = 0;
+    if (layered) {
+        exists  = layered->has_value();
+        old_eff = exists ? (*layered)->size() : 0;
+    } else {
+        auto sz = inner_->ValueSize(key);
+        exists  = sz.HasValue();
+        old_eff = exists ? sz.Value() : 0;
+    }
+    if (!value && !exists) return ErrorCode(PersistencyErrc::kNotFound);
+
+    const size_t new_eff = value ? value->size() : 0;
+    const int64_t delta = delta_bytes_ - static_cast<int64_t>(old_eff) + static_cast<int64_t>(new_eff);
+    const int64_t used  = EngineUsedNoLock_() + delta;
+    if (value && used > 0 && static_cast<uint64_t>(used) > inner_->GetQuota()) {
+        return ErrorCode(PersistencyErrc::kQuotaExceeded);
+    }
+
+    if (it != staged_.end()) it->second = std::move(value);
+    else staged_.emplace(std::string(key), std::move(value));
+    delta_bytes_ = delta;
+    return {};
+}
+
+ara::core::Result<void>
+StagedKeyValueBackend::SetValue(std::string_view key, std::string_view value) noexcept {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return StageNoLock_(key, std::string(value));
+}
+
+ara::core::Result<void> StagedKeyValueBackend::RemoveKey(std::string_view key) noexcept {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return StageNoLock_(key, std::nullopt);
+}
+
+// Staged like individual writes, but all or nothing
+ara::core::Result<void> StagedKeyValueBackend::ApplyBatch(const std::vector<BatchOp>& ops) noexcept {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto saved_staged = staged_;
+    const int64_t saved_delta = delta_bytes_;
+    for (const auto& op : ops) {
+        auto r = StageNoLock_(op.key, op.value);
+        if (!r.HasValue() && !(r.Error().value == PersistencyErrc::kNotFound && !op.value)) {
+            staged_ = std::move(saved_staged);
+            delta_bytes_ = saved_delta;
+            return r;
+        }
+    }
+    return {};
+}
+
+ara::core::Result<std::string> StagedKeyValueBackend::GetValue(std::string_view key) const noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (const auto* v = FindNoLock_(key)) {
+            if (!*v) return ErrorCode(PersistencyErrc::kNotFound);
+            return **v;
+        }
+    }
+    return inner_->GetValue(key);
+}
+
+ara::core::Result<MappedView> StagedKeyValueBackend::GetValueView(std::string_view key) const noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (const auto* v = FindNoLock_(key)) {
+            if (!*v) return ErrorCode(PersistencyErrc::kNotFound);
+            return MappedView::FromString(**v);
+        }
+    }
+    return inner_->GetValueView(key);
+}
+
+ara::core::Result<size_t> StagedKeyValueBackend::ValueSize(std::string_view key) const noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (const auto* v = FindNoLock_(key)) {
+            if (!*v) return ErrorCode(PersistencyErrc::kNotFound);
+            return (*v)->size();
+        }
+    }
+    return inner_->ValueSize(key);
+}
+
+ara::core::Result<bool> StagedKeyValueBackend::HasKey(std::string_view key) const noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (const auto* v = FindNoLock_(key)) return v->has_value();
+    }
+    return inner_->HasKey(key);
+}
+
+ara::core::Result<std::vector<std::string>> StagedKeyValueBackend::GetAllKeys() const noexcept {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto r = inner_->GetAllKeys();
+    if (!r.HasValue()) return r;
+    Overlay scratch;
+    const Overlay& over = OverlayNoLock_(scratch);
+    std::vector<std::string> keys;
+    keys.reserve(r.Value().size() + over.size());
+    for (auto& k : r.Value())
+        if (over.find(k) == over.end()) keys.push_back(std::move(k));
+    for (const auto& [k, v] : over)
+        if (v) keys.push_back(k);
+    return keys;
+}
+
+// Staged changes are sorted like the engine's keys, so one pass merges
+// them: staged additions are emitted as the engine scan passes them, staged
+// keys replace or hide the engine's, and the rest follow at the end.
+ara::core::Result<void> StagedKeyValueBackend::VisitKeys(std::string_view prefix, std::string_view after,
+                                                         const KeyVisitor& fn) const noexcept {
+    std::lock_guard<std::mutex> lock(mtx_);
+    Overlay scratch;
+    const Overlay& over = OverlayNoLock_(scratch);
+    auto st = after.empty() || after < prefix ? over.lower_bound(prefix) : over.upper_bound(after);
+    auto in_range = [&] { return st != over.end() && st->first.compare(0, prefix.size(), prefix) == 0; };
+    bool go = true;
+    // Staged additions sorting before `key` (all remaining when null)
+    auto emit_staged_before = [&](const std::string_view* key) {
+        for (; go && in_range() && (!key || std::string_view(st->first) < *key); ++st) {
+            if (st->second) go = fn(st->first);
+        }
+    };
+    auto r = inner_->VisitKeys(prefix, after, [&](std::string_view key) {
+        emit_staged_before(&key);
+        if (!go) return false;
+        if (in_range() && st->first == key) {   // staged over the engine's copy
+            const bool live = st->second.has_value();
+            ++st;
+            if (!live) return true;
+        }
+        go = fn(key);
+        return go;
+    });
+    if (!r.HasValue()) return r;
+    emit_staged_before(nullptr);
+    return {};
+}
+
+ara::core::Result<void> StagedKeyValueBackend::SyncToStorage() const noexcept {
+    std::lock_guard<std::mutex> sync(sync_mtx_);
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!staged_.empty()) {
+            in_flight_base_ = inner_->GetUsedSpace();
+            in_flight_.swap(staged_);
+            in_flight_delta_ = delta_bytes_;
+            delta_bytes_ = 0;
+        }
+    }
+    // Only this call changes in_flight_, so it is read here without mtx_
+    if (!in_flight_.empty()) {
+        std::vector<BatchOp> ops;
+        ops.reserve(in_flight_.size());
+        for (const auto& [k, v] : in_flight_) ops.push_back(BatchOp{k, v});
+        auto r = inner_->ApplyBatch(ops);
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!r.HasValue()) {
+            // Back under what was staged since; caller may retry or discard
+            for (auto& [k, v] : in_flight_) staged_.emplace(k, std::move(v));
+            delta_bytes_ += in_flight_delta_;
+        }
+        in_flight_.clear();
+        in_flight_delta_ = 0;
+        if (!r.HasValue()) return r;
+    }
+    return inner_->SyncToStorage();
+}
+
+ara::core::Result<void> StagedKeyValueBackend::DiscardPendingChanges() const noexcept {
+    std::lock_guard<std::mutex> lock(mtx_);
+    staged_.clear();
+    delta_bytes_ = 0;
+    return {};
+}
+
+size_t StagedKeyValueBackend::GetUsedSpace() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    const int64_t used = EngineUsedNoLock_() + delta_bytes_;
+    return used > 0 ? static_cast<size_t>(used) : 0;
+}
+
+size_t StagedKeyValueBackend::PendingChanges() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return staged_.size();
+}
+
+} // namespace persistency
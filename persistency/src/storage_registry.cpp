@@ -1,7 +1,9 @@
 #include <persistency/storage_registry.hpp>
 #include <filesystem>
 #include <fstream>
+#include <iostream>
 #include <system_error>
+#include <tuple>
 #include <nlohmann/json.hpp>
 
 namespace fs = std::filesystem;
@@ -20,9 +22,55 @@ static StorageType ParseType(const std::string& s) {
     return StorageType::Files; // default minimal
 }
 
+static KvEngine ParseEngine(const std::string& s) {
+    if (s == "log") return KvEngine::Log;
+    return KvEngine::File;
+}
+
+static WriteMode ParseWriteMode(const std::string& s) {
+    if (s == "write_back") return WriteMode::WriteBack;
+    return WriteMode::WriteThrough;
+}
+
+static ValueEncoding ParseValueEncoding(const std::string& s) {
+    if (s == "text") return ValueEncoding::Text;
+    return ValueEncoding::Binary;
+}
+
+static Durability ParseDurability(const std::string& s) {
+    if (s == "every_write") return Durability::EveryWrite;
+    if (s == "none")        return Durability::None;
+    return Durability::OnSync;
+}
+
+static Codec ParseCodec(const std::string& s) {
+    if (s == "lz4")  return Codec::Lz4;
+    if (s == "zstd") return Codec::Zstd;
+    return Codec::None;
+}
+
+static IoPriority ParseIoPriority(const std::string& s) {
+    if (s == "critical") return IoPriority::Critical;
+    if (s == "bulk")     return IoPriority::Bulk;
+    return IoPriority::Normal;
+}
+
+// io is left out: it changes the scheduler's queue, not the storage
+static bool SameConfig(const StorageConfig& a, const StorageConfig& b) {
+    auto fields = [](const StorageConfig& c) {
+        return std::tie(c.type, c.base_path, c.quota_bytes, c.recover_on_start, c.engine, c.segment_bytes,
+                        c.compaction_threshold, c.durability, c.redundant, c.mirror_path, c.write_mode,
+                        c.value_encoding, c.group_commit, c.group_commit_max_latency_ms,
+                        c.watch_external, c.compression.codec, c.compression.min_bytes,
+                        c.compression.level);
+    };
+    return fields(a) == fields(b);
+}
+
 ara::core::Result<void> StorageRegistry::InitFromFile(const std::string& path) noexcept {
     std::lock_guard<std::mutex> lock(mtx_);
-    map_.clear();
+    auto snap = std::make_unique<Snapshot>();
+    IoScheduler::Options io;
 
     std::ifstream in(path);
     if (!in) return ara::core::ErrorCode(ara::core::PersistencyErrc::kNotFound);
@@ -40,33 +88,126 @@ ara::core::Result<void> StorageRegistry::InitFromFile(const std::string& path) n
             cfg.base_path    = s.at("base_path").get<std::string>();
             cfg.quota_bytes  = s.value("quota_bytes", static_cast<size_t>(-1));
             cfg.recover_on_start = s.value("recover_on_start", false);
+            cfg.engine       = ParseEngine(s.value("engine", "file"));
+            cfg.segment_bytes = s.value("segment_bytes", cfg.segment_bytes);
+            cfg.compaction_threshold = s.value("compaction_threshold", cfg.compaction_threshold);
+            cfg.durability   = ParseDurability(s.value("durability", "on_sync"));
+            cfg.redundant    = s.value("redundancy", "none") == "ab";
+            cfg.mirror_path  = s.value("mirror_path", cfg.redundant ? cfg.base_path + "/.mirror" : "");
+            cfg.write_mode   = ParseWriteMode(s.value("write_mode", "write_through"));
+            cfg.value_encoding = ParseValueEncoding(s.value("value_encoding", "binary"));
+            if (s.contains("group_commit")) {
+                const auto& gc = s.at("group_commit");
+                cfg.group_commit = gc.value("enabled", true);
+                cfg.group_commit_max_latency_ms = gc.value("max_latency_ms", cfg.group_commit_max_latency_ms);
+            }
+            cfg.watch_external = s.value("watch_external_changes", false);
+            if (s.contains("io")) {
+                const auto& io = s.at("io");
+                cfg.io.priority      = ParseIoPriority(io.value("priority", "normal"));
+                cfg.io.bytes_per_sec = io.value("bytes_per_sec", uint64_t{0});
+                cfg.io.burst_bytes   = io.value("burst_bytes", uint64_t{0});
+                cfg.io.deadline      = std::chrono::milliseconds(io.value("deadline_ms", 0));
+            }
+            if (s.contains("compression")) {
+                const auto& c = s.at("compression");
+                cfg.compression.codec     = ParseCodec(c.value("codec", "lz4"));
+                cfg.compression.min_bytes = c.value("min_bytes", cfg.compression.min_bytes);
+                cfg.compression.level     = c.value("level", 0);
+            }
 
             // Minimal hardening: ensure directory exists
             std::error_code ec;
             fs::create_directories(cfg.base_path, ec);
 
-            map_.emplace(inst, std::move(cfg));
+            if (snap->by_instance.count(inst)) continue;   // first definition wins
+            auto e = std::make_unique<StorageEntry>();
+            e->instance = inst;
+            e->config   = std::move(cfg);
+            snap->by_instance.emplace(e->instance, e.get());
+            snap->entries.push_back(std::move(e));
+        }
+        if (j.contains("io_scheduler")) {
+            const auto& sched = j.at("io_scheduler");
+            io.device_bytes_per_sec = sched.value("device_bytes_per_sec", uint64_t{0});
+            io.device_burst_bytes   = sched.value("device_burst_bytes", uint64_t{0});
         }
     } catch (...) {
-        map_.clear();
         return ara::core::ErrorCode(ara::core::PersistencyErrc::kCorruption);
     }
 
-    inited_.store(true, std::memory_order_release);
+    // Two live back ends on one directory would corrupt it: an open storage
+    // stays the shared one, so its config may not change (or go) under it.
+    // The open locks are held until the new snapshot is out, so an open
+    // racing this either lands in the old entry before its handle is
+    // carried over or finds the new entry (see FindLocked).
+    const auto prev = std::atomic_load_explicit(&snapshot_, std::memory_order_relaxed);
+    std::vector<std::unique_lock<std::mutex>> open_locks;   // released before prev goes
+    if (prev) {
+        for (const auto& old : prev->entries) open_locks.emplace_back(old->open_mtx);
+        for (const auto& old : prev->entries) {
+            if (old->open_handle.expired()) continue;
+            auto it = snap->by_instance.find(old->instance);
+            if (it == snap->by_instance.end() || !SameConfig(old->config, it->second->config)) {
+                std::cerr << "[per] " << old->instance << " is open; not applying its changed config\n";
+                return ara::core::ErrorCode(ara::core::PersistencyErrc::kResourceBusy);
+            }
+            it->second->open_handle = old->open_handle;
+        }
+    }
+    IoScheduler::Instance().Configure(io);
+    for (const auto& e : snap->entries) IoScheduler::Instance().Register(e->instance, e->config.io);
+
+    // The previous snapshot goes once the last Find() result into it does
+    std::atomic_store_explicit(&snapshot_, std::shared_ptr<const Snapshot>(std::move(snap)),
+                               std::memory_order_release);
     return {};
 }
 
+std::shared_ptr<const StorageEntry> StorageRegistry::Find(std::string_view instance) const noexcept {
+    const auto snap = std::atomic_load_explicit(&snapshot_, std::memory_order_acquire);
+    if (!snap) return nullptr;
+    auto it = snap->by_instance.find(instance);
+    if (it == snap->by_instance.end()) return nullptr;
+    return std::shared_ptr<const StorageEntry>(snap, it->second);   // keeps the snapshot alive
+}
+
+StorageRegistry::LockedEntry StorageRegistry::FindLocked(std::string_view instance) const noexcept {
+    for (;;) {
+        LockedEntry found{Find(instance), {}};
+        if (!found.entry) return found;
+        found.lock = std::unique_lock<std::mutex>(found.entry->open_mtx);
+        if (Find(instance) == found.entry) return found;   // else: re-init in between
+    }
+}
+
 std::optional<StorageConfig> StorageRegistry::Lookup(const std::string& instance) const {
-    std::lock_guard<std::mutex> lock(mtx_);
-    auto it = map_.find(instance);
-    if (it == map_.end()) return std::nullopt;
-    return it->second;
+    const auto e = Find(instance);
+    if (!e) return std::nullopt;
+    return e->config;
+}
+
+bool StorageRegistry::IsInitialized() const noexcept {
+    return std::atomic_load_explicit(&snapshot_, std::memory_order_acquire) != nullptr;
 }
 
-void StorageRegistry::Clear() noexcept {
+// Same rule as InitFromFile: with no entry left, a later init would have no
+// handle to carry over and an open would start a second back end
+ara::core::Result<void> StorageRegistry::Clear() noexcept {
     std::lock_guard<std::mutex> lock(mtx_);
-    map_.clear();
-    inited_.store(false, std::memory_order_release);
+    const auto prev = std::atomic_load_explicit(&snapshot_, std::memory_order_relaxed);
+    std::vector<std::unique_lock<std::mutex>> open_locks;   // released before prev goes
+    if (prev) {
+        for (const auto& old : prev->entries) {
+            open_locks.emplace_back(old->open_mtx);
+            if (!old->open_handle.expired()) {
+                std::cerr << "[per] " << old->instance << " is open; not clearing the registry\n";
+                return ara::core::ErrorCode(ara::core::PersistencyErrc::kResourceBusy);
+            }
+        }
+    }
+    std::atomic_store_explicit(&snapshot_, std::shared_ptr<const Snapshot>(), std::memory_order_release);
+    return {};
 }
 
 } // namespace platform::persistency
@@ -0,0 +1,163 @@
+#include <persistency/undo_journal.hpp>
+#include <persistency/crc32c.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>      // open
+#include <sys/stat.h>
+#include <unistd.h>     // pread, pwrite, ftruncate, fsync, close, unlink
+
+using ara::core::ErrorCode;
+using ara::core::PersistencyErrc;
+
+namespace {
+
+constexpr uint32_t kUndoMagic   = 0x4F444E55;   // "UNDO"
+constexpr uint32_t kFlagExisted = 1;            // the write did not create the file
+
+struct UndoHeader {
+    uint32_t magic;
+    uint32_t crc;        // of everything after this field, saved bytes included
+    uint64_t ino;
+    uint64_t old_size;
+    uint64_t offset;
+    uint64_t new_len;
+    uint32_t new_crc;    // of the bytes being written
+    uint32_t flags;
+};
+constexpr size_t kCrcFrom = offsetof(UndoHeader, ino);
+
+// Reads until n bytes or EOF; bytes read, or -1 on error
+ssize_t pread_upto(int fd, void* buf, size_t n, uint64_t off) {
+    char* p = static_cast<char*>(buf);
+    size_t done = 0;
+    while (done < n) {
+        ssize_t r = ::pread(fd, p + done, n - done, static_cast<off_t>(off + done));
+        if (r < 0) { if (errno == EINTR) continue; return -1; }
+        if (r == 0) break;
+        done += static_cast<size_t>(r);
+    }
+    return static_cast<ssize_t>(done);
+}
+
+bool pwrite_all(int fd, const void* buf, size_t n, uint64_t off) {
+    const char* p = static_cast<const char*>(buf);
+    while (n > 0) {
+        ssize_t w = ::pwrite(fd, p, n, static_cast<off_t>(off));
+        if (w < 0) { if (errno == EINTR) continue; return false; }
+        p += w; n -= static_cast<size_t>(w); off += static_cast<uint64_t>(w);
+    }
+    return true;
+}
+
+uint32_t record_crc(const std::vector<uint8_t>& rec) {
+    return persistency::Crc32c(rec.data() + kCrcFrom, rec.size() - kCrcFrom);
+}
+
+} // namespace
+
+namespace persistency {
+
+ara::core::Result<void> WriteUndoRecord(const std::string& journal, int target_fd, bool target_existed,
+                                        uint64_t offset, ara::core::Span<const uint8_t> data,
+                                        bool& created) noexcept {
+    struct stat st{};
+    if (::fstat(target_fd, &st) != 0) return ErrorCode(PersistencyErrc::kUnknown);
+    const auto old_size = static_cast<uint64_t>(st.st_size);
+    const uint64_t saved = offset < old_size ? std::min<uint64_t>(data.size(), old_size - offset) : 0;
+
+    UndoHeader h{};
+    h.magic    = kUndoMagic;
+    h.ino      = static_cast<uint64_t>(st.st_ino);
+    h.old_size = old_size;
+    h.offset   = offset;
+    h.new_len  = data.size();
+    h.new_crc  = Crc32c(data.data(), data.size());
+    h.flags    = target_existed ? kFlagExisted : 0;
+
+    std::vector<uint8_t> rec(sizeof(UndoHeader) + saved);
+    if (pread_upto(target_fd, rec.data() + sizeof(UndoHeader), saved, offset) != static_cast<ssize_t>(saved)) {
+        return ErrorCode(PersistencyErrc::kUnknown);
+    }
+    std::memcpy(rec.data(), &h, sizeof h);
+    h.crc = record_crc(rec);
+    std::memcpy(rec.data(), &h, sizeof h);
+
+    // A torn record fails its CRC and is ignored, which is right: the file
+    // is not touched before this returns
+    created = false;
+    int fd = ::open(journal.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+    if (fd < 0 && errno == ENOENT) {
+        fd = ::open(journal.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        created = fd >= 0;
+    }
+    if (fd < 0) return ErrorCode(PersistencyErrc::kUnknown);
+    const bool ok = pwrite_all(fd, rec.data(), rec.size(), 0) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok) return ErrorCode(PersistencyErrc::kUnknown);
+    return {};
+}
+
+ara::core::Result<UndoOutcome> RecoverUndoJournal(const std::string& journal, const std::string& target) noexcept {
+    auto discard = [&]() -> ara::core::Result<UndoOutcome> {
+        ::unlink(journal.c_str());
+        return UndoOutcome::Discarded;
+    };
+
+    std::vector<uint8_t> rec;
+    {
+        int fd = ::open(journal.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return errno == ENOENT ? ara::core::Result<UndoOutcome>(UndoOutcome::Discarded)
+                                           : ErrorCode(PersistencyErrc::kUnknown);
+        struct stat st{};
+        if (::fstat(fd, &st) == 0) {
+            rec.resize(static_cast<size_t>(st.st_size));
+            if (pread_upto(fd, rec.data(), rec.size(), 0) != static_cast<ssize_t>(rec.size())) rec.clear();
+        }
+        ::close(fd);
+    }
+    UndoHeader h{};
+    if (rec.size() < sizeof h) return discard();
+    std::memcpy(&h, rec.data(), sizeof h);
+    const uint64_t saved = rec.size() - sizeof h;
+    if (h.magic != kUndoMagic || h.crc != record_crc(rec) ||
+        saved != (h.offset < h.old_size ? std::min(h.new_len, h.old_size - h.offset) : 0)) {
+        return discard();   // torn record: the file was never touched
+    }
+
+    int fd = ::open(target.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) return discard();   // removed since
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_ino) != h.ino) {
+        ::close(fd);
+        return discard();           // replaced since
+    }
+
+    // Finished: the new bytes are all there
+    if (static_cast<uint64_t>(st.st_size) >= h.offset + h.new_len) {
+        std::vector<uint8_t> range(h.new_len);
+        if (pread_upto(fd, range.data(), range.size(), h.offset) == static_cast<ssize_t>(range.size()) &&
+            Crc32c(range.data(), range.size()) == h.new_crc) {
+            ::close(fd);
+            return discard();
+        }
+    }
+
+    if (!(h.flags & kFlagExisted)) {
+        ::close(fd);
+        ::unlink(target.c_str());
+        ::unlink(journal.c_str());
+        return UndoOutcome::RolledBack;
+    }
+    const bool ok = pwrite_all(fd, rec.data() + sizeof h, saved, h.offset) &&
+                    ::ftruncate(fd, static_cast<off_t>(h.old_size)) == 0 && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok) return ErrorCode(PersistencyErrc::kUnknown);   // journal kept for the next attempt
+    ::unlink(journal.c_str());
+    return UndoOutcome::RolledBack;
+}
+
+} // namespace persistency
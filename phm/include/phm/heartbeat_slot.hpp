@@ -0,0 +1,80 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace phm {
+
+// Env var through which the EM hands an app its heartbeat slot's descriptor
+inline constexpr const char* kHeartbeatFdEnv = "ARA_PHM_SHM_FD";
+
+// Supervision reports of one local app in a shared memory segment (memfd):
+// an alive counter and a ring of timestamped checkpoints. The app reports
+// with an atomic increment and a few stores, without entering the kernel;
+// the EM's supervisor drains the slot when it evaluates a cycle or a
+// deadline. Timestamps are steady_clock (CLOCK_MONOTONIC), the same clock
+// in every process, so deadlines are judged by when the app reported, not
+// when the EM looked.
+//
+// One reader (the supervisor) per slot; any number of writer threads.
+class HeartbeatSlot {
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr std::size_t kDefaultRing = 64;
+    // How long a claimed entry may stay unpublished before drain takes its
+    // writer for dead; a preempted writer can take a while
+    static constexpr std::chrono::milliseconds kStallLimit{1000};
+
+    struct Checkpoint {
+        std::uint32_t id;
+        Clock::time_point at;
+    };
+
+    // EM side: a fresh segment. Null on failure (or without memfd).
+    static std::shared_ptr<HeartbeatSlot> create(const std::string& name,
+                                                 std::size_t ring = kDefaultRing);
+    // App side: map a segment inherited from the EM; takes ownership of fd,
+    // which is closed if it does not hold a valid slot
+    static std::shared_ptr<HeartbeatSlot> attach(int fd);
+    // The slot named by kHeartbeatFdEnv; null if the app was not given one
+    static std::shared_ptr<HeartbeatSlot> from_environment();
+
+    ~HeartbeatSlot();
+    HeartbeatSlot(const HeartbeatSlot&) = delete;
+    HeartbeatSlot& operator=(const HeartbeatSlot&) = delete;
+
+    int fd() const noexcept { return fd_; }
+
+    // Writer side
+    void report_alive() noexcept;
+    void report_checkpoint(std::uint32_t id) noexcept;
+
+    // Reader side: appends the checkpoints published since the last call,
+    // oldest first; true if an alive was reported since then. `lost` counts
+    // checkpoints overwritten before they were drained (or left half
+    // written by a writer that died).
+    bool drain(std::vector<Checkpoint>& out, std::uint64_t& lost);
+
+private:
+    struct Header;
+    struct Entry;
+
+    HeartbeatSlot(int fd, void* base, std::size_t bytes) : fd_(fd), base_(base), bytes_(bytes) {}
+    Header* hdr() const noexcept;
+    Entry* entry(std::uint64_t idx) const noexcept;
+
+    int fd_;
+    void* base_;
+    std::size_t bytes_;
+    // Reader state; the counters in the segment only ever grow, also across
+    // a relaunch of the app
+    std::uint64_t alive_seen_{0};
+    std::uint64_t tail_{0};                      // next checkpoint to drain
+    std::uint64_t stalled_at_{UINT64_MAX};       // unpublished at the last drain
+    Clock::time_point stalled_since_{};          // when stalled_at_ was first seen
+};
+
+} // namespace phm
@@ -1,7 +1,20 @@
 #pragma once
 #include <chrono>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
 #include <vector>
+#include <phm/heartbeat_slot.hpp>
+#include <phm/timer_wheel.hpp>
+
+// Alive, checkpoint, logical and deadline supervision of one entity.
+// Reports may come from any thread, or from a phm::HeartbeatSlot in shared
+// memory that is drained whenever a cycle or a deadline is evaluated.
+// Cycles end either on maintenance_tick() polls or, once attached, exactly
+// on time from a phm::TimerWheel.
 
 class PhmSupervisor {
 public:
@@ -14,24 +27,89 @@ public:
         int backoff_max_ms{15000};
         int retry_reset_window_ms{60000};
         std::vector<std::uint32_t> required_checkpoints{};
+        // Logical supervision: consecutive checkpoints must follow one of
+        // these (from, to) edges. A run of the graph starts at an initial
+        // checkpoint (any of the graph's if none are given) and ends after
+        // a final one. No edges: logical supervision is off.
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> allowed_transitions{};
+        std::vector<std::uint32_t> initial_checkpoints{};
+        std::vector<std::uint32_t> final_checkpoints{};
+        // Deadline supervision: checkpoint `to` must follow `from` after at
+        // least min_ms and at most max_ms (0: no upper bound)
+        struct Deadline {
+            std::uint32_t from;
+            std::uint32_t to;
+            int min_ms{0};
+            int max_ms{0};
+        };
+        std::vector<Deadline> deadlines{};
     };
 
     PhmSupervisor() = default;                               // default ctor
-    explicit PhmSupervisor(const Config& cfg) : cfg_(cfg) {} // NO default arg here
+    explicit PhmSupervisor(const Config& cfg);               // NO default arg here
+    ~PhmSupervisor();                                        // detaches
+    PhmSupervisor(const PhmSupervisor&) = delete;
+    PhmSupervisor& operator=(const PhmSupervisor&) = delete;
 
     void on_alive();
     void on_checkpoint(std::uint32_t id);
+    // Polling mode: ends the cycle once it is over and checks the deadlines.
+    // A no-op once attached.
     void maintenance_tick();
+    // Cycle ends and deadline expiries run as timers on `wheel` from now on;
+    // the wheel must outlive the supervisor
+    void attach(phm::TimerWheel& wheel);
+    // The entity also reports through `slot`; a deadline's start is only seen
+    // when the slot is drained, so a missed max is found at most one cycle late
+    void attach_heartbeat(std::shared_ptr<phm::HeartbeatSlot> slot);
     void set_violation_callback(std::function<void(const char* reason)> cb) { on_violation_ = std::move(cb); }
     
 private:
-    static bool contains_all(const std::vector<std::uint32_t>& have,
-                             const std::vector<std::uint32_t>& need);
+    using Clock = std::chrono::steady_clock;
+    using Reasons = std::vector<const char*>;   // violations, reported once mtx_ is released
+    static constexpr int kNoCheckpoint = -1;
+    int index_of(std::uint32_t id) const;   // dense index, kNoCheckpoint if not configured
+    int index_or_add(std::uint32_t id);
+    // at == {}: now, read only if a deadline needs it. Expects mtx_ held.
+    void checkpoint_(std::size_t cp, Clock::time_point at);
+    void drain_heartbeat_();   // expects mtx_ held
+    void end_cycle_(Clock::time_point now, Reasons& out);
+    void schedule_cycle_end_(Clock::time_point at);
+    void deadline_expired_(std::size_t d, Clock::time_point started);
+    void report_(const Reasons& reasons);
 
     Config cfg_{};  // keep a default-initialized copy here
-    std::chrono::steady_clock::time_point cycle_start_{};
+    std::mutex mtx_;   // reports vs. cycle ends and timers
+    phm::TimerWheel* wheel_{nullptr};
+    phm::TimerWheel::TimerId cycle_timer_{0};
+    std::shared_ptr<phm::HeartbeatSlot> heartbeat_{};
+    std::vector<phm::HeartbeatSlot::Checkpoint> drained_{};   // reused buffer
+    Clock::time_point cycle_start_{};
     bool got_alive_{false};
-    std::vector<std::uint32_t> seen_cps_{};
+
+    // Every configured checkpoint id has a dense index, assigned once in the
+    // ctor; the sets below are bitsets of words_ words over those indices,
+    // so a report costs a lookup and a bit, a cycle check O(words_).
+    std::unordered_map<std::uint32_t, int> index_{};
+    std::size_t words_{0};
+    std::vector<std::uint64_t> required_{};
+    std::vector<std::uint64_t> seen_{};         // this cycle
+    std::vector<std::uint64_t> in_graph_{};
+    std::vector<std::uint64_t> initial_{};
+    std::vector<std::uint64_t> final_{};
+    std::vector<std::uint64_t> transitions_{};  // row per checkpoint: its allowed successors
+    int last_cp_{kNoCheckpoint};                // position in the graph; none: not started
+    bool logical_failed_{false};                // reported at the end of the cycle
+
+    // Deadlines by checkpoint index; a deadline is armed while started is set
+    struct ArmedDeadline {
+        Clock::time_point started{};
+        phm::TimerWheel::TimerId timer{0};
+    };
+    std::vector<std::vector<std::size_t>> deadlines_from_{};
+    std::vector<std::vector<std::size_t>> deadlines_to_{};
+    std::vector<ArmedDeadline> armed_{};
+    bool deadline_failed_{false};               // reported at the end of the cycle
     int missed_cycles_{0};
     int retries_{0};
     std::chrono::steady_clock::time_point last_healthy_{};
@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace phm {
+
+// Hierarchical timer wheel: 4 levels of 64 slots, level 0 one tick per
+// slot, each further level 64 times coarser (~4.6 h ahead at a 1 ms tick;
+// later timers are parked at the far end and re-filed when it comes up).
+// Scheduling and cancelling cost O(1); advance() only visits ticks that
+// hold timers and the slot boundaries where a coarser slot is re-filed, so
+// many idle timers cost nothing between expiries.
+//
+// schedule() and cancel() may be called from any thread, also from a
+// callback; advance() runs the callbacks on the caller's thread, without
+// the lock held. A timer cancelled while advance() is running it may still
+// run once.
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimerId = std::uint64_t;   // 0: no timer
+
+    explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(1),
+                        Clock::time_point start = Clock::now());
+
+    // Runs fn at the first advance() at or after `when` (rounded up to the tick)
+    TimerId schedule(Clock::time_point when, std::function<void()> fn);
+    bool cancel(TimerId id);
+
+    // Runs every timer due by `now`, in expiry order; returns how many ran.
+    // What the callbacks schedule at or before `now` runs on the next call.
+    std::size_t advance(Clock::time_point now);
+
+    // Never later than the earliest timer; earlier only when that timer
+    // sits in a coarse slot (then: when the slot is re-filed). max(): none.
+    Clock::time_point next_expiry() const;
+    std::size_t size() const;
+
+    // Called, without the lock, when schedule() adds a timer earlier than
+    // the last next_expiry() promised, so a thread sleeping until then can
+    // wake up and ask again
+    void set_wakeup(std::function<void()> fn);
+
+private:
+    static constexpr int kLevels = 4;
+    static constexpr int kBits = 6;
+    static constexpr std::uint64_t kSlots = 1u << kBits;
+
+    struct Entry {
+        std::uint64_t tick;
+        std::function<void()> fn;
+    };
+
+    void place_(TimerId id, std::uint64_t tick);   // expects mtx_ held
+    void take_slot_(int level, std::uint64_t slot, std::vector<TimerId>& out);
+
+    const Clock::duration tick_;
+    const Clock::time_point origin_;
+    mutable std::mutex mtx_;
+    std::uint64_t now_tick_{0};                         // last tick advanced over
+    mutable std::uint64_t promised_tick_{UINT64_MAX};   // last next_expiry() answer
+    TimerId next_id_{0};
+    std::unordered_map<TimerId, Entry> entries_;        // cancelled timers are gone here only
+    std::vector<TimerId> slots_[kLevels][kSlots];
+    std::uint64_t occupied_[kLevels]{};                 // bit per non-empty slot
+    std::vector<TimerId> due_;                          // scheduled at or before now_tick_
+    std::function<void()> wakeup_;
+};
+
+} // namespace phm
@@ -0,0 +1,183 @@
+#include <phm/heartbeat_slot.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(__linux__)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace {
+constexpr std::uint32_t kMagic   = 0x50484D48; // "PHMH"
+constexpr std::uint32_t kVersion = 1;
+} // namespace
+
+namespace phm {
+
+// alive and head sit on their own cache line, away from the EM's reads of
+// the ring
+struct HeartbeatSlot::Header {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t ring;
+    std::uint32_t entry_bytes;
+    alignas(64) std::atomic<std::uint64_t> alive;
+    std::atomic<std::uint64_t> head;   // next checkpoint number to claim
+    char pad[64 - 16];
+};
+
+// seq is 0 while an entry is being written, checkpoint number + 1 once
+// published. All fields are atomics, so a reader racing a writer that laps
+// it reads a stale or a new value, never a torn one, and the seq re-check
+// tells which.
+struct HeartbeatSlot::Entry {
+    std::atomic<std::uint64_t> seq;
+    std::atomic<std::uint64_t> at_ns;
+    std::atomic<std::uint64_t> id;
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "heartbeat slot needs address-free 64-bit atomics");
+
+HeartbeatSlot::Header* HeartbeatSlot::hdr() const noexcept {
+    return static_cast<Header*>(base_);
+}
+
+HeartbeatSlot::Entry* HeartbeatSlot::entry(std::uint64_t idx) const noexcept {
+    auto* first = reinterpret_cast<Entry*>(static_cast<char*>(base_) + sizeof(Header));
+    return first + (idx % hdr()->ring);
+}
+
+std::shared_ptr<HeartbeatSlot> HeartbeatSlot::create(const std::string& name, std::size_t ring) {
+#if defined(__linux__)
+    if (ring == 0) return nullptr;
+    const std::size_t bytes = sizeof(Header) + ring * sizeof(Entry);
+    int fd = ::memfd_create(("phm:" + name).c_str(), MFD_CLOEXEC);
+    if (fd < 0) return nullptr;
+    if (::ftruncate(fd, static_cast<off_t>(bytes)) != 0) { ::close(fd); return nullptr; }
+    void* base = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) { ::close(fd); return nullptr; }
+
+    // Fresh memfd pages are zero-filled: no alive, no checkpoints
+    auto* h = new (base) Header{};
+    h->magic       = kMagic;
+    h->version     = kVersion;
+    h->ring        = static_cast<std::uint32_t>(ring);
+    h->entry_bytes = static_cast<std::uint32_t>(sizeof(Entry));
+    h->head.store(0, std::memory_order_release);
+    return std::shared_ptr<HeartbeatSlot>(new HeartbeatSlot(fd, base, bytes));
+#else
+    (void)name; (void)ring;
+    return nullptr;
+#endif
+}
+
+std::shared_ptr<HeartbeatSlot> HeartbeatSlot::attach(int fd) {
+#if defined(__linux__)
+    struct stat st{};
+    if (fd < 0) return nullptr;
+    if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Header)) {
+        ::close(fd);
+        return nullptr;
+    }
+    const std::size_t bytes = static_cast<std::size_t>(st.st_size);
+    void* base = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) { ::close(fd); return nullptr; }
+
+    auto* h = static_cast<const Header*>(base);
+    if (h->magic != kMagic || h->version != kVersion || h->entry_bytes != sizeof(Entry) ||
+        h->ring == 0 || sizeof(Header) + std::size_t{h->ring} * sizeof(Entry) > bytes) {
+        ::munmap(base, bytes);
+        ::close(fd);
+        return nullptr;
+    }
+    // Don't leak the segment into our own children
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return std::shared_ptr<HeartbeatSlot>(new HeartbeatSlot(fd, base, bytes));
+#else
+    (void)fd;
+    return nullptr;
+#endif
+}
+
+std::shared_ptr<HeartbeatSlot> HeartbeatSlot::from_environment() {
+    const char* env = std::getenv(kHeartbeatFdEnv);
+    if (!env || !*env) return nullptr;
+    char* end = nullptr;
+    long fd = std::strtol(env, &end, 10);
+    if (end == env || fd < 0) return nullptr;
+    return attach(static_cast<int>(fd));
+}
+
+HeartbeatSlot::~HeartbeatSlot() {
+#if defined(__linux__)
+    if (base_) ::munmap(base_, bytes_);
+    if (fd_ >= 0) ::close(fd_);
+#endif
+}
+
+void HeartbeatSlot::report_alive() noexcept {
+    hdr()->alive.fetch_add(1, std::memory_order_release);
+}
+
+void HeartbeatSlot::report_checkpoint(std::uint32_t id) noexcept {
+    const auto at = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+    const std::uint64_t idx = hdr()->head.fetch_add(1, std::memory_order_relaxed);
+    Entry* e = entry(idx);
+
+    e->seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e->at_ns.store(static_cast<std::uint64_t>(at), std::memory_order_relaxed);
+    e->id.store(id, std::memory_order_relaxed);
+    e->seq.store(idx + 1, std::memory_order_release);
+}
+
+bool HeartbeatSlot::drain(std::vector<Checkpoint>& out, std::uint64_t& lost) {
+    const std::uint64_t alive = hdr()->alive.load(std::memory_order_acquire);
+    const bool got_alive = alive != alive_seen_;
+    alive_seen_ = alive;
+
+    const std::uint64_t head = hdr()->head.load(std::memory_order_acquire);
+    const std::uint64_t ring = hdr()->ring;
+    if (head - tail_ > ring) {   // lapped: the oldest are gone
+        lost += head - tail_ - ring;
+        tail_ = head - ring;
+    }
+    while (tail_ < head) {
+        const Entry* e = entry(tail_);
+        const std::uint64_t seq = e->seq.load(std::memory_order_acquire);
+        if (seq == tail_ + 1) {
+            const std::uint64_t at_ns = e->at_ns.load(std::memory_order_relaxed);
+            const std::uint64_t id = e->id.load(std::memory_order_relaxed);
+            // Overwritten by a writer that lapped us while we copied?
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (e->seq.load(std::memory_order_relaxed) == tail_ + 1) {
+                out.push_back({static_cast<std::uint32_t>(id),
+                               Clock::time_point(std::chrono::nanoseconds(at_ns))});
+            } else {
+                ++lost;
+            }
+        } else if (seq > tail_ + 1) {
+            ++lost;   // lapped since the head was read
+        } else {
+            // Claimed but not yet published. A writer needs nanoseconds for
+            // that unless it is preempted, so only one stuck for
+            // kStallLimit died.
+            const auto now = Clock::now();
+            if (stalled_at_ != tail_) {
+                stalled_at_ = tail_;
+                stalled_since_ = now;
+            }
+            if (now - stalled_since_ < kStallLimit) break;
+            ++lost;
+        }
+        ++tail_;
+    }
+    return got_alive;
+}
+
+} // namespace phm
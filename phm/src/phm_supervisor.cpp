@@ -2,56 +2,291 @@
 #include <cmath>
 #include <iostream>
 #include <phm/phm_supervisor.hpp>
+#include "rate_limiter.hpp"
+
+namespace {
+
+bool test_bit(const std::vector<std::uint64_t>& bits, std::size_t i) {
+    return (bits[i / 64] >> (i % 64)) & 1u;
+}
+
+void set_bit(std::vector<std::uint64_t>& bits, std::size_t i) {
+    bits[i / 64] |= std::uint64_t{1} << (i % 64);
+}
+
+} // namespace
+
+PhmSupervisor::PhmSupervisor(const Config& cfg) : cfg_(cfg) {
+    for (auto id : cfg_.required_checkpoints) index_or_add(id);
+    for (const auto& [from, to] : cfg_.allowed_transitions) {
+        index_or_add(from);
+        index_or_add(to);
+    }
+    for (const auto& d : cfg_.deadlines) {
+        index_or_add(d.from);
+        index_or_add(d.to);
+    }
+    const std::size_t n = index_.size();
+    words_ = (n + 63) / 64;
+    required_.assign(words_, 0);
+    seen_.assign(words_, 0);
+    in_graph_.assign(words_, 0);
+    initial_.assign(words_, 0);
+    final_.assign(words_, 0);
+    transitions_.assign(n * words_, 0);   // n rows of words_ words
+
+    for (auto id : cfg_.required_checkpoints) set_bit(required_, index_of(id));
+    for (const auto& [from, to] : cfg_.allowed_transitions) {
+        const auto f = static_cast<std::size_t>(index_of(from));
+        const auto t = static_cast<std::size_t>(index_of(to));
+        set_bit(in_graph_, f);
+        set_bit(in_graph_, t);
+        set_bit(transitions_, f * words_ * 64 + t);
+    }
+    // Initial and final checkpoints outside the graph can never be reported
+    // in it; they are ignored
+    auto graph_subset = [this](const std::vector<std::uint32_t>& ids, std::vector<std::uint64_t>& out) {
+        for (auto id : ids) {
+            const int i = index_of(id);
+            if (i != kNoCheckpoint && test_bit(in_graph_, static_cast<std::size_t>(i))) {
+                set_bit(out, static_cast<std::size_t>(i));
+            }
+        }
+    };
+    if (cfg_.initial_checkpoints.empty()) initial_ = in_graph_;
+    else graph_subset(cfg_.initial_checkpoints, initial_);
+    graph_subset(cfg_.final_checkpoints, final_);
+
+    deadlines_from_.resize(n);
+    deadlines_to_.resize(n);
+    armed_.resize(cfg_.deadlines.size());
+    for (std::size_t d = 0; d < cfg_.deadlines.size(); ++d) {
+        deadlines_from_[static_cast<std::size_t>(index_of(cfg_.deadlines[d].from))].push_back(d);
+        deadlines_to_[static_cast<std::size_t>(index_of(cfg_.deadlines[d].to))].push_back(d);
+    }
+}
+
+// A timer already taken by advance() on another thread may still run; the
+// EM destroys its supervisors on the thread that advances the wheel
+PhmSupervisor::~PhmSupervisor() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!wheel_) return;
+    wheel_->cancel(cycle_timer_);
+    for (const auto& a : armed_) {
+        if (a.timer) wheel_->cancel(a.timer);
+    }
+}
+
+int PhmSupervisor::index_of(std::uint32_t id) const {
+    auto it = index_.find(id);
+    return it == index_.end() ? kNoCheckpoint : it->second;
+}
+
+int PhmSupervisor::index_or_add(std::uint32_t id) {
+    return index_.emplace(id, static_cast<int>(index_.size())).first->second;
+}
+
+void PhmSupervisor::report_(const Reasons& reasons) {
+    for (const char* r : reasons) {
+        if (on_violation_) on_violation_(r);
+    }
+}
 
 void PhmSupervisor::on_alive() {
+    std::lock_guard<std::mutex> lock(mtx_);
     got_alive_ = true;
 }
 
 void PhmSupervisor::on_checkpoint(std::uint32_t id) {
-    seen_cps_.push_back(id);
+    const int i = index_of(id);
+    if (i == kNoCheckpoint) return;   // not supervised
+    std::lock_guard<std::mutex> lock(mtx_);
+    checkpoint_(static_cast<std::size_t>(i), Clock::time_point{});
 }
 
-bool PhmSupervisor::contains_all(const std::vector<std::uint32_t>& have,
-                                 const std::vector<std::uint32_t>& need) {
-    if (need.empty()) return true;
-    for (auto n : need) {
-        if (std::find(have.begin(), have.end(), n) == have.end())
-            return false;
+void PhmSupervisor::attach_heartbeat(std::shared_ptr<phm::HeartbeatSlot> slot) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    heartbeat_ = std::move(slot);
+}
+
+void PhmSupervisor::drain_heartbeat_() {
+    if (!heartbeat_) return;
+    drained_.clear();
+    std::uint64_t lost = 0;
+    if (heartbeat_->drain(drained_, lost)) got_alive_ = true;
+    for (const auto& c : drained_) {
+        const int i = index_of(c.id);
+        if (i != kNoCheckpoint) checkpoint_(static_cast<std::size_t>(i), c.at);
+    }
+    if (lost) {
+        static ara::log::RateLimiter lost_rl{5, 1};
+        uint32_t suppressed = 0;
+        if (lost_rl.Allow(suppressed)) {
+            if (suppressed) std::cerr << "[PHM] suppressed " << suppressed << " similar messages\n";
+            std::cerr << "[PHM] " << lost << " checkpoint reports overran the heartbeat ring\n";
+        }
     }
-    return true;
 }
 
-void PhmSupervisor::maintenance_tick() {
-    const auto now = std::chrono::steady_clock::now();
+void PhmSupervisor::checkpoint_(std::size_t cp, Clock::time_point at) {
+    const int i = static_cast<int>(cp);
+    set_bit(seen_, cp);
 
-    if (cycle_start_.time_since_epoch().count() == 0) {
-        cycle_start_ = now;
-        last_healthy_ = now;
+    // Deadlines: only checkpoints that take part read the clock. A pair's
+    // end is checked before its start is re-armed, so from == to works.
+    if (!deadlines_from_[cp].empty() || !deadlines_to_[cp].empty()) {
+        const auto now = at != Clock::time_point{} ? at : Clock::now();
+        for (std::size_t d : deadlines_to_[cp]) {
+            auto& a = armed_[d];
+            if (a.started == Clock::time_point{}) continue;   // no start seen
+            const auto& dl = cfg_.deadlines[d];
+            const auto elapsed = now - a.started;
+            if (elapsed < std::chrono::milliseconds(dl.min_ms) ||
+                (dl.max_ms > 0 && elapsed > std::chrono::milliseconds(dl.max_ms))) {
+                deadline_failed_ = true;
+            }
+            if (a.timer) wheel_->cancel(a.timer);
+            a = ArmedDeadline{};
+        }
+        for (std::size_t d : deadlines_from_[cp]) {
+            auto& a = armed_[d];
+            if (a.timer) wheel_->cancel(a.timer);
+            a = ArmedDeadline{now, 0};
+            const int max_ms = cfg_.deadlines[d].max_ms;
+            if (wheel_ && max_ms > 0) {
+                a.timer = wheel_->schedule(now + std::chrono::milliseconds(max_ms),
+                                           [this, d, now] { deadline_expired_(d, now); });
+            }
+        }
+    }
+
+    if (!test_bit(in_graph_, cp)) return;
+
+    const bool allowed = last_cp_ == kNoCheckpoint
+        ? test_bit(initial_, cp)
+        : test_bit(transitions_, static_cast<std::size_t>(last_cp_) * words_ * 64 + cp);
+    if (!allowed) {
+        logical_failed_ = true;
+        last_cp_ = test_bit(initial_, cp) ? i : kNoCheckpoint;   // may start the next run
         return;
     }
+    last_cp_ = test_bit(final_, cp) ? kNoCheckpoint : i;
+}
 
-    const auto cycle_len = std::chrono::milliseconds(cfg_.supervision_cycle_ms);
-    if ((now - cycle_start_) >= cycle_len) {
-        const bool cps_ok = contains_all(seen_cps_, cfg_.required_checkpoints);
-        const bool alive_ok = cfg_.required_checkpoints.empty() ? got_alive_ : (got_alive_ && cps_ok);
+void PhmSupervisor::maintenance_tick() {
+    Reasons reasons;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (wheel_) return;   // the wheel ends the cycles
+        drain_heartbeat_();
+        const auto now = Clock::now();
 
-        if (alive_ok) {
-            missed_cycles_ = 0;
+        if (cycle_start_.time_since_epoch().count() == 0) {
+            cycle_start_ = now;
             last_healthy_ = now;
-        } else {
-            missed_cycles_++;
-            std::cerr << "[PHM] Missed supervision cycle " << missed_cycles_ << "\n";
-            if (missed_cycles_ > cfg_.allowed_missed_cycles) {
-                // Here we could trigger a controlled restart + backoff.
-                // For now, just set violation:
-                if (on_violation_) on_violation_("supervision violation");
-                missed_cycles_ = 0;
+            return;
+        }
+
+        // Without a wheel a missing end is noticed on the next poll
+        for (std::size_t d = 0; d < armed_.size(); ++d) {
+            const int max_ms = cfg_.deadlines[d].max_ms;
+            if (max_ms > 0 && armed_[d].started != Clock::time_point{} &&
+                now - armed_[d].started > std::chrono::milliseconds(max_ms)) {
+                armed_[d] = ArmedDeadline{};
+                reasons.push_back("deadline supervision violation");
             }
         }
 
-        // start next cycle
-        cycle_start_ = now;
-        got_alive_ = false;
-        seen_cps_.clear();
+        const auto cycle_len = std::chrono::milliseconds(cfg_.supervision_cycle_ms);
+        if ((now - cycle_start_) >= cycle_len) end_cycle_(now, reasons);
+    }
+    report_(reasons);
+}
+
+void PhmSupervisor::attach(phm::TimerWheel& wheel) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    wheel_ = &wheel;
+    const auto now = Clock::now();
+    cycle_start_ = now;
+    last_healthy_ = now;
+    schedule_cycle_end_(now + std::max(std::chrono::milliseconds(cfg_.supervision_cycle_ms),
+                                       std::chrono::milliseconds(1)));
+    for (std::size_t d = 0; d < armed_.size(); ++d) {
+        const auto started = armed_[d].started;
+        const int max_ms = cfg_.deadlines[d].max_ms;
+        if (started == Clock::time_point{} || max_ms <= 0) continue;
+        armed_[d].timer = wheel_->schedule(started + std::chrono::milliseconds(max_ms),
+                                           [this, d, started] { deadline_expired_(d, started); });
+    }
+}
+
+// Cycles follow each other without drift: each one is timed from where the
+// previous one was due, not from when its timer happened to run
+void PhmSupervisor::schedule_cycle_end_(Clock::time_point at) {
+    cycle_timer_ = wheel_->schedule(at, [this, at] {
+        Reasons reasons;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            end_cycle_(at, reasons);
+            const auto cycle_len = std::max(std::chrono::milliseconds(cfg_.supervision_cycle_ms),
+                                            std::chrono::milliseconds(1));
+            schedule_cycle_end_(at + cycle_len);
+        }
+        report_(reasons);
+    });
+}
+
+void PhmSupervisor::deadline_expired_(std::size_t d, Clock::time_point started) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        drain_heartbeat_();   // the end may be waiting in the ring
+        if (armed_[d].started != started) return;   // ended or re-armed meanwhile
+        armed_[d] = ArmedDeadline{};
+    }
+    if (on_violation_) on_violation_("deadline supervision violation");
+}
+
+void PhmSupervisor::end_cycle_(Clock::time_point now, Reasons& out) {
+    drain_heartbeat_();
+    bool cps_ok = true;
+    for (std::size_t w = 0; w < words_; ++w) {
+        if ((seen_[w] & required_[w]) != required_[w]) cps_ok = false;
+    }
+    const bool alive_ok = cfg_.required_checkpoints.empty() ? got_alive_ : (got_alive_ && cps_ok);
+
+    // A wrong transition or a broken deadline is not a late report: no
+    // missed cycles are tolerated for it
+    if (logical_failed_) {
+        logical_failed_ = false;
+        out.push_back("logical supervision violation");
+    }
+    if (deadline_failed_) {
+        deadline_failed_ = false;
+        out.push_back("deadline supervision violation");
     }
+
+    if (alive_ok) {
+        missed_cycles_ = 0;
+        last_healthy_ = now;
+    } else {
+        missed_cycles_++;
+        // Shared by all supervisors; keeps a misbehaving fleet from flooding stderr
+        static ara::log::RateLimiter missed_rl{5, 1};
+        uint32_t suppressed = 0;
+        if (missed_rl.Allow(suppressed)) {
+            if (suppressed) std::cerr << "[PHM] suppressed " << suppressed << " similar messages\n";
+            std::cerr << "[PHM] Missed supervision cycle " << missed_cycles_ << "\n";
+        }
+        if (missed_cycles_ > cfg_.allowed_missed_cycles) {
+            // Here we could trigger a controlled restart + backoff.
+            // For now, just set violation:
+            out.push_back("supervision violation");
+            missed_cycles_ = 0;
+        }
+    }
+
+    // start next cycle
+    cycle_start_ = now;
+    got_alive_ = false;
+    std::fill(seen_.begin(), seen_.end(), 0);
 }
\ No newline at end of file
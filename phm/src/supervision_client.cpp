@@ -1,24 +1,39 @@
 #include <ara/phm/supervision_client.hpp>
 #include "someip_binding.hpp"
+#include <phm/heartbeat_slot.hpp>
 #include <phm/phm_ids.hpp>
 #include <arpa/inet.h> // htonl
+#include <cstdlib>     // unsetenv
 
 using namespace ara::phm;
 
 SupervisionClient::SupervisionClient(const std::string& app_name)
-    : app_name_(app_name) {
+    : app_name_(app_name), slot_(::phm::HeartbeatSlot::from_environment()) {
+    // The slot now owns the fd; children we spawn must not attach to it
+    ::unsetenv(::phm::kHeartbeatFdEnv);
     someip::init(app_name_); // creates & starts vsomeip app thread
 }
 
+SupervisionClient::~SupervisionClient() = default;
+
 void SupervisionClient::Connect() {
+    if (slot_) return;
     someip::request_service(phm_ids::kService, phm_ids::kInstance);
 }
 
 void SupervisionClient::ReportAlive() noexcept {
+    if (slot_) {
+        slot_->report_alive();
+        return;
+    }
     someip::send_request(phm_ids::kService, phm_ids::kInstance, phm_ids::kAlive, "");
 }
 
 void SupervisionClient::ReportCheckpoint(std::uint32_t id) noexcept {
+    if (slot_) {
+        slot_->report_checkpoint(id);
+        return;
+    }
     std::uint32_t net = htonl(id);
     const char* p = reinterpret_cast<const char*>(&net);
     std::string payload(p, p + sizeof(net));
@@ -0,0 +1,163 @@
+#include <phm/timer_wheel.hpp>
+#include <algorithm>
+
+namespace {
+
+// Lowest set bit of `bits` counting from bit `from` upwards and wrapping;
+// the distance (1..64) from `from - 1`, i.e. 1 for bit `from` itself
+int distance_to_next(std::uint64_t bits, std::uint64_t from) {
+    const unsigned r = static_cast<unsigned>(from & 63);
+    const std::uint64_t rotated = r ? (bits >> r) | (bits << (64 - r)) : bits;
+    return __builtin_ctzll(rotated) + 1;
+}
+
+} // namespace
+
+namespace phm {
+
+TimerWheel::TimerWheel(Clock::duration tick, Clock::time_point start)
+    : tick_(tick.count() > 0 ? tick : Clock::duration(1)), origin_(start) {}
+
+void TimerWheel::set_wakeup(std::function<void()> fn) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    wakeup_ = std::move(fn);
+}
+
+std::size_t TimerWheel::size() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return entries_.size();
+}
+
+TimerWheel::TimerId TimerWheel::schedule(Clock::time_point when, std::function<void()> fn) {
+    // Rounded up: a timer never runs early
+    std::uint64_t tick = 0;
+    if (when > origin_) {
+        tick = static_cast<std::uint64_t>((when - origin_ + tick_ - Clock::duration(1)) / tick_);
+    }
+    std::function<void()> wake;
+    TimerId id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        id = ++next_id_;
+        entries_.emplace(id, Entry{tick, std::move(fn)});
+        place_(id, tick);
+        if (tick < promised_tick_) {
+            promised_tick_ = tick;
+            wake = wakeup_;
+        }
+    }
+    if (wake) wake();
+    return id;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return entries_.erase(id) > 0;   // its slot drops the id when it comes up
+}
+
+// Level L holds timers due within 64^(L+1) ticks, filed by bits
+// [6L, 6L+6) of their tick; the slot is re-filed when now_tick_ enters its
+// block, by then at most 64^L ticks away
+void TimerWheel::place_(TimerId id, std::uint64_t tick) {
+    if (tick <= now_tick_) {
+        due_.push_back(id);
+        return;
+    }
+    const std::uint64_t delta = tick - now_tick_;
+    int level = 0;
+    while (level < kLevels - 1 && (delta >> (kBits * (level + 1))) != 0) ++level;
+    std::uint64_t at = tick;
+    if (level == kLevels - 1 && (delta >> (kBits * kLevels)) != 0) {
+        at = now_tick_ + (std::uint64_t{1} << (kBits * kLevels)) - 1;   // parked at the far end
+    }
+    const std::uint64_t slot = (at >> (kBits * level)) & (kSlots - 1);
+    slots_[level][slot].push_back(id);
+    occupied_[level] |= std::uint64_t{1} << slot;
+}
+
+void TimerWheel::take_slot_(int level, std::uint64_t slot, std::vector<TimerId>& out) {
+    auto& ids = slots_[level][slot];
+    out.insert(out.end(), ids.begin(), ids.end());
+    ids.clear();
+    occupied_[level] &= ~(std::uint64_t{1} << slot);
+}
+
+std::size_t TimerWheel::advance(Clock::time_point now) {
+    std::vector<std::function<void()>> run;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        const std::uint64_t target =
+            now > origin_ ? static_cast<std::uint64_t>((now - origin_) / tick_) : 0;
+        std::vector<TimerId> ids;
+        auto collect_due = [&] {
+            for (TimerId id : due_) {
+                auto it = entries_.find(id);
+                if (it == entries_.end()) continue;   // cancelled
+                run.push_back(std::move(it->second.fn));
+                entries_.erase(it);
+            }
+            due_.clear();
+        };
+        collect_due();
+
+        while (now_tick_ < target) {
+            if (entries_.empty()) {
+                now_tick_ = target;
+                break;
+            }
+            // Next tick worth a look: a level-0 timer before the next slot
+            // boundary, or the boundary itself
+            const std::uint64_t boundary = (now_tick_ | (kSlots - 1)) + 1;
+            std::uint64_t next = boundary;
+            if (occupied_[0]) next = std::min(next, now_tick_ + distance_to_next(occupied_[0], now_tick_ + 1));
+            if (next > target) {
+                now_tick_ = target;
+                break;
+            }
+            now_tick_ = next;
+
+            // Coarse slots first, so what they re-file into a finer slot
+            // that is up now is picked up too
+            for (int level = kLevels - 1; level >= 1; --level) {
+                if ((now_tick_ & ((std::uint64_t{1} << (kBits * level)) - 1)) != 0) continue;
+                const std::uint64_t slot = (now_tick_ >> (kBits * level)) & (kSlots - 1);
+                if (!(occupied_[level] & (std::uint64_t{1} << slot))) continue;
+                ids.clear();
+                take_slot_(level, slot, ids);
+                for (TimerId id : ids) {
+                    auto it = entries_.find(id);
+                    if (it != entries_.end()) place_(id, it->second.tick);
+                }
+            }
+            ids.clear();
+            take_slot_(0, now_tick_ & (kSlots - 1), ids);
+            due_.insert(due_.end(), ids.begin(), ids.end());
+            collect_due();
+        }
+        promised_tick_ = UINT64_MAX;   // whoever sleeps next asks again
+    }
+    for (auto& fn : run) fn();
+    return run.size();
+}
+
+TimerWheel::Clock::time_point TimerWheel::next_expiry() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::uint64_t best = UINT64_MAX;
+    if (!due_.empty()) {
+        best = now_tick_;
+    } else if (!entries_.empty()) {
+        if (occupied_[0]) best = now_tick_ + distance_to_next(occupied_[0], now_tick_ + 1);
+        for (int level = 1; level < kLevels; ++level) {
+            if (!occupied_[level]) continue;
+            const std::uint64_t block = now_tick_ >> (kBits * level);
+            const std::uint64_t refile =
+                (block + distance_to_next(occupied_[level], block + 1)) << (kBits * level);
+            best = std::min(best, refile);
+        }
+    }
+    promised_tick_ = best;
+    if (best == UINT64_MAX) return Clock::time_point::max();
+    return origin_ + tick_ * static_cast<Clock::rep>(best);
+}
+
+} // namespace phm
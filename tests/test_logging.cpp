@@ -1,8 +1,12 @@
 #include <gtest/gtest.h>
 #include "log.hpp"
+#include "sinks_flight_recorder.hpp"
+#include <cstdlib>
+#include <limits>
 #include <memory>
 #include <vector>
 #include <string>
+#include <unistd.h>
 
 using namespace ara::log;
 
@@ -77,6 +81,161 @@ TEST(Logging, BroadcastsToMultipleSinks) {
   EXPECT_EQ(sinkB->n, 1);
 }
 
+TEST(FlightRecorder, KeepsLastRecordsAcrossWrapAndAttach) {
+  std::shared_ptr<FlightRecorder> ring = FlightRecorder::Create("test", 4);
+  ASSERT_NE(ring, nullptr);
+
+  LogManager::Instance().SetGlobalIds("ECU1", "APP1");
+  LogManager::Instance().SetDefaultLevel(LogLevel::kInfo);
+  LogManager::Instance().AddSink(std::make_shared<FlightRecorderSink>(ring));
+
+  auto log = Logger::CreateLogger("FR");
+  for (int i = 0; i < 6; ++i) ARA_LOGINFO(log, "msg {}", i);
+
+  auto tail = ring->ReadLast(3);
+  ASSERT_EQ(tail.size(), 3u);
+  EXPECT_EQ(tail[0].message, "msg 3");
+  EXPECT_EQ(tail[2].message, "msg 5");
+  EXPECT_EQ(tail[2].ctx_id, "FR");
+
+  // Only 4 slots: asking for more returns what survived the wrap
+  EXPECT_EQ(ring->ReadLast(100).size(), 4u);
+
+  // A second mapping (what the EM sees) reads the same records
+  auto peer = FlightRecorder::Attach(::dup(ring->Fd()));
+  ASSERT_NE(peer, nullptr);
+  EXPECT_EQ(peer->ReadLast(1).at(0).message, "msg 5");
+
+  // What an app launched by the EM does; the variable is gone afterwards
+  ::setenv(kFlightRecorderFdEnv, std::to_string(::dup(ring->Fd())).c_str(), 1);
+  EXPECT_NE(FlightRecorderSink::FromEnvironment(), nullptr);
+  EXPECT_EQ(std::getenv(kFlightRecorderFdEnv), nullptr);
+
+  ring->Reset();
+  EXPECT_TRUE(peer->ReadLast(4).empty());
+}
+
+static uint64_t g_fake_now = 0;
+static uint64_t FakeNow() { return g_fake_now; }
+
+TEST(RateLimit, BurstThenSuppressedSummary) {
+  RateLimiter rl(3, 1);          // 3 up front, then 1 per second
+  g_fake_now = 5'000'000'000ull;
+  uint32_t supp = 0;
+
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(rl.Allow(supp, FakeNow));
+    EXPECT_EQ(supp, 0u);
+  }
+  for (int i = 0; i < 5; ++i) EXPECT_FALSE(rl.Allow(supp, FakeNow));
+
+  g_fake_now += 1'000'000'000ull; // one token earned
+  EXPECT_TRUE(rl.Allow(supp, FakeNow));
+  EXPECT_EQ(supp, 5u);
+  EXPECT_FALSE(rl.Allow(supp, FakeNow));
+
+  g_fake_now += 60'000'000'000ull; // refill is capped at the burst size
+  for (int i = 0; i < 3; ++i) EXPECT_TRUE(rl.Allow(supp, FakeNow));
+  EXPECT_FALSE(rl.Allow(supp, FakeNow));
+}
+
+TEST(RateLimit, MacroLimitsPerCallSite) {
+  auto sink = std::make_shared<CaptureSink>();
+  LogManager::Instance().SetGlobalIds("ECU1", "APP1");
+  LogManager::Instance().SetDefaultLevel(LogLevel::kInfo);
+  LogManager::Instance().AddSink(sink);
+
+  auto log = Logger::CreateLogger("RL");
+  for (int i = 0; i < 50; ++i) ARA_LOG_RL(log, LogLevel::kInfo, 2, 1, "storm {}", i);
+  for (int i = 0; i < 50; ++i) ARA_LOG_RL(log, LogLevel::kDebug, 2, 1, "filtered {}", i);
+
+  ASSERT_EQ(sink->records.size(), 2u);
+  EXPECT_EQ(sink->records[0].message, "storm 0");
+  EXPECT_EQ(sink->records[1].message, "storm 1");
+}
+
+// Sink standing in for a non-verbose transport
+struct BinarySink : ISink {
+  std::vector<LogRecord> records;
+  int binds = 0;
+  void* BindContext(const std::string&, const std::string&, const std::string&) override {
+    ++binds;
+    return this;
+  }
+  bool WantsBinaryArgs() const noexcept override { return true; }
+  bool WantsText() const noexcept override { return false; }
+  void write(const LogRecord& r) noexcept override { records.push_back(r); }
+};
+
+TEST(NonVerbose, MessageIdMatchesCatalogHash) {
+  // Same FNV-1a value tools/gen_log_catalog.py writes for this literal
+  static_assert(ARA_LOG_MSG_ID("Speed publish {}") == 0x7310f5b9u, "catalog hash drifted");
+  EXPECT_NE(MessageId("a {}"), MessageId("b {}"));
+}
+
+TEST(NonVerbose, RecordsCarryIdAndBinaryArgs) {
+  auto sink = std::make_shared<BinarySink>();
+  LogManager::Instance().SetGlobalIds("ECU1", "APP1");
+  LogManager::Instance().SetDefaultLevel(LogLevel::kInfo);
+  LogManager::Instance().AddSink(sink);
+
+  auto log = Logger::CreateLogger("NV", "Non-verbose");
+  EXPECT_EQ(sink->binds, 1);
+
+  ARA_LOGINFO(log, "v={} n={} s={} ok={}", 1.5f, -42, std::string("abc"), true);
+  ARA_LOGINFO(log, "again {}", 7u);
+  EXPECT_EQ(sink->binds, 1); // bound once per Logger, not per record
+
+  ASSERT_EQ(sink->records.size(), 2u);
+  const auto& r = sink->records[0];
+  EXPECT_EQ(r.msg_id, MessageId("v={} n={} s={} ok={}"));
+  EXPECT_EQ(r.sink_ctx, sink.get());
+
+  std::vector<ArgView> args;
+  ASSERT_TRUE(ForEachArg(r.args, [&](const ArgView& a) { args.push_back(a); }));
+  ASSERT_EQ(args.size(), 4u);
+  EXPECT_EQ(args[0].type, ArgType::kFloat32);
+  EXPECT_FLOAT_EQ(static_cast<float>(args[0].d), 1.5f);
+  EXPECT_EQ(args[1].type, ArgType::kInt32);
+  EXPECT_EQ(args[1].i, -42);
+  EXPECT_EQ(args[2].s, "abc");
+  EXPECT_TRUE(args[3].b);
+}
+
+TEST(Structured, FieldsAreTypedAndRenderable) {
+  auto sink = std::make_shared<CaptureSink>();
+  LogManager::Instance().SetGlobalIds("ECU1", "APP1");
+  LogManager::Instance().SetDefaultLevel(LogLevel::kInfo);
+  LogManager::Instance().AddSink(sink);
+
+  auto log = Logger::CreateLogger("KV");
+  const float speed = 51.5f;
+  const int max_speed = 90;
+  ARA_LOGINFO_KV(log, "speed", "v", speed, "max", max_speed, "unit", "km/h");
+
+  ASSERT_EQ(sink->records.size(), 1u);
+  const auto& r = sink->records[0];
+  EXPECT_EQ(r.message, "speed");
+  EXPECT_EQ(r.msg_id, MessageId("speed"));
+
+  std::vector<std::string> keys;
+  std::vector<ArgType> types;
+  ASSERT_TRUE(ForEachField(r.fields, [&](std::string_view k, const ArgView& a) {
+    keys.emplace_back(k);
+    types.push_back(a.type);
+  }));
+  EXPECT_EQ(keys, (std::vector<std::string>{"v", "max", "unit"}));
+  EXPECT_EQ(types, (std::vector<ArgType>{ArgType::kFloat32, ArgType::kInt32, ArgType::kString}));
+
+  EXPECT_EQ(RenderFieldsText(r.fields), "v=51.5 max=90 unit=km/h");
+  EXPECT_EQ(RenderFieldsJson(r.fields), R"({"v":51.5,"max":90,"unit":"km/h"})");
+
+  ARA_LOGINFO_KV(log, "odd", "nan", std::numeric_limits<double>::quiet_NaN(),
+                 "inf", -std::numeric_limits<float>::infinity());
+  ASSERT_EQ(sink->records.size(), 2u);
+  EXPECT_EQ(RenderFieldsJson(sink->records[1].fields), R"({"nan":null,"inf":null})");
+}
+
 // --- DLT smoke test (auto-skip when not built with DLT) ---
 #ifdef HAVE_DLT
   #include "sinks_dlt.hpp"
@@ -1,7 +1,14 @@
 #include <gtest/gtest.h>
+#include <phm/heartbeat_slot.hpp>
 #include <phm/phm_supervisor.hpp>
+#include <phm/timer_wheel.hpp>
+#include <algorithm>
 #include <thread>
 #include <chrono>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std::chrono_literals;
 
@@ -71,3 +78,239 @@ TEST(PHM, RequiredCheckpoints_MissingThenPresent) {
     tick_for(phm, 12);
     EXPECT_EQ(violation_count, 1); // still 1 => no new violation
 }
+
+TEST(PHM, ChattyCheckpointsAreTrackedPerCycle) {
+    PhmSupervisor::Config cfg;
+    cfg.supervision_cycle_ms = 10;
+    cfg.allowed_missed_cycles = 0;
+    cfg.required_checkpoints = {7, 70, 700};
+
+    PhmSupervisor phm(cfg);
+    int violation_count = 0;
+    phm.set_violation_callback([&](const char*) { violation_count++; });
+
+    phm.maintenance_tick();   // starts the first cycle
+
+    // Thousands of reports, unknown ids among them, in one cycle
+    phm.on_alive();
+    for (int i = 0; i < 5000; ++i) {
+        phm.on_checkpoint(7);
+        phm.on_checkpoint(70);
+        phm.on_checkpoint(12345);
+    }
+    phm.on_checkpoint(700);
+    std::this_thread::sleep_for(12ms);
+    phm.maintenance_tick();
+    EXPECT_EQ(violation_count, 0);
+
+    // The seen set starts empty again
+    phm.on_alive();
+    phm.on_checkpoint(7);
+    phm.on_checkpoint(70);
+    std::this_thread::sleep_for(12ms);
+    phm.maintenance_tick();
+    EXPECT_EQ(violation_count, 1);
+}
+
+TEST(PHM, LogicalSupervision_FlagsTransitionsOutsideTheGraph) {
+    PhmSupervisor::Config cfg;
+    cfg.supervision_cycle_ms = 10;
+    cfg.allowed_missed_cycles = 100;   // logical failures are not tolerated anyway
+    cfg.allowed_transitions = {{1, 2}, {2, 3}, {2, 4}, {4, 2}};
+    cfg.initial_checkpoints = {1};
+    cfg.final_checkpoints = {3};
+
+    PhmSupervisor phm(cfg);
+    std::vector<std::string> reasons;
+    phm.set_violation_callback([&](const char* r) { reasons.emplace_back(r); });
+
+    // 1 -> 2 -> 4 -> 2 -> 3, then a new run from 1
+    phm.on_alive();
+    for (std::uint32_t cp : {1u, 2u, 4u, 2u, 3u, 1u, 2u}) phm.on_checkpoint(cp);
+    tick_for(phm, 12);
+    EXPECT_TRUE(reasons.empty());
+
+    // 2 -> 1 is no edge
+    phm.on_alive();
+    phm.on_checkpoint(1);
+    tick_for(phm, 12);
+    ASSERT_EQ(reasons.size(), 1u);
+    EXPECT_EQ(reasons[0], "logical supervision violation");
+
+    // 1 restarted the graph: 1 -> 2 -> 3 is fine; a run may not start at 3
+    phm.on_alive();
+    phm.on_checkpoint(2);
+    phm.on_checkpoint(3);
+    tick_for(phm, 12);
+    EXPECT_EQ(reasons.size(), 1u);
+    phm.on_alive();
+    phm.on_checkpoint(3);
+    tick_for(phm, 12);
+    EXPECT_EQ(reasons.size(), 2u);
+}
+
+TEST(PHM, TimerWheel_FiresInOrderAcrossLevelsAndSkipsCancelled) {
+    using Clock = phm::TimerWheel::Clock;
+    const auto t0 = Clock::now();
+    phm::TimerWheel wheel(1ms, t0);
+    EXPECT_EQ(wheel.next_expiry(), Clock::time_point::max());
+
+    std::vector<int> fired;
+    // Level 0, 1, 2 and 3 distances, scheduled out of order
+    for (int ms : {300000, 5, 70, 5000, 63, 64}) {
+        wheel.schedule(t0 + std::chrono::milliseconds(ms), [&fired, ms] { fired.push_back(ms); });
+    }
+    const auto dropped = wheel.schedule(t0 + 40ms, [&fired] { fired.push_back(-1); });
+    EXPECT_TRUE(wheel.cancel(dropped));
+    EXPECT_EQ(wheel.size(), 6u);
+
+    EXPECT_EQ(wheel.next_expiry(), t0 + 5ms);
+    EXPECT_EQ(wheel.advance(t0 + 4ms), 0u);
+    EXPECT_EQ(wheel.advance(t0 + 64ms), 3u);
+    EXPECT_EQ(fired, (std::vector<int>{5, 63, 64}));
+    EXPECT_LE(wheel.next_expiry(), t0 + 70ms);   // never later than the next timer
+
+    // Re-arming from a callback, as supervisors do; what is due already
+    // runs on the next advance
+    wheel.schedule(t0 + 100ms, [&] { wheel.schedule(t0 + 150ms, [&fired] { fired.push_back(150); }); });
+    EXPECT_EQ(wheel.advance(t0 + 10s), 3u);
+    EXPECT_EQ(fired, (std::vector<int>{5, 63, 64, 70, 5000}));
+    EXPECT_LE(wheel.next_expiry(), t0 + 10s);
+    EXPECT_EQ(wheel.advance(t0 + 10s), 1u);
+    EXPECT_EQ(fired.back(), 150);
+    EXPECT_EQ(wheel.advance(t0 + 300s), 1u);
+    EXPECT_EQ(fired.back(), 300000);
+    EXPECT_EQ(wheel.size(), 0u);
+
+    // A timer in the past runs on the next advance
+    int late = 0;
+    wheel.schedule(t0, [&late] { late++; });
+    EXPECT_LE(wheel.next_expiry(), t0 + 300s);
+    EXPECT_EQ(wheel.advance(t0 + 300s), 1u);
+    EXPECT_EQ(late, 1);
+}
+
+TEST(PHM, DeadlineSupervision_MinAndMaxBetweenCheckpoints) {
+    PhmSupervisor::Config cfg;
+    cfg.supervision_cycle_ms = 10;
+    cfg.allowed_missed_cycles = 100;
+    cfg.deadlines = {{10, 11, 5, 30}};
+
+    PhmSupervisor phm(cfg);
+    std::vector<std::string> reasons;
+    phm.set_violation_callback([&](const char* r) { reasons.emplace_back(r); });
+    phm.maintenance_tick();
+
+    // In time
+    phm.on_checkpoint(10);
+    std::this_thread::sleep_for(8ms);
+    phm.on_checkpoint(11);
+    tick_for(phm, 12);
+    EXPECT_TRUE(reasons.empty());
+
+    // Too early
+    phm.on_checkpoint(10);
+    phm.on_checkpoint(11);
+    tick_for(phm, 12);
+    ASSERT_EQ(reasons.size(), 1u);
+    EXPECT_EQ(reasons[0], "deadline supervision violation");
+
+    // Never ends: flagged once, and the late end is not flagged again
+    phm.on_checkpoint(10);
+    tick_for(phm, 40);
+    EXPECT_EQ(reasons.size(), 2u);
+    phm.on_checkpoint(11);
+    tick_for(phm, 12);
+    EXPECT_EQ(reasons.size(), 2u);
+}
+
+TEST(PHM, AttachedToTimerWheel_CyclesAndDeadlinesEndOnTime) {
+    phm::TimerWheel wheel(1ms);
+    PhmSupervisor::Config cfg;
+    cfg.supervision_cycle_ms = 10;
+    cfg.allowed_missed_cycles = 0;
+    cfg.deadlines = {{1, 2, 0, 15}};
+
+    PhmSupervisor phm(cfg);
+    std::vector<std::string> reasons;
+    phm.set_violation_callback([&](const char* r) { reasons.emplace_back(r); });
+    phm.attach(wheel);
+    phm.maintenance_tick();   // a no-op now
+
+    // Sleeping until the next expiry: one timer per supervisor, due a cycle ahead
+    const auto first = wheel.next_expiry();
+    EXPECT_LE(first, phm::TimerWheel::Clock::now() + 11ms);   // rounded up to the tick
+    EXPECT_EQ(wheel.size(), 1u);
+
+    phm.on_alive();
+    std::this_thread::sleep_until(first);
+    EXPECT_EQ(wheel.advance(phm::TimerWheel::Clock::now()), 1u);
+    EXPECT_TRUE(reasons.empty());
+
+    // No alive in the next cycle; the deadline's timer fires by itself
+    phm.on_checkpoint(1);
+    EXPECT_EQ(wheel.size(), 2u);
+    for (int i = 0; i < 20; ++i) {
+        std::this_thread::sleep_until(wheel.next_expiry());
+        wheel.advance(phm::TimerWheel::Clock::now());
+    }
+    ASSERT_GE(reasons.size(), 2u);
+    EXPECT_EQ(std::count(reasons.begin(), reasons.end(), "deadline supervision violation"), 1);
+    EXPECT_EQ(std::count(reasons.begin(), reasons.end(), "supervision violation"),
+              static_cast<long>(reasons.size()) - 1);
+}
+
+TEST(PHM, HeartbeatSlot_ReportsReachTheSupervisorWithTheirTimestamps) {
+    auto em_side = phm::HeartbeatSlot::create("test", 4);
+    ASSERT_TRUE(em_side);
+    auto app_side = phm::HeartbeatSlot::attach(::dup(em_side->fd()));   // as a launched app would
+    ASSERT_TRUE(app_side);
+
+    // Anything else is refused, and the fd is closed all the same
+    int pipe_fds[2];
+    ASSERT_EQ(::pipe(pipe_fds), 0);
+    EXPECT_FALSE(phm::HeartbeatSlot::attach(pipe_fds[0]));
+    EXPECT_EQ(::fcntl(pipe_fds[0], F_GETFD), -1);
+    ::close(pipe_fds[1]);
+
+    // The ring keeps the newest entries and counts what it dropped
+    for (std::uint32_t id = 1; id <= 10; ++id) app_side->report_checkpoint(id);
+    std::vector<phm::HeartbeatSlot::Checkpoint> cps;
+    std::uint64_t lost = 0;
+    EXPECT_FALSE(em_side->drain(cps, lost));
+    ASSERT_EQ(cps.size(), 4u);
+    EXPECT_EQ(cps.front().id, 7u);
+    EXPECT_EQ(cps.back().id, 10u);
+    EXPECT_EQ(lost, 6u);
+    EXPECT_FALSE(em_side->drain(cps, lost));   // nothing new
+    EXPECT_EQ(cps.size(), 4u);
+
+    PhmSupervisor::Config cfg;
+    cfg.supervision_cycle_ms = 10;
+    cfg.allowed_missed_cycles = 0;
+    cfg.required_checkpoints = {0x1001};
+    cfg.deadlines = {{1, 2, 5, 0}};
+    PhmSupervisor sup(cfg);
+    std::vector<std::string> reasons;
+    sup.set_violation_callback([&](const char* r) { reasons.emplace_back(r); });
+    sup.attach_heartbeat(em_side);
+    sup.maintenance_tick();
+
+    // Both ends of the deadline are drained together, judged by when they
+    // were reported
+    app_side->report_alive();
+    app_side->report_checkpoint(0x1001);
+    app_side->report_checkpoint(1);
+    std::this_thread::sleep_for(8ms);
+    app_side->report_checkpoint(2);
+    std::this_thread::sleep_for(4ms);
+    sup.maintenance_tick();
+    EXPECT_TRUE(reasons.empty());
+
+    // No alive in this cycle
+    app_side->report_checkpoint(0x1001);
+    std::this_thread::sleep_for(12ms);
+    sup.maintenance_tick();
+    ASSERT_EQ(reasons.size(), 1u);
+    EXPECT_EQ(reasons[0], "supervision violation");
+}
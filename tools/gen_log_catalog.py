@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""Generate the non-verbose DLT message catalog (FIBEX-like JSON).
+
+Scans the sources for ARA_LOG* call sites, takes their format literal and
+assigns the same FNV-1a id that ara::log::MessageId() computes at compile time.
+A DLT viewer plugin (or a human) can then turn "id + binary args" back into text.
+
+Usage: gen_log_catalog.py --root <src dir> --out <catalog.json>
+"""
+import argparse
+import json
+import os
+import re
+import sys
+
+SOURCE_DIRS = ["apps", "em", "logging", "persistency", "phm", "ara", "com", "stubs"]
+SOURCE_EXT = (".cpp", ".hpp", ".h", ".cc")
+
+# ARA_LOGINFO(lg, "...") / ARA_LOGINFO_RL(lg, "...") / ARA_LOG_RL(lg, lvl, burst, rate, "...")
+# ARA_LOGINFO_KV(lg, "msg", "key", value, ...) and the internal ARA_LOG_(lg, lvl, "...")
+# used inside log.hpp's macros
+CALL_RE = re.compile(r"\bARA_LOG(FATAL|ERROR|WARN|INFO|DEBUG|VERBOSE|_RL|_MSG_ID|_)(_RL|_KV)?\s*\(")
+LEVEL_RE = re.compile(r"LogLevel::k(Fatal|Error|Warn|Info|Debug|Verbose)")
+
+ESCAPES = {"n": "\n", "t": "\t", "r": "\r", "0": "\0", "\\": "\\", '"': '"', "'": "'",
+           "a": "\a", "b": "\b", "f": "\f", "v": "\v", "?": "?"}
+
+
+def fnv1a32(data: bytes) -> int:
+    h = 2166136261
+    for b in data:
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h if h != 0 else 1
+
+
+def split_args(text, start):
+    """Split the macro argument list starting right after '('. Returns raw args."""
+    args, depth, cur, i, in_str = [], 0, [], start, None
+    while i < len(text):
+        c = text[i]
+        if in_str:
+            cur.append(c)
+            if c == "\\":
+                cur.append(text[i + 1])
+                i += 1
+            elif c == in_str:
+                in_str = None
+        elif c in "\"'":
+            in_str = c
+            cur.append(c)
+        elif c in "([{":
+            depth += 1
+            cur.append(c)
+        elif c in ")]}":
+            if depth == 0:
+                args.append("".join(cur).strip())
+                return args
+            depth -= 1
+            cur.append(c)
+        elif c == "," and depth == 0:
+            args.append("".join(cur).strip())
+            cur = []
+        else:
+            cur.append(c)
+        i += 1
+    return None
+
+
+def parse_literal(arg):
+    """Concatenated C string literal -> bytes, or None if arg isn't one."""
+    arg = arg.strip()
+    while arg.startswith("(") and arg.endswith(")"):
+        arg = arg[1:-1].strip()
+    if not arg.startswith('"'):
+        return None
+    out, i = bytearray(), 0
+    while i < len(arg):
+        if arg[i].isspace():
+            i += 1
+            continue
+        if arg[i] != '"':
+            return None
+        i += 1
+        while i < len(arg) and arg[i] != '"':
+            c = arg[i]
+            if c == "\\":
+                nxt = arg[i + 1]
+                if nxt == "x":
+                    m = re.match(r"[0-9a-fA-F]+", arg[i + 2:])
+                    out.append(int(m.group(0), 16) & 0xFF)
+                    i += 2 + len(m.group(0))
+                    continue
+                out += ESCAPES.get(nxt, nxt).encode("utf-8")
+                i += 2
+                continue
+            out += c.encode("utf-8")
+            i += 1
+        i += 1
+    return bytes(out)
+
+
+def scan_file(path, rel):
+    with open(path, encoding="utf-8", errors="replace") as f:
+        text = f.read()
+    for m in CALL_RE.finditer(text):
+        line_start = text.rfind("\n", 0, m.start()) + 1
+        if text[line_start:m.start()].lstrip().startswith(("#define", "//")):
+            continue
+        args = split_args(text, m.end())
+        if not args:
+            continue
+        kind = m.group(1)
+        fields = None
+        if m.group(2) == "_KV":
+            if len(args) < 2:
+                continue
+            keys = [parse_literal(k) for k in args[2::2]]
+            fields = [k.decode("utf-8", errors="replace") if k is not None else None for k in keys]
+        if kind == "_MSG_ID":
+            fmt_arg, level = args[0], None
+        elif kind == "_":
+            if len(args) < 3:
+                continue
+            fmt_arg = args[2]
+            lm = LEVEL_RE.search(args[1])
+            level = lm.group(1).upper() if lm else None
+        elif kind == "_RL":
+            if len(args) < 5:
+                continue
+            fmt_arg = args[4]
+            lm = LEVEL_RE.search(args[1])
+            level = lm.group(1).upper() if lm else None
+        else:
+            if len(args) < 2:
+                continue
+            fmt_arg, level = args[1], kind
+        fmt = parse_literal(fmt_arg)
+        if fmt is None:
+            continue
+        msg = {
+            "id": fnv1a32(fmt),
+            "format": fmt.decode("utf-8", errors="replace"),
+            "level": level,
+            "file": rel,
+            "line": text.count("\n", 0, m.start()) + 1,
+            "args": 0 if fields is not None else fmt.count(b"{}"),
+        }
+        if fields is not None:
+            msg["fields"] = fields  # values follow the id in this order
+        yield msg
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--root", required=True)
+    ap.add_argument("--out", required=True)
+    opts = ap.parse_args()
+
+    messages = {}
+    for d in SOURCE_DIRS:
+        for dirpath, _, files in os.walk(os.path.join(opts.root, d)):
+            for name in sorted(files):
+                if not name.endswith(SOURCE_EXT):
+                    continue
+                path = os.path.join(dirpath, name)
+                rel = os.path.relpath(path, opts.root)
+                for msg in scan_file(path, rel):
+                    entry = messages.setdefault(msg["id"], {
+                        "id": "0x%08x" % msg["id"], "format": msg["format"],
+                        "args": msg["args"], "sites": []})
+                    if not entry["sites"] and "fields" in msg:
+                        entry["fields"] = msg["fields"]
+                    if entry["format"] != msg["format"]:
+                        print("error: message id collision 0x%08x: %r vs %r"
+                              % (msg["id"], entry["format"], msg["format"]), file=sys.stderr)
+                        return 1
+                    # One id decodes one way: the field names must agree too
+                    if entry.get("fields") != msg.get("fields"):
+                        print("error: message 0x%08x %r logged with fields %r at %s:%d, %r elsewhere"
+                              % (msg["id"], msg["format"], msg.get("fields"), msg["file"], msg["line"],
+                                 entry.get("fields")), file=sys.stderr)
+                        return 1
+                    entry["sites"].append({"file": msg["file"], "line": msg["line"],
+                                           "level": msg["level"]})
+
+    catalog = {
+        "format": "ara-log-catalog",
+        "version": 1,
+        "hash": "fnv1a-32",
+        "messages": [messages[k] for k in sorted(messages)],
+    }
+    os.makedirs(os.path.dirname(os.path.abspath(opts.out)), exist_ok=True)
+    with open(opts.out, "w", encoding="utf-8") as f:
+        json.dump(catalog, f, indent=2, ensure_ascii=False)
+        f.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())